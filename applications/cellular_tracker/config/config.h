@@ -23,6 +23,10 @@
  *      Cellular APN
  *      Cellular MNO Profile, URAT
  *
+ * The APN, MNO_PROFILE, URAT and LOGGING_LEVEL settings are the
+ * compiled defaults, which the APN, MNO_PROFILE, URAT and LOG_LEVEL
+ * keys of the configuration files override. See README.md
+ *
  */
 
 /* This is the configuration file for the MQTT credentials
@@ -79,6 +83,57 @@
  * -------------------------------------------------------------- */
 #define FLUSH_LOG_FILE_TIMER_MINS    0
 
+/* ----------------------------------------------------------------
+ * Log File record framing. Uncomment this line to write each log
+ *                          entry as a record with a length, sequence
+ *                          number and CRC. At boot the tail of the log
+ *                          file is scanned and any torn record from a
+ *                          reset or power loss is removed.
+ *                          The log file is then a binary file.
+ * -------------------------------------------------------------- */
+//#define LOG_FILE_RECORD_FRAMING
+
+// Size of the end of the log file which is scanned at boot, which
+// must be bigger than the largest log record.
+#define LOG_FILE_RECOVERY_TAIL_SIZE  4096
+
+/* ----------------------------------------------------------------
+ * Single thread tasks. Uncomment this line to run a task's loop and
+ *                          its event queue message handler in one
+ *                          thread, instead of a thread each. This
+ *                          saves the smaller of the two stacks for
+ *                          each task, which is logged when the task
+ *                          is initialised. The messages of a task
+ *                          wait while its loop is busy, and are
+ *                          handled when the loop dwells.
+ * -------------------------------------------------------------- */
+//#define TASK_SINGLE_THREAD
+
+/* ----------------------------------------------------------------
+ * Remote MQTT settings. Uncomment this line to let a configuration
+ *                          update on the ConfigUpdate topic change
+ *                          the MQTT broker and security settings
+ *                          (the MQTT_ and SECURITY_ keys). Without
+ *                          it these updates are rejected, as anyone
+ *                          who can publish to the topic could move
+ *                          the device to another broker.
+ * -------------------------------------------------------------- */
+//#define CONFIG_UPDATE_MQTT_SETTINGS
+
+/* ----------------------------------------------------------------
+ * Shutdown reset. Uncomment this line to reset the system when the
+ *                          shutdown can't stop a task, the network
+ *                          registration or a worker job in time.
+ *                          Without it the ones which didn't stop
+ *                          are logged, and the shutdown carries on:
+ *                          the cellular module is powered off, which
+ *                          ends any AT command a stuck task waits
+ *                          for, and the log can still be displayed.
+ *                          The log file and configuration are left
+ *                          open, as a stuck task can still use them.
+ * -------------------------------------------------------------- */
+//#define SHUTDOWN_RESET_ON_TIMEOUT
+
 /* ----------------------------------------------------------------
  * Enable the AT ECHO to be able to profile the AT Commands using 
  *                          just the Rx UART line.
@@ -33,6 +33,8 @@
 #include "signalQualityTask.h"
 #include "locationTask.h"
 #include "cellScanTask.h"
+#include "monitorTask.h"
+#include "logUploadTask.h"
 
 #include "u_mutex_debug.h"
 
@@ -43,9 +45,11 @@
  * Add your application topic message callbacks here
  * -------------------------------------------------------------- */
 #define APP_CONTROL_TOPIC "AppControl"
+#define CONFIG_UPDATE_TOPIC "ConfigUpdate"
 static callbackCommand_t callbacks[] = {
     {"SET_DWELL_TIME", setAppDwellTime},
-    {"SET_LOG_LEVEL", setAppLogLevel}
+    {"SET_LOG_LEVEL", setAppLogLevel},
+    {"DISPLAY_LOG", displayAppLog}
 };
 
 /// @brief The application function(s) which are run every appDwellTime
@@ -65,12 +69,12 @@ void buttonTwo(void)
 
 bool networkIsUp(void)
 {
-    return gIsNetworkUp;
+    return isEventActive(EVENT_NETWORK_UP);
 }
 
 bool mqttConnectionIsUp(void)
 {
-    return gIsMQTTConnected;
+    return isEventActive(EVENT_MQTT_CONNECTED);
 }
 /* ----------------------------------------------------------------
  * Main startup function for the framework
@@ -80,6 +84,18 @@ void main(void)
     if (!startupFramework())
         return;
 
+    // Add the tasks this application uses. They are initialised when they
+    // are first started or sent a message or command, by the app function,
+    // button #2 or their control topic.
+    registerTask(&signalQualityTaskRunner);
+    registerTask(&locationTaskRunner);
+    registerTask(&cellScanTaskRunner);
+    registerTask(&monitorTaskRunner);
+
+    // The log upload is only requested remotely, on its control topic which
+    // is subscribed to when it is registered
+    registerTask(&logUploadTaskRunner);
+
     // The Network registration task is used to connect to the cellular network
     // This will monitor the +CxREG URCs
     if (runTask(NETWORK_REG_TASK, networkIsUp) != U_ERROR_COMMON_SUCCESS) goto FINALIZE;
@@ -89,9 +105,16 @@ void main(void)
     // for remote control messages to be handled
     if (runTask(MQTT_TASK, mqttConnectionIsUp) != U_ERROR_COMMON_SUCCESS) goto FINALIZE;
 
+    // The Monitor task reports the stack and CPU usage of the threads, for
+    // sizing their stacks. It isn't needed for the application to work.
+    runTask(MONITOR_TASK, NULL);
+
     // Subscribe to the main AppControl topic for remote control the main application (this)
     subscribeToTopicAsync(APP_CONTROL_TOPIC, U_MQTT_QOS_AT_MOST_ONCE, callbacks, NUM_ELEMENTS(callbacks));
 
+    // Subscribe to the configuration update topic, for remote configuration changes
+    subscribeToTopicRawAsync(CONFIG_UPDATE_TOPIC, U_MQTT_QOS_AT_LEAST_ONCE, updateAppConfig);
+
     // Set button two to point to the queueCellScan function
     setButtonTwoFunction(buttonTwo);
 
@@ -14,11 +14,18 @@
  * limitations under the License.
  */
 
+#include <sys/reboot.h>
+
 #include "common.h"
 #include "taskControl.h"
+#include "taskSupervisor.h"
+#include "mqttTask.h"
+#include "registrationTask.h"
+#include "LEDTask.h"
 #include "cellInit.h"
 #include "config.h"
 #include "ext_fs.h"
+#include "schedulerPort.h"
 #include "leds.h"
 #include "buttons.h"
 
@@ -39,12 +46,27 @@ typedef enum {
 #define STARTUP_DELAY 250       // 250 * 20ms => 5 seconds
 #define LOG_FILENAME "log.csv"
 #define MQTT_CREDENTIALS_FILENAME "mqttCredentials.txt"
+#define REMOTE_CONFIG_FILENAME "remoteConfig.txt"
+
+#define CONFIG_STATUS_TOPIC "ConfigStatus"
 
 // Dwell time of the main loop activity, pause period until the loop runs again
 #define APP_DWELL_TIME_MS_MINIMUM 5000
-#define APP_DWELL_TIME_MS_DEFAULT APP_DWELL_TIME_MS_MINIMUM;
+#define APP_DWELL_TIME_MS_DEFAULT APP_DWELL_TIME_MS_MINIMUM
+// only used for polling if the dwell semaphore can't be created
 #define APP_DWELL_TICK_MS 50
 
+// How long the shutdown waits for the tasks, the network deregistration
+// and the worker jobs, before it carries on without them
+#define SHUTDOWN_TASK_DEADLINE_MS         5000
+#define SHUTDOWN_REGISTRATION_DEADLINE_MS 20000
+#define SHUTDOWN_WORKER_DEADLINE_MS       5000
+
+#ifdef SHUTDOWN_RESET_ON_TIMEOUT
+// time for the fatal log message to be written before the reset
+#define SHUTDOWN_RESET_DELAY_MS           1000
+#endif
+
 /* ----------------------------------------------------------------
  * STATIC VARIABLES
  * -------------------------------------------------------------- */
@@ -54,13 +76,23 @@ static uDeviceCfg_t deviceCfg;
 static bool buttonCommandEnabled = false;
 static buttonNumber_t pressedButton = NO_BUTTON;
 
-static int32_t appDwellTimeMS = 5000;
+static int32_t appDwellTimeMS = APP_DWELL_TIME_MS_DEFAULT;
+static uPortSemaphoreHandle_t appDwellSemaphore = NULL;
+static int32_t appScheduledJob = U_ERROR_COMMON_NOT_INITIALISED;
+static int32_t appLogLevel = LOGGING_LEVEL;
+
+static const configSchema_t appConfigSchema[] = {
+    CONFIG_INT("APP_DWELL_TIME", APP_DWELL_TIME_MS_DEFAULT, APP_DWELL_TIME_MS_MINIMUM, INT32_MAX, &appDwellTimeMS),
+    CONFIG_INT("LOG_LEVEL", LOGGING_LEVEL, eTRACE, eMAXLOGLEVELS - 1, &appLogLevel)
+};
 
 // This flag will pause the main application loop
 static bool pauseMainLoopIndicator = false;
 
 static bool appFinalized = false;
 
+static mqttTopicHandle_t configStatusTopic = U_ERROR_COMMON_NOT_INITIALISED;
+
 
 /* ----------------------------------------------------------------
  * STATIC FUNCTIONS
@@ -87,6 +119,28 @@ extern int32_t mqttCredentialsSize;
 /* ----------------------------------------------------------------
  * STATIC FUNCTIONS
  * -------------------------------------------------------------- */
+/// @brief Wakes up the main loop from its dwell, to check its dwell time
+static void wakeApplicationLoop(void)
+{
+    if (appDwellSemaphore != NULL)
+        uPortSemaphoreGive(appDwellSemaphore);
+}
+
+/// @brief Handles the exit event by waking up the main loop and the tasks,
+///        so they see it without waiting for their dwell time to finish
+static void wakeOnExit(appEvent_t event, void *pContext)
+{
+    wakeApplicationLoop();
+    wakeAllTasks();
+}
+
+/// @brief Sets the exit flag and publishes the exit event
+static void exitApplication(void)
+{
+    gExitApp = true;
+    publishEvent(EVENT_EXIT_REQUESTED);
+}
+
 
 /// @brief Function to check for a held button at start up.
 /// @return The button that was held at start up.
@@ -143,7 +197,7 @@ static void button_pressed(int buttonNo, uint32_t holdTime)
             // EXIT APPLICATION 
             case BUTTON_1:
                 writeWarn("Exit button pressed, closing down... Please wait for the RED LED to go out...");
-                gExitApp = true;
+                exitApplication();
                 break;
 
             // BUTTON #2 action is set by the application via setButtonTwoFunction()
@@ -273,7 +327,7 @@ static bool initXplrDevice(void)
     // deleting the log file is performed now before the start of the application
     if (button == BUTTON_2) {
         printLog("Deleting log file...");
-        deleteFile(LOG_FILENAME);
+        deleteLogFile(LOG_FILENAME);
     }
 
     // displaying the log file ends the application
@@ -293,26 +347,23 @@ static bool initXplrDevice(void)
 
 static bool loadConfigFiles(void)
 {
-    // Save the mqtt credentials file (if present)
-    if (mqttCredentialsSize > 0) {
-        int32_t saveResult = saveConfigFile(MQTT_CREDENTIALS_FILENAME,
-                                            mqttCredentials,
-                                            mqttCredentialsSize);
-
-        if (saveResult != 0 && saveResult != U_ERROR_COMMON_NOT_FOUND) {
-            printFatal("Aborting application as configuration file was not written");
-            return false;
-        }
-    } else {
-        printDebug("No mqtt credentials to save to file system");
+    // Load the mqtt credentials config file. The file is only rewritten if
+    // the compiled in mqtt credentials (if present) have changed.
+    printInfo("Loading MQTT Credentials...");
+    int32_t errorCode = loadConfig(MQTT_CREDENTIALS_FILENAME,
+                                   mqttCredentialsSize > 0 ? mqttCredentials : NULL,
+                                   mqttCredentialsSize);
+
+    if (errorCode < 0 && mqttCredentialsSize > 0) {
+        printFatal("Aborting application as configuration file was not written");
+        return false;
     }
 
-    // Load the mqtt credentials config file
-    printInfo("Loading MQTT Credentials...");
-    loadConfigFile(MQTT_CREDENTIALS_FILENAME);
+    // remote configuration values override the device configuration file
+    loadConfigLayer(CONFIG_LAYER_REMOTE, REMOTE_CONFIG_FILENAME);
 
-    // Note: More configuration files can be loaded.
-    // Everything is appended to the config list array.
+    registerConfigSchema(appConfigSchema, NUM_ELEMENTS(appConfigSchema));
+    setLogLevel((logLevels_t)appLogLevel);
 
     // this will only print if logging is set to DEBUG or higher - security!
     printConfiguration();
@@ -320,6 +371,64 @@ static bool loadConfigFiles(void)
     return true;
 }
 
+static void publishConfigStatus(const char *status)
+{
+    if (configStatusTopic < 0)
+        configStatusTopic = registerPublishTopic(CONFIG_STATUS_TOPIC);
+
+    char timestamp[TIMESTAMP_MAX_LENTH_BYTES];
+    getTimeStamp(timestamp);
+
+    char message[100];
+    snprintf(message, sizeof(message), "{\"Timestamp\":\"%s\", \"ConfigUpdate\":\"%s\"}", timestamp, status);
+
+    sendMQTTMessage(configStatusTopic, message, U_MQTT_QOS_AT_MOST_ONCE, false);
+}
+
+#ifdef CONFIG_UPDATE_MQTT_SETTINGS
+/// @brief Called from the MQTT task if it can't connect with the new configuration
+static void configUpdateFailed(void)
+{
+    writeWarn("Rolling back to the previous configuration");
+    if (restoreConfigFile(REMOTE_CONFIG_FILENAME) < 0) {
+        writeError("Failed to restore the previous configuration");
+        return;
+    }
+
+    setLogLevel((logLevels_t)appLogLevel);
+    wakeApplicationLoop();
+
+    reconnectMQTTClient(NULL);
+    publishConfigStatus("RolledBack");
+}
+#else
+/// @brief Finds a key of the MQTT broker or security settings in a
+///        configuration update, which only the device configuration can set
+/// @return true if the configuration update has one of these keys
+static bool hasMQTTSettings(const char *pText, size_t size)
+{
+    static const char *prefixes[] = {"MQTT_", "SECURITY_"};
+
+    const char *end = pText + size;
+    const char *line = pText;
+    while(line < end) {
+        while(line < end && (*line == ' ' || *line == '\r' || *line == '\n'))
+            line++;
+
+        for(size_t i=0; i<NUM_ELEMENTS(prefixes); i++) {
+            size_t length = strlen(prefixes[i]);
+            if ((size_t)(end - line) >= length && strncmp(line, prefixes[i], length) == 0)
+                return true;
+        }
+
+        while(line < end && *line != '\r' && *line != '\n')
+            line++;
+    }
+
+    return false;
+}
+#endif
+
 static void displayAppVersion()
 {
     writeInfo("**************************************************");
@@ -328,17 +437,30 @@ static void displayAppVersion()
 }
 
 /// @brief Dwells for appDwellTimeMS time, and exits if this time changes
+///        or the application is exiting
 static void dwellAppLoop(void)
 {
-    int32_t tick = 0;
     int32_t dwellTimeMS = appDwellTimeMS;
+    int64_t endTimeMs = getSchedulerTimeMs() + dwellTimeMS;
+    int64_t remainingMs = dwellTimeMS;
 
-    do
-    {
-        uPortTaskBlock(APP_DWELL_TICK_MS);
-        tick = tick + APP_DWELL_TICK_MS;
-    } while((tick < dwellTimeMS) &&
-            (dwellTimeMS == appDwellTimeMS));
+    endScheduledRun(appScheduledJob);
+
+    // the app function runs with the task loops which are due around the same time
+    if (setScheduledJobPeriod(appScheduledJob, dwellTimeMS, SCHEDULER_DEFAULT_WINDOW_MS(dwellTimeMS)) == 0)
+        endTimeMs = getNextScheduledRun(appScheduledJob);
+
+    while(!gExitApp && (dwellTimeMS == appDwellTimeMS) &&
+            (remainingMs = endTimeMs - getSchedulerTimeMs()) > 0) {
+        if (appDwellSemaphore == NULL)
+            uPortTaskBlock(remainingMs < APP_DWELL_TICK_MS ? remainingMs : APP_DWELL_TICK_MS);
+        else
+            uPortSemaphoreTryTake(appDwellSemaphore, (int32_t)remainingMs);
+    }
+
+    // a planned run waits for the task loops which are due at the same time
+    if (remainingMs <= 0 && beginScheduledRun(appScheduledJob, SCHEDULER_RUN_TIMEOUT_MS) == U_ERROR_COMMON_TIMEOUT)
+        writeDebug("Application loop is running with another scheduled job");
 
     printDebug("*** Application Tick ***\n");
 }
@@ -394,7 +516,7 @@ int32_t closeXPLRDevice(void)
 /// @brief Sets the time between each main loop execution
 /// @param params The dwell time parameter for the dwell time
 /// @return 0 if successful, or failure if invalid parameters
-int32_t setAppDwellTime(commandParamsList_t *params)
+int32_t setAppDwellTime(commandParams_t *params)
 {
     int32_t timeMS = getParamValue(params, 1, 5000, 60000, 30000);
 
@@ -404,26 +526,105 @@ int32_t setAppDwellTime(commandParamsList_t *params)
     }
 
     appDwellTimeMS = timeMS;
+    wakeApplicationLoop();
     writeLog("Setting App Dwell Time to: %d\n", timeMS);
 
     return U_ERROR_COMMON_SUCCESS;
 }
 
-/// @brief Sets the application logging level
-/// @param params The log level parameter for the dwell time
+/// @brief Sets the application logging level, or the logging level of one task
+/// @param params The log level parameter, and the optional task name. A log
+///               level of -1 removes the task's log level so the default is used
 /// @return 0 if successful, or failure if invalid parameters
-int32_t setAppLogLevel(commandParamsList_t *params)
+int32_t setAppLogLevel(commandParams_t *params)
 {
-    logLevels_t logLevel = (logLevels_t) getParamValue(params, 1, (int32_t) eTRACE, (int32_t) eMAXLOGLEVELS, (int32_t) eINFO);
+    logLevels_t logLevel = (logLevels_t) getParamValue(params, 1, -1, (int32_t) eMAXLOGLEVELS, (int32_t) eINFO);
+    const char *pTaskName = getParamString(params, 2);
+
+    if (pTaskName == NULL) {
+        if (logLevel < eTRACE || logLevel >= eMAXLOGLEVELS) {
+            writeWarn("Failed to set App Log Level %d. Min: %d, Max: %d", logLevel, eTRACE, eMAXLOGLEVELS - 1);
+            return U_ERROR_COMMON_INVALID_PARAMETER;
+        }
+
+        setLogLevel(logLevel);
+        return U_ERROR_COMMON_SUCCESS;
+    }
+
+    int32_t module = LOG_MODULE_APP;
+    if (strcmp(pTaskName, "App") != 0) {
+        module = getTaskIdByName(pTaskName);
+        if (module < 0) {
+            writeWarn("Failed to set Log Level, unknown task '%s'", pTaskName);
+            return U_ERROR_COMMON_INVALID_PARAMETER;
+        }
+    }
+
+    // -1 removes the module's own level
+    if (logLevel < eTRACE)
+        logLevel = eMAXLOGLEVELS;
+
+    return setModuleLogLevel(module, logLevel);
+}
 
-    if (logLevel < eTRACE) {
-        writeWarn("Failed to set App Log Level %d. Min: %d, Max: %d", logLevel, eTRACE, eMAXLOGLEVELS);
+/// @brief Displays the log file entries between two unix times on the terminal
+/// @param params The start and end unix time parameters
+/// @return 0 if successful, or failure if invalid parameters
+int32_t displayAppLog(commandParams_t *params)
+{
+    int32_t startTime = getParamValue(params, 1, 0, INT32_MAX, 0);
+    int32_t endTime = getParamValue(params, 2, 0, INT32_MAX, INT32_MAX);
+
+    if (endTime < startTime) {
+        writeWarn("Failed to display log, end time %d is before start time %d", endTime, startTime);
         return U_ERROR_COMMON_INVALID_PARAMETER;
     }
 
-    setLogLevel(logLevel);
+    displayLogFileRange(startTime, endTime);
+
+    return U_ERROR_COMMON_SUCCESS;
+}
+
+/// @brief Updates the application configuration from a configuration document,
+///        which is "KEY VALUE" lines that override the device configuration file.
+///        The MQTT settings can only be changed with CONFIG_UPDATE_MQTT_SETTINGS,
+///        when the MQTT connection is tried with the new configuration and the
+///        previous remote configuration is restored if it can't connect.
+/// @param pMessage The new configuration document
+/// @param msgSize The size of the configuration document
+/// @return 0 if successful, or failure if the configuration is invalid
+int32_t updateAppConfig(const char *pMessage, size_t msgSize)
+{
+    writeLog("Received a configuration update, %d bytes", msgSize);
+
+#ifndef CONFIG_UPDATE_MQTT_SETTINGS
+    if (hasMQTTSettings(pMessage, msgSize)) {
+        writeWarn("Configuration update rejected: the MQTT settings can't be changed remotely");
+        publishConfigStatus("Rejected");
+        return U_ERROR_COMMON_NOT_SUPPORTED;
+    }
+#endif
+
+    int32_t errorCode = updateConfigFile(REMOTE_CONFIG_FILENAME, pMessage, msgSize);
+    if (errorCode < 0) {
+        writeWarn("Configuration update rejected: %d", errorCode);
+        publishConfigStatus("Rejected");
+        return errorCode;
+    }
 
+    setLogLevel((logLevels_t)appLogLevel);
+    wakeApplicationLoop();
+    printConfiguration();
+    publishConfigStatus("Applied");
+
+#ifdef CONFIG_UPDATE_MQTT_SETTINGS
+    // the task and app dwell times are set as the configuration is loaded,
+    // but the MQTT client needs to connect again with the new settings
+    return reconnectMQTTClient(configUpdateFailed);
+#else
+    // the task and app dwell times are set as the configuration is loaded
     return U_ERROR_COMMON_SUCCESS;
+#endif
 }
 
 /// @brief Sets the function which handles the Button #2 function
@@ -451,6 +652,17 @@ void pauseMainLoop(bool state)
 /// @param appFunc The function pointer of the app event code
 void runApplicationLoop(bool (*appFunc)(void))
 {
+    if (appDwellSemaphore == NULL && uPortSemaphoreCreate(&appDwellSemaphore, 0, 1) != 0) {
+        writeWarn("Failed to create the application dwell semaphore");
+        appDwellSemaphore = NULL;
+    }
+
+    if (appScheduledJob < 0) {
+        appScheduledJob = addScheduledJob("App", appDwellTimeMS, SCHEDULER_DEFAULT_WINDOW_MS(appDwellTimeMS));
+        if (appScheduledJob < 0)
+            writeWarn("Failed to schedule the application loop: %d", appScheduledJob);
+    }
+
     while(!gExitApp) {
         dwellAppLoop();
 
@@ -462,34 +674,70 @@ void runApplicationLoop(bool (*appFunc)(void))
         }
 
         if (!appFunc()) {
-            gExitApp = true;
+            exitApplication();
             writeInfo("Application function stopped the app loop");
         }
     }
 }
 
-/// @brief Sets the application status, waits for the tasks and closes the log
+/// @brief Sets the application status, waits for the tasks and closes the log.
+///        If anything hasn't stopped by its deadline it is logged, and the
+///        shutdown carries on, or the system is reset with
+///        SHUTDOWN_RESET_ON_TIMEOUT.
 /// @param appState The application status to set for the shutdown
 void finalize(applicationStates_t appState)
 {
+    int64_t startTimeMs = getMonotonicTimeMs();
+
     gAppStatus = appState;
-    gExitApp = true;
+    exitApplication();
 
-    waitForAllTasksToStop();
+    bool stopped = waitForAllTasksToStop(SHUTDOWN_TASK_DEADLINE_MS);
+    int64_t tasksStoppedMs = getMonotonicTimeMs();
 
     // now stop the network registration task. Blue LED
     SET_BLUE_LED;
-    stopAndWait(NETWORK_REG_TASK);
+    if (!stopAndWait(NETWORK_REG_TASK, SHUTDOWN_REGISTRATION_DEADLINE_MS)) {
+        writeWarn("Network registration task didn't stop within %d ms", SHUTDOWN_REGISTRATION_DEADLINE_MS);
+        stopped = false;
+    }
+
+    int64_t deregisteredMs = getMonotonicTimeMs();
+
+    if (closeWorkerPool(SHUTDOWN_WORKER_DEADLINE_MS) < 0) {
+        writeWarn("Worker jobs didn't finish within %d ms", SHUTDOWN_WORKER_DEADLINE_MS);
+        stopped = false;
+    }
 
     finalizeAllTasks();
 
-    closeLogFile(true);
+    writeInfo("Shutdown took %d ms: tasks %d ms, deregistration %d ms",
+                (int)(getMonotonicTimeMs() - startTimeMs), (int)(tasksStoppedMs - startTimeMs),
+                (int)(deregisteredMs - tasksStoppedMs));
+
+    if (!stopped) {
+    #ifdef SHUTDOWN_RESET_ON_TIMEOUT
+        writeFatal("Shutdown couldn't stop everything in time, resetting the system");
+        uPortTaskBlock(SHUTDOWN_RESET_DELAY_MS);
+        sys_reboot(SYS_REBOOT_COLD);
+    #else
+        writeWarn("Shutdown couldn't stop everything in time, carrying on without it");
+    #endif
+    }
+
+    // a task or job which is still running can be using the log file or
+    // the configuration, so these are only closed if everything stopped.
+    // The cellular module is always powered off, which also ends any AT
+    // command a stuck task is waiting for.
+    if (stopped)
+        closeLogFile(true);
 
     closeCellularDevice();
 
     closeXPLRDevice();
 
-    closeConfig();
+    if (stopped)
+        closeConfig();
 
     SET_NO_LEDS;
 
@@ -517,6 +765,11 @@ bool startupFramework(void)
     uMutexDebugWatchdog(uMutexDebugPrint, NULL, U_MUTEX_DEBUG_WATCHDOG_TIMEOUT_SECONDS);
     #endif
 
+    // the task loops and the application loop plan their dwells with the scheduler
+    setSchedulerPort(&schedulerKernelPort);
+
+    subscribeToEvent(EVENT_EXIT_REQUESTED, wakeOnExit, NULL);
+
     // initialise our LEDs and start up button commands
     if (!initXplrDevice())
         return false;
@@ -534,6 +787,11 @@ bool startupFramework(void)
     if (!loadConfigFiles())
         return false;
 
+    // the framework's own tasks, the application registers the others it uses
+    registerTask(&ledTaskRunner);
+    registerTask(&networkRegistrationTaskRunner);
+    registerTask(&mqttTaskRunner);
+
     errorCode = initSingleTask(LED_TASK);
     if (errorCode < 0) {
         writeFatal("* Failed to initialise LED task - not running application!");
@@ -554,10 +812,14 @@ bool startupFramework(void)
         finalize(ERROR);
     }
 
-    // Initialise the task runners
-    if (initTasks() != 0) {
+    // the tasks run their one-shot jobs on the worker pool
+    if (initWorkerPool() != 0) {
+        writeFatal("* Failed to start the worker pool - not running application!");
         finalize(ERROR);
     }
 
+    // the application can still run without the supervisor
+    startTaskSupervisor();
+
     return true;
 }
\ No newline at end of file
@@ -20,8 +20,10 @@
 
 int32_t getSerialNumber(void);
 
-int32_t setAppDwellTime(commandParamsList_t *params);
-int32_t setAppLogLevel(commandParamsList_t *params);
+int32_t setAppDwellTime(commandParams_t *params);
+int32_t setAppLogLevel(commandParams_t *params);
+int32_t displayAppLog(commandParams_t *params);
+int32_t updateAppConfig(const char *pMessage, size_t msgSize);
 
 void setButtonTwoFunction(void (*func)(void));
 void runApplicationLoop(bool (*appFunc)(void));
@@ -22,6 +22,7 @@
  * DEFINES
  * -------------------------------------------------------------- */
 #define INFO_BUFFER_SIZE 50
+#define MNO_PROFILE_MAX 255
 
 /* ----------------------------------------------------------------
  * GLOBAL VARIABLES
@@ -29,6 +30,20 @@
 // serial number of the module
 char gSerialNumber[U_CELL_INFO_IMEI_SIZE+1];
 
+/* ----------------------------------------------------------------
+ * STATIC VARIABLES
+ * -------------------------------------------------------------- */
+static int32_t mnoProfile = MNO_PROFILE;
+static int32_t rat = URAT;
+
+/// the cellular configuration keys, which default to the config.h settings
+static const configSchema_t cellConfigSchema[] = {
+    CONFIG_INT("MNO_PROFILE", MNO_PROFILE, 0, MNO_PROFILE_MAX, &mnoProfile),
+    CONFIG_INT("URAT", URAT, 0, U_CELL_NET_RAT_MAX_NUM - 1, &rat)
+};
+
+static bool cellConfigRegistered = false;
+
 /* ----------------------------------------------------------------
  * STATIC FUNCTIONS
  * -------------------------------------------------------------- */
@@ -47,12 +62,12 @@ static int32_t checkReboot(void)
 static int32_t configureMNOProfile(void)
 {
     int32_t errorCode = uCellCfgGetMnoProfile(gDeviceHandle);
-    if (errorCode == MNO_PROFILE) return 0;
+    if (errorCode == mnoProfile) return 0;
 
-    errorCode = uCellCfgSetMnoProfile(gDeviceHandle, MNO_PROFILE);
+    errorCode = uCellCfgSetMnoProfile(gDeviceHandle, mnoProfile);
     if(errorCode != 0)
     {
-        writeError("Failed to set MNO Profile %d", MNO_PROFILE);
+        writeError("Failed to set MNO Profile %d", mnoProfile);
         return errorCode;
     }
 
@@ -61,13 +76,13 @@ static int32_t configureMNOProfile(void)
 
 static int32_t configureRAT(void)
 {
-    int32_t rat = uCellCfgGetRat(gDeviceHandle, 0);
-    if (rat == URAT) return 0;
+    int32_t currentRat = uCellCfgGetRat(gDeviceHandle, 0);
+    if (currentRat == rat) return 0;
 
-    int32_t errorCode = uCellCfgSetRat(gDeviceHandle, URAT);
+    int32_t errorCode = uCellCfgSetRat(gDeviceHandle, rat);
     if (errorCode != 0)
     {
-        writeError("Failed to set RAT %d", URAT);
+        writeError("Failed to set RAT %d", rat);
         return errorCode;
     }
 
@@ -81,6 +96,11 @@ int32_t configureCellularModule(void)
 {
     writeInfo("Configuring the cellular module...");
 
+    if (!cellConfigRegistered) {
+        if (registerConfigSchema(cellConfigSchema, NUM_ELEMENTS(cellConfigSchema)) == 0)
+            cellConfigRegistered = true;
+    }
+
     int32_t errorCode = configureMNOProfile();
     if (errorCode == 0)
         errorCode = configureRAT();
@@ -88,6 +108,34 @@ int32_t configureCellularModule(void)
     return errorCode;
 }
 
+/// @brief Turns the cellular module off and on again, such as when it has
+///        stopped responding, and configures it again
+/// @return 0 on success, negative on failure
+int32_t powerCycleCellularModule(void)
+{
+    writeWarn("Power cycling the cellular module...");
+
+    // the module may not respond to the power off AT command, so it is
+    // then turned off with its power pin
+    int32_t errorCode = uCellPwrOff(gDeviceHandle, NULL);
+    if (errorCode != 0) {
+        writeWarn("Failed to power off the cellular module (%d), forcing it off", errorCode);
+        errorCode = uCellPwrOffHard(gDeviceHandle, false, NULL);
+        if (errorCode != 0) {
+            writeError("Failed to force the cellular module off: %d", errorCode);
+            return errorCode;
+        }
+    }
+
+    errorCode = uCellPwrOn(gDeviceHandle, NULL, NULL);
+    if (errorCode != 0) {
+        writeError("Failed to power on the cellular module: %d", errorCode);
+        return errorCode;
+    }
+
+    return configureCellularModule();
+}
+
 /// @brief Display the cellular module's information 
 void displayCellularModuleInfo(void)
 {
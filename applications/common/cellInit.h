@@ -19,5 +19,6 @@
 
 int32_t configureCellularModule(void);
 void displayCellularModuleInfo(void);
+int32_t powerCycleCellularModule(void);
 
 #endif
\ No newline at end of file
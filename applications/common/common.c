@@ -19,8 +19,6 @@
  * Common utility functions
  *
  */
-#include <time.h>
-
 #include "common.h"
 
 /* ----------------------------------------------------------------
@@ -31,33 +29,6 @@
 /* ----------------------------------------------------------------
  * PUBLIC FUNCTIONS
  * -------------------------------------------------------------- */
-/// @brief Checks if the mutex is locked/running
-/// @param mutex the mutex to check
-/// @return false if it not locked/running, true if it is locked/running.
-bool isMutexLocked(uPortMutexHandle_t mutex)
-{
-    if(mutex == NULL) {
-        return false;
-    }
-
-    int32_t result = uPortMutexTryLock(mutex, 0);
-    if (result != 0)
-    {
-        return true; // Can't get a lock, so it must be running
-    }
-
-    // we have locked the mutex, so release we need to release it
-    if (uPortMutexUnlock(mutex) != 0) {
-        printFatal("Failed to release mutex from lock check!!!");
-        // now you've done it. You've tested the mutex lock
-        // by locking it and now can't unlock it!!
-        return true;
-    }
-
-    // As we could get a lock, the task is demeed "not running"
-    return false;
-}
-
 /// @brief Duplicates a string via malloc - remember to free()!
 /// @param src the string source
 /// @returns pointer to the duplicated string, or NULL
@@ -81,105 +52,92 @@ void *uMemDup(const void *src, size_t len)
     return dst;
 }
 
-static commandParamsList_t *createParam(char *param)
-{
-    commandParamsList_t *newParam = (commandParamsList_t *)pUPortMalloc(sizeof(commandParamsList_t));
-    if (newParam == NULL) {
-        writeError("No memory for createParam()");
-        return NULL;
-    }
-
-    newParam->parameter = uMemDup(param, strlen(param)+1);
-    if (newParam->parameter == NULL) {
-        writeError("No memory for createParam()");
-        return NULL;
-    }
-
-    newParam->pNext = NULL;
-
-    return newParam;
-}
-
-/// @brief Puts the command and param parts of a string message into a structure
+/// @brief Splits the command and param parts of a string message in place.
+/// The delimiters in the message are overwritten with NUL terminators and the
+/// params point to each token, so no memory is allocated.
 /// @param message The string to parse into Command: param1, param2 etc
 /// @param params The parameters for the command
-/// @returns Number of parameters
-size_t getParams(char *message, commandParamsList_t **head)
+/// @returns Number of parameters including the command, or a negative error
+int32_t getParams(char *message, commandParams_t *params)
 {
-    char *token = strtok_r(message, PARAM_DELIMITERS, &message);
-    if (token == NULL) {
-        printWarn("Unable to parse message for command/params");
-        return -1;
-    }
-
-    *head = createParam(token);
-    if (head == NULL) {
-        writeError("No memory for getParams()");
-        return 0;
+    char *pSave = NULL;
+    char *token;
+
+    params->count = 0;
+    if (message == NULL)
+        return U_ERROR_COMMON_INVALID_PARAMETER;
+
+    token = strtok_r(message, PARAM_DELIMITERS, &pSave);
+    while (token != NULL) {
+        if (params->count == MAX_COMMAND_PARAMS) {
+            printWarn("Command has more than %d params, ignoring the rest", MAX_COMMAND_PARAMS);
+            break;
+        }
+
+        params->param[params->count++] = token;
+        token = strtok_r(NULL, PARAM_DELIMITERS, &pSave);
     }
 
-    commandParamsList_t *current = *head;
-    size_t count=1;
-
-    while((token = strtok_r(NULL, PARAM_DELIMITERS, &message)) != NULL) {
-        current->pNext = createParam(token);
-        current = current->pNext;
-        count++;
+    if (params->count == 0) {
+        printWarn("Unable to parse message for command/params");
+        return U_ERROR_COMMON_NOT_FOUND;
     }
 
-    return count;
+    return (int32_t)params->count;
 }
 
-void freeParams(commandParamsList_t *item)
+/// @brief Gets the number of tokens in the command, including the command
+/// @param params The command parameters, can be NULL
+/// @return The number of tokens
+size_t getParamCount(const commandParams_t *params)
 {
-    if (item == NULL) {
-        return;
-    }
-
-    freeParams(item->pNext);
-    uPortFree(item->parameter);
-    uPortFree(item);
+    return params == NULL ? 0 : params->count;
 }
 
-int32_t getParamValue(commandParamsList_t *params, size_t index, int32_t minValue, int32_t maxValue, int32_t defValue)
+/// @brief Gets the command from the command parameters
+/// @param params The command parameters, can be NULL
+/// @return The command string, or NULL if there is no command
+const char *getParamCommand(const commandParams_t *params)
 {
-    char *ptr;
-    commandParamsList_t *param = params;
-    for(int i=0; i<index && param != NULL; i++)
-        param = params->pNext;
+    return getParamString(params, 0);
+}
 
+/// @brief Gets a parameter as a number, limited to a range
+/// @param params The command parameters, can be NULL
+/// @param index The index of the parameter, the command is index 0
+/// @param minValue The minimum value to return
+/// @param maxValue The maximum value to return
+/// @param defValue The value to return if the parameter is missing or not a number
+/// @return The parameter value
+int32_t getParamValue(const commandParams_t *params, size_t index, int32_t minValue, int32_t maxValue, int32_t defValue)
+{
+    const char *param = getParamString(params, index);
     if (param == NULL)
         return defValue;
 
-    int32_t value = strtol(param->parameter, &ptr, 10);
+    char *pEnd;
+    long value = strtol(param, &pEnd, 10);
+    if (pEnd == param || *pEnd != 0)
+        return defValue;
+
     if (value < minValue)
         return minValue;
     if (value > maxValue)
         return maxValue;
 
-    return value;
+    return (int32_t)value;
 }
 
-/// @brief Notates the timestamp from the network time or boot tick time
-/// @param timeStamp The string to write the timestamp to. Must be minimum size of TIMESTAMP_MAX_LENTH_BYTES
-void getTimeStamp(char *timeStamp)
+/// @brief Gets a parameter string from the command parameters
+/// @param params The command parameters, can be NULL
+/// @param index The index of the parameter, the command is index 0
+/// @return The parameter string, or NULL if there is no parameter at the index
+const char *getParamString(const commandParams_t *params, size_t index)
 {
-    // construct the log format, and include the ticks time
-    int32_t ticks = uPortGetTickTimeMs();
-
-    // if we have the network time set use this
-    if (unixNetworkTime > 0) {
-        time_t tmTime = unixNetworkTime + (ticks/1000);
-        int32_t milliseconds = ticks % 1000;
-        struct tm *time = gmtime(&tmTime);
-        snprintf(timeStamp, TIMESTAMP_MAX_LENTH_BYTES, "%02d:%02d:%02d.%03d",
-                                    time->tm_hour,
-                                    time->tm_min,
-                                    time->tm_sec,
-                                    milliseconds);
-    } else {
-        snprintf(timeStamp, TIMESTAMP_MAX_LENTH_BYTES, "%d", ticks);
-    }
+    if (params == NULL || index >= params->count)
+        return NULL;
+
+    return params->param[index];
 }
 
 void runTaskAndDelete(void *pParams)
@@ -197,11 +155,14 @@ void runTaskAndDelete(void *pParams)
 
 bool waitFor(bool (*checkFunction)(void))
 {
+    // check again as soon as any event is published, as well as every
+    // second for the state which isn't on the event bus
+    uint32_t eventCount = getEventCount();
     while(!gExitApp) {
         if (checkFunction())
             return true;
-        
-        uPortTaskBlock(1000);
+
+        waitForNextEvent(&eventCount, 1000);
     }
 
     return false;
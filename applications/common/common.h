@@ -33,13 +33,17 @@
 #include "ubxlib.h"
 #include "configUtils.h"
 #include "log.h"
+#include "timeService.h"
+#include "workerPool.h"
+#include "scheduler.h"
+#include "eventBus.h"
 
 #include "kernel.h"
 
 /* ----------------------------------------------------------------
  * MACORS for common task usage/access
  * -------------------------------------------------------------- */
-#define IS_NETWORK_AVAILABLE        (gIsNetworkSignalValid && gIsNetworkUp)
+#define IS_NETWORK_AVAILABLE        (gIsNetworkSignalValid && isEventActive(EVENT_NETWORK_UP))
 
 #define NUM_ELEMENTS(x)             (sizeof(x) / sizeof(x[0]))
 
@@ -50,11 +54,6 @@
 #define QUEUE_STACK_SIZE(x)         MIN(U_PORT_EVENT_QUEUE_MIN_TASK_STACK_SIZE_BYTES, x)
 #define QUEUE_STACK_SIZE_DEFAULT    U_PORT_EVENT_QUEUE_MIN_TASK_STACK_SIZE_BYTES
 
-/** The maximum length of the Time Stamp string.
- * hh:mm:ss.mmm
- */
-#define TIMESTAMP_MAX_LENTH_BYTES   13
-
 #define OPERATOR_NAME_SIZE          20
 
 /* ----------------------------------------------------------------
@@ -92,19 +91,25 @@ typedef enum {
     EXAMPLE_TASK = 5,
     LOCATION_TASK = 6,
     SENSOR_TASK = 7,
+    LOG_UPLOAD_TASK = 8,
+    MONITOR_TASK = 9,
     MAX_TASKS
 } taskTypeId_t;
 
-/// @brief command information
-typedef struct commandParamsList {
-    char *parameter;
-    struct commandParamsList *pNext;
-} commandParamsList_t;
+/// @brief The maximum number of tokens in a command, including the command itself
+#define MAX_COMMAND_PARAMS 8
+
+/// @brief command information. The parameters point into the command message
+/// which has been tokenised in place, so they are only valid while it is.
+typedef struct {
+    size_t count;
+    const char *param[MAX_COMMAND_PARAMS];
+} commandParams_t;
 
 /// @brief callback information
 typedef struct {
     const char *command;
-    int32_t (*callback)(commandParamsList_t *params);
+    int32_t (*callback)(commandParams_t *params);
 } callbackCommand_t;
 
 /* ----------------------------------------------------------------
@@ -123,36 +128,26 @@ extern bool gExitApp;
 // This flag is for pausing the normal main loop activity
 extern bool gPauseMainLoop;
 
-// This flag represents the network's registration status
-extern bool gIsNetworkUp;
-
 // This flag represents the module can hear the network signaling (RSRP != 0)
 extern bool gIsNetworkSignalValid;
 
-// This flag represents the MQTT Client is connected to the broker or SN gateway
-extern bool gIsMQTTConnected;
-
 // application status
 extern applicationStates_t gAppStatus;
 
-/// The unix network time, which is retrieved after first registration
-extern int64_t unixNetworkTime;
-
 /* ----------------------------------------------------------------
  * PUBLIC FUNCTIONS
  * -------------------------------------------------------------- */
-bool isMutexLocked(uPortMutexHandle_t mutex);
 char *uStrDup(const char *src);
 void *uMemDup(const void *data, size_t len);
 
 int32_t sendAppTaskMessage(int32_t taskId, void *pMessage, size_t msgSize);
 
-// Simple function to split message into command/params linked list
-size_t getParams(char *message, commandParamsList_t **head);
-void freeParams(commandParamsList_t *head);
-int32_t getParamValue(commandParamsList_t *params, size_t index, int32_t minValue, int32_t maxValue, int32_t defValue);
-
-void getTimeStamp(char *timeStamp);
+// Simple functions to split a message into command/params without allocating
+int32_t getParams(char *message, commandParams_t *params);
+size_t getParamCount(const commandParams_t *params);
+const char *getParamCommand(const commandParams_t *params);
+int32_t getParamValue(const commandParams_t *params, size_t index, int32_t minValue, int32_t maxValue, int32_t defValue);
+const char *getParamString(const commandParams_t *params, size_t index);
 
 void runTaskAndDelete(void *pParams);
 
@@ -0,0 +1,184 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *
+ * Small footprint compression and encoding functions for uploading
+ * data over MQTT. The compressor produces the standard LZ4 block format
+ * using a small hash table, trading compression ratio for RAM.
+ *
+ */
+
+#include <string.h>
+
+#include "ubxlib.h"
+#include "compress.h"
+
+/* ----------------------------------------------------------------
+ * DEFINITIONS
+ * -------------------------------------------------------------- */
+#define LZ4_HASH_BITS       10
+#define LZ4_MIN_MATCH       4
+#define LZ4_LAST_LITERALS   5       // the last 5 bytes are always literals
+#define LZ4_MATCH_LIMIT     12      // the last match must start 12 bytes before the end
+#define LZ4_MAX_OFFSET      0xFFFF
+#define LZ4_RUN_MASK        15
+
+/* ----------------------------------------------------------------
+ * STATIC VARIABLES
+ * -------------------------------------------------------------- */
+// positions of the last 4 byte sequences seen with this hash.
+// Stale positions from a previous block are fine as every match
+// candidate is checked against the current data.
+static uint16_t hashTable[1 << LZ4_HASH_BITS];
+
+static const char base64Table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+static uint32_t read32(const uint8_t *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t hash32(uint32_t value)
+{
+    return (value * 2654435761U) >> (32 - LZ4_HASH_BITS);
+}
+
+static uint8_t *writeLength(uint8_t *pOut, size_t length)
+{
+    while(length >= 255) {
+        *pOut++ = 255;
+        length -= 255;
+    }
+
+    *pOut++ = (uint8_t)length;
+    return pOut;
+}
+
+/// @brief Writes a sequence of literals, and the match which follows them (if any)
+static uint8_t *writeSequence(uint8_t *pOut, const uint8_t *pLiterals, size_t literalLength,
+                                size_t offset, size_t matchLength)
+{
+    uint8_t *pToken = pOut++;
+
+    *pToken = (uint8_t)(MIN(literalLength, LZ4_RUN_MASK) << 4);
+    if (literalLength >= LZ4_RUN_MASK)
+        pOut = writeLength(pOut, literalLength - LZ4_RUN_MASK);
+
+    memcpy(pOut, pLiterals, literalLength);
+    pOut += literalLength;
+
+    // the last sequence has no match
+    if (offset == 0)
+        return pOut;
+
+    *pOut++ = (uint8_t)(offset & 0xFF);
+    *pOut++ = (uint8_t)(offset >> 8);
+
+    *pToken |= (uint8_t)MIN(matchLength, LZ4_RUN_MASK);
+    if (matchLength >= LZ4_RUN_MASK)
+        pOut = writeLength(pOut, matchLength - LZ4_RUN_MASK);
+
+    return pOut;
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+int32_t lz4Compress(const uint8_t *pSrc, size_t srcSize, uint8_t *pDst, size_t dstSize)
+{
+    if (pSrc == NULL || pDst == NULL || srcSize > LZ4_MAX_INPUT_SIZE ||
+        dstSize < LZ4_COMPRESS_BOUND(srcSize)) {
+        return U_ERROR_COMMON_INVALID_PARAMETER;
+    }
+
+    const uint8_t *pIn = pSrc;
+    const uint8_t *pAnchor = pSrc;
+    const uint8_t *pEnd = pSrc + srcSize;
+    uint8_t *pOut = pDst;
+
+    if (srcSize >= LZ4_MATCH_LIMIT) {
+        const uint8_t *pMatchStartLimit = pEnd - LZ4_MATCH_LIMIT;
+        const uint8_t *pMatchEndLimit = pEnd - LZ4_LAST_LITERALS;
+
+        while(pIn <= pMatchStartLimit) {
+            uint32_t h = hash32(read32(pIn));
+            const uint8_t *pRef = pSrc + hashTable[h];
+            hashTable[h] = (uint16_t)(pIn - pSrc);
+
+            if (pRef >= pIn || (pIn - pRef) > LZ4_MAX_OFFSET || read32(pRef) != read32(pIn)) {
+                pIn++;
+                continue;
+            }
+
+            // extend the match as far as we can
+            const uint8_t *pMatchEnd = pIn + LZ4_MIN_MATCH;
+            const uint8_t *pRefEnd = pRef + LZ4_MIN_MATCH;
+            while(pMatchEnd < pMatchEndLimit && *pMatchEnd == *pRefEnd) {
+                pMatchEnd++;
+                pRefEnd++;
+            }
+
+            pOut = writeSequence(pOut, pAnchor, pIn - pAnchor,
+                                    pIn - pRef, pMatchEnd - pIn - LZ4_MIN_MATCH);
+
+            pIn = pMatchEnd;
+            pAnchor = pIn;
+        }
+    }
+
+    pOut = writeSequence(pOut, pAnchor, pEnd - pAnchor, 0, 0);
+
+    return (int32_t)(pOut - pDst);
+}
+
+int32_t base64Encode(const uint8_t *pSrc, size_t srcSize, char *pDst, size_t dstSize)
+{
+    if (pSrc == NULL || pDst == NULL || dstSize < BASE64_ENCODED_SIZE(srcSize))
+        return U_ERROR_COMMON_INVALID_PARAMETER;
+
+    char *pOut = pDst;
+    size_t i;
+    for(i=0; i + 2 < srcSize; i += 3) {
+        uint32_t triple = (pSrc[i] << 16) | (pSrc[i+1] << 8) | pSrc[i+2];
+        *pOut++ = base64Table[(triple >> 18) & 0x3F];
+        *pOut++ = base64Table[(triple >> 12) & 0x3F];
+        *pOut++ = base64Table[(triple >> 6) & 0x3F];
+        *pOut++ = base64Table[triple & 0x3F];
+    }
+
+    // pad the remaining one or two bytes
+    if (i < srcSize) {
+        uint32_t triple = pSrc[i] << 16;
+        if (i + 1 < srcSize)
+            triple |= pSrc[i+1] << 8;
+
+        *pOut++ = base64Table[(triple >> 18) & 0x3F];
+        *pOut++ = base64Table[(triple >> 12) & 0x3F];
+        *pOut++ = (i + 1 < srcSize) ? base64Table[(triple >> 6) & 0x3F] : '=';
+        *pOut++ = '=';
+    }
+
+    *pOut = 0;
+
+    return (int32_t)(pOut - pDst);
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *
+ * Compression and encoding header
+ *
+ */
+
+#ifndef _COMPRESS_H_
+#define _COMPRESS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* ----------------------------------------------------------------
+ * DEFINITIONS
+ * -------------------------------------------------------------- */
+/// The largest block which can be compressed, as match offsets are 16 bits
+#define LZ4_MAX_INPUT_SIZE          0xFFFF
+
+/// The worst case compressed size of a block which does not compress
+#define LZ4_COMPRESS_BOUND(size)    ((size) + ((size) / 255) + 16)
+
+/// The size of the base64 encoded data, including the null terminator
+#define BASE64_ENCODED_SIZE(size)   ((((size) + 2) / 3) * 4 + 1)
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+/// @brief Compresses a block of data into the LZ4 block format, which
+///        can be decompressed with any standard LZ4 block decompressor.
+///        Not re-entrant, as the hash table is static.
+/// @param pSrc The data to compress
+/// @param srcSize The size of the data, maximum LZ4_MAX_INPUT_SIZE
+/// @param pDst The buffer to compress in to
+/// @param dstSize The size of the buffer, minimum LZ4_COMPRESS_BOUND(srcSize)
+/// @return The compressed size, or negative on failure
+int32_t lz4Compress(const uint8_t *pSrc, size_t srcSize, uint8_t *pDst, size_t dstSize);
+
+/// @brief Encodes binary data as a null terminated base64 string
+/// @param pSrc The data to encode
+/// @param srcSize The size of the data
+/// @param pDst The buffer to put the string in
+/// @param dstSize The size of the buffer, minimum BASE64_ENCODED_SIZE(srcSize)
+/// @return The length of the string, or negative on failure
+int32_t base64Encode(const uint8_t *pSrc, size_t srcSize, char *pDst, size_t dstSize);
+
+#endif
@@ -20,6 +20,8 @@
  *
  */
 
+#include <sys/crc.h>
+
 #include "common.h"
 #include "config.h"
 #include "ext_fs.h"
@@ -27,74 +29,776 @@
 /* ----------------------------------------------------------------
  * DEFINES
  * -------------------------------------------------------------- */
-#define FILE_READ_BUFFER 50
-
 // delimiters are ' ' (space) and '\n' (newline)
 #define CONFIG_DELIMITERS " \n"
 
+// Number of missing configuration keys which are remembered, so that
+// their warning is only logged once
+#define CONFIG_MAX_MISSING_KEYS 16
+
+// each registered task with a loop adds a schema for its dwell time
+#define CONFIG_MAX_SCHEMAS 16
+
+// The configuration snapshot is the parsed configuration, saved alongside
+// the configuration file so that it can be loaded in a single read
+#define CONFIG_SNAPSHOT_EXTENSION ".snap"
+#define CONFIG_SNAPSHOT_MAGIC 0x50414E53
+#define CONFIG_SNAPSHOT_VERSION 3
+#define CONFIG_SNAPSHOT_NULL_OFFSET 0xFFFF
+#define CONFIG_FILENAME_MAX_SIZE 64
+
+// A configuration update is written to the temporary file, and the
+// previous configuration is kept in the backup file for a rollback
+#define CONFIG_TEMP_EXTENSION ".tmp"
+#define CONFIG_BACKUP_EXTENSION ".bak"
+
+// The tasks keep pointers in to the configuration text, so the text of a
+// reloaded configuration is kept until the configuration is closed. This
+// is the number of reloads which can be made before a restart.
+#define CONFIG_MAX_RELOADS 8
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
 /* ----------------------------------------------------------------
  * TYPE DEFINITIONS
  * -------------------------------------------------------------- */
-typedef struct APP_CONFIG_LIST {
-    char *key;
-    char *value;
-    struct APP_CONFIG_LIST *pNext;
-} appConfigList_t;
+typedef struct {
+    const char *key;
+    const char *value;      // NULL if the configuration value is "NULL"
+    configLayer_t layer;
+} appConfig_t;
+
+/// @brief A configuration layer, which is parsed from its own file
+typedef struct {
+    appConfig_t *list;      // sorted by key
+    size_t count;
+    char *text;             // the loaded configuration, which the list points in to
+    char filename[CONFIG_FILENAME_MAX_SIZE];
+    uint32_t paramsHash;    // hash of the compiled in parameters the file was written from
+} configLayerData_t;
+
+/// @brief The configuration snapshot file is this header, the sorted entries,
+///        and then the parsed configuration text which the entries point in to
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint32_t paramsHash;    // hash of the compiled in parameters, or zero
+    uint32_t sourceSize;    // size of the configuration file it was made from
+    uint32_t sourceHash;    // hash of the configuration file it was made from
+    uint32_t textSize;
+    uint32_t crc;           // CRC32 of the entries and text
+} configSnapshotHeader_t;
+
+typedef struct {
+    uint16_t keyOffset;
+    uint16_t valueOffset;   // CONFIG_SNAPSHOT_NULL_OFFSET for a NULL value
+} configSnapshotEntry_t;
 
 /* ----------------------------------------------------------------
  * STATIC VARIABLES
  * -------------------------------------------------------------- */
 static struct fs_file_t configFile;
-static appConfigList_t *configList;
 
-// this contains the loaded configuration file, which the configList points to.
-static char *configText = NULL;
+static configLayerData_t configLayers[CONFIG_LAYER_COUNT];
+
+// The configuration of all the layers merged and sorted by key, for a
+// binary search lookup. The entries point in to the layers' text. The
+// list and its count are replaced together, with the mutex held, as the
+// other tasks look up keys while the configuration is reloaded.
+K_MUTEX_DEFINE(configListMutex);
+static appConfig_t *configList = NULL;
+static size_t configCount = 0;
+
+static const char *configLayerNames[CONFIG_LAYER_COUNT] = {
+    "compiled",
+    "device",
+    "remote"
+};
+
+static const char *missingKeys[CONFIG_MAX_MISSING_KEYS];
+static size_t missingKeyCount = 0;
+
+typedef struct {
+    const configSchema_t *schema;
+    size_t count;
+} configSchemaList_t;
+
+static configSchemaList_t configSchemas[CONFIG_MAX_SCHEMAS];
+static size_t configSchemaCount = 0;
+
+// The configuration text and merged list replaced by a reload, which are
+// only freed when the configuration is closed
+typedef struct {
+    char *text;
+    appConfig_t *list;
+} retiredConfig_t;
+
+static retiredConfig_t retiredConfigs[CONFIG_MAX_RELOADS];
+static size_t retiredConfigCount = 0;
+
+// if the merged list is kept in the retired configurations
+static bool configListRetired = false;
 
 /* ----------------------------------------------------------------
  * STATIC PRIVATE FUNCTIONS
  * -------------------------------------------------------------- */
-static appConfigList_t *createConfigKVP(char *key, char *value) {
-    appConfigList_t *newKVP = (appConfigList_t *)pUPortMalloc(sizeof(appConfigList_t));
-    if (newKVP == NULL) {
-        writeError("Failed to allocate memory for new KeyValuePair config parameter");
-        return NULL;
+/// @brief Sorts the configuration by key, and then by the key's position in the
+///        configuration text so the first of any duplicate keys comes first
+static int compareConfig(const void *a, const void *b)
+{
+    const appConfig_t *configA = (const appConfig_t *)a;
+    const appConfig_t *configB = (const appConfig_t *)b;
+
+    int result = strcmp(configA->key, configB->key);
+    if (result != 0)
+        return result;
+
+    return (configA->key > configB->key) - (configA->key < configB->key);
+}
+
+/// @brief Sorts the merged configuration by key, and then the highest layer first
+static int compareMergedConfig(const void *a, const void *b)
+{
+    const appConfig_t *configA = (const appConfig_t *)a;
+    const appConfig_t *configB = (const appConfig_t *)b;
+
+    int result = strcmp(configA->key, configB->key);
+    if (result != 0)
+        return result;
+
+    return configB->layer - configA->layer;
+}
+
+static int compareConfigKey(const void *key, const void *config)
+{
+    return strcmp((const char *)key, ((const appConfig_t *)config)->key);
+}
+
+/// @brief Logs the missing key warning, only once for each key
+static void warnMissingKey(const char *key)
+{
+    for(size_t i=0; i<missingKeyCount; i++) {
+        if (strcmp(missingKeys[i], key) == 0)
+            return;
     }
 
-    newKVP->key = key;
-    newKVP->value = value;
-    newKVP->pNext = NULL;
+    if (missingKeyCount < CONFIG_MAX_MISSING_KEYS)
+        missingKeys[missingKeyCount++] = key;
 
-    return newKVP;
+    printWarn("Failed to find '%s' key", key);
 }
 
-static size_t parseConfiguration(char *configText, appConfigList_t **head)
+static size_t parseConfiguration(configLayerData_t *data, configLayer_t layer, char *configText)
 {
-    size_t count = 0;
-    appConfigList_t *current, *newNode;
+    // each key value pair is two tokens, which can be on any of the lines
+    size_t tokenCount = 0;
+    bool inToken = false;
+    for(const char *c = configText; *c != 0; c++) {
+        bool isDelimiter = strchr(CONFIG_DELIMITERS, *c) != NULL;
+        if (!isDelimiter && !inToken)
+            tokenCount++;
+
+        inToken = !isDelimiter;
+    }
+
+    size_t maxCount = tokenCount / 2 + 1;
 
-    do {
+    appConfig_t *configList = (appConfig_t *)pUPortMalloc(maxCount * sizeof(appConfig_t));
+    if (configList == NULL) {
+        writeError("Failed to allocate memory for the configuration parameters");
+        return 0;
+    }
+
+    size_t count = 0;
+    while(count < maxCount) {
         char *key = strtok_r(configText, CONFIG_DELIMITERS, &configText);
         char *value = strtok_r(NULL, CONFIG_DELIMITERS, &configText);
         if(key == NULL || value == NULL) {
             break;
         }
 
-        newNode = createConfigKVP(key, value);
-        if (newNode == NULL)
+        configList[count].key = key;
+        configList[count].value = (strncmp(value, "NULL", 4) == 0) ? NULL : value;
+        configList[count].layer = layer;
+        count++;
+    }
+
+    qsort(configList, count, sizeof(appConfig_t), compareConfig);
+
+    // only keep the first of any duplicate keys
+    size_t unique = 0;
+    for(size_t i=0; i<count; i++) {
+        if (unique == 0 || strcmp(configList[unique-1].key, configList[i].key) != 0)
+            configList[unique++] = configList[i];
+    }
+
+    data->list = configList;
+    data->count = unique;
+
+    return unique;
+}
+
+/// @brief Frees a configuration layer, keeping its filename
+static void clearConfigLayer(configLayer_t layer)
+{
+    configLayerData_t *data = &configLayers[layer];
+
+    uPortFree(data->list);
+    data->list = NULL;
+    data->count = 0;
+
+    uPortFree(data->text);
+    data->text = NULL;
+}
+
+/// @brief Checks if a loaded configuration layer can be reloaded
+/// @param reserved The number of reloads to keep for later
+static bool canReloadConfigLayer(configLayer_t layer, size_t reserved)
+{
+    return configLayers[layer].text == NULL || retiredConfigCount + reserved < CONFIG_MAX_RELOADS;
+}
+
+/// @brief Replaces a loaded configuration layer for a reload. Its text and
+///        the merged list are kept, as another task can still be using them.
+static void retireConfigLayer(configLayer_t layer)
+{
+    configLayerData_t *data = &configLayers[layer];
+
+    retiredConfigs[retiredConfigCount].text = data->text;
+    retiredConfigs[retiredConfigCount].list = configListRetired ? NULL : configList;
+    retiredConfigCount++;
+
+    // the merged list is replaced when the layers are merged again
+    configListRetired = true;
+
+    uPortFree(data->list);
+    data->list = NULL;
+    data->count = 0;
+    data->text = NULL;
+}
+
+/// @brief Frees the configurations which were replaced by a reload
+static void freeRetiredConfigs(void)
+{
+    for(size_t i=0; i<retiredConfigCount; i++) {
+        uPortFree(retiredConfigs[i].text);
+        uPortFree(retiredConfigs[i].list);
+    }
+
+    retiredConfigCount = 0;
+}
+
+/// @brief Merges the configuration layers in to one list sorted by key, where
+///        a key in a higher layer overrides the same key in the layers below it
+/// @return 0 on success, negative on failure
+static int32_t mergeConfigLayers(void)
+{
+    size_t total = 0;
+    for(int32_t layer=0; layer<CONFIG_LAYER_COUNT; layer++)
+        total += configLayers[layer].count;
+
+    appConfig_t *list = NULL;
+    size_t unique = 0;
+    if (total > 0) {
+        list = (appConfig_t *)pUPortMalloc(total * sizeof(appConfig_t));
+        if (list == NULL) {
+            writeError("Failed to allocate memory for the merged configuration");
+            return U_ERROR_COMMON_NO_MEMORY;
+        }
+
+        size_t count = 0;
+        for(int32_t layer=0; layer<CONFIG_LAYER_COUNT; layer++) {
+            for(size_t i=0; i<configLayers[layer].count; i++)
+                list[count++] = configLayers[layer].list[i];
+        }
+
+        qsort(list, count, sizeof(appConfig_t), compareMergedConfig);
+
+        // each key is unique within a layer, so keep the first which is the highest layer
+        for(size_t i=0; i<count; i++) {
+            if (unique == 0 || strcmp(list[unique-1].key, list[i].key) != 0)
+                list[unique++] = list[i];
+        }
+    }
+
+    // the previous list is replaced in one step rather than being emptied
+    // first, as another task can be looking up a key
+    k_mutex_lock(&configListMutex, K_FOREVER);
+    appConfig_t *previous = configList;
+    configList = list;
+    configCount = unique;
+    k_mutex_unlock(&configListMutex);
+
+    if (!configListRetired)
+        uPortFree(previous);
+
+    configListRetired = false;
+
+    return U_ERROR_COMMON_SUCCESS;
+}
+
+/// @brief Finds the layer which a configuration file was loaded in to
+static configLayer_t findConfigLayer(const char *filename)
+{
+    for(int32_t layer=CONFIG_LAYER_COUNT-1; layer>CONFIG_LAYER_COMPILED; layer--) {
+        if (strcmp(configLayers[layer].filename, filename) == 0)
+            return (configLayer_t)layer;
+    }
+
+    return CONFIG_LAYER_DEVICE;
+}
+
+/// @brief Finds the configuration entry for a key, without any warning
+/// @param key The configuration name
+/// @param pConfig Set to a copy of the entry if it is found, as the merged
+///                list can be replaced once the lookup has finished. Can
+///                be NULL.
+/// @return true if the key is configured, false otherwise
+static bool findConfig(const char *key, appConfig_t *pConfig)
+{
+    k_mutex_lock(&configListMutex, K_FOREVER);
+    const appConfig_t *config = NULL;
+    if (configList != NULL)
+        config = (const appConfig_t *)bsearch(key, configList, configCount, sizeof(appConfig_t), compareConfigKey);
+
+    if (config != NULL && pConfig != NULL)
+        *pConfig = *config;
+    k_mutex_unlock(&configListMutex);
+
+    return config != NULL;
+}
+
+/// @brief Checks a configuration value against the schema's type and range
+static bool isValidSchemaValue(const configSchema_t *entry, const char *value)
+{
+    if (entry->type != CONFIG_TYPE_INT || value == NULL)
+        return true;
+
+    char *end;
+    long parsed = strtol(value, &end, 10);
+
+    return *end == 0 && parsed >= entry->minValue && parsed <= entry->maxValue;
+}
+
+/// @brief Finds the schema entry for a configuration key
+static const configSchema_t *findSchemaEntry(const char *key)
+{
+    for(size_t i=0; i<configSchemaCount; i++) {
+        for(size_t j=0; j<configSchemas[i].count; j++) {
+            if (strcmp(configSchemas[i].schema[j].key, key) == 0)
+                return &configSchemas[i].schema[j];
+        }
+    }
+
+    return NULL;
+}
+
+/// @brief Parses a configuration value into its schema value
+/// @return true if the configuration value was valid, or not set
+static bool applySchemaEntry(const configSchema_t *entry)
+{
+    appConfig_t config;
+    bool found = findConfig(entry->key, &config);
+    const char *value = found ? config.value : NULL;
+    bool valid = true;
+
+    switch(entry->type) {
+        case CONFIG_TYPE_STRING:
+            *(const char **)entry->pValue = found ? value : entry->pDefaultString;
+            break;
+
+        case CONFIG_TYPE_INT: {
+            valid = isValidSchemaValue(entry, value);
+            if (value != NULL && valid)
+                *(int32_t *)entry->pValue = atoi(value);
+            else
+                *(int32_t *)entry->pValue = entry->defaultValue;
+            break;
+        }
+
+        case CONFIG_TYPE_BOOL:
+            if (value != NULL)
+                *(bool *)entry->pValue = strcmp(value, entry->pTrueValue) == 0;
+            else
+                *(bool *)entry->pValue = entry->defaultValue != 0;
+            break;
+
+        default:
+            valid = false;
             break;
+    }
+
+    if (!valid)
+        writeWarn("Invalid configuration value '%s' for '%s', using the default: %d", value, entry->key, entry->defaultValue);
+
+    return valid;
+}
+
+/// @brief Parses the configuration into all the registered schemas
+/// @return the number of invalid configuration values
+static int32_t applyConfigSchemas(void)
+{
+    int32_t invalidCount = 0;
+    for(size_t i=0; i<configSchemaCount; i++) {
+        for(size_t j=0; j<configSchemas[i].count; j++) {
+            if (!applySchemaEntry(&configSchemas[i].schema[j]))
+                invalidCount++;
+        }
+    }
+
+    return invalidCount;
+}
+
+/// @brief FNV-1a hash, which can be continued with the previous hash
+static uint32_t hashConfigText(uint32_t hash, const char *text, size_t length)
+{
+    for(size_t i=0; i<length; i++) {
+        hash ^= (uint8_t)text[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+/// @brief Hashes the configuration parameters as they are written to the file
+static uint32_t hashConfigParams(const char *configParams[], int32_t configParamsSize)
+{
+    uint32_t hash = FNV_OFFSET_BASIS;
+    for(int32_t i=0; i<configParamsSize; i++) {
+        hash = hashConfigText(hash, configParams[i], strlen(configParams[i]));
+        hash = hashConfigText(hash, "\n", 1);
+    }
+
+    return hash;
+}
+
+/// @brief Hashes the contents of a file, reading it in chunks
+/// @return 0 on success, negative on failure
+static int32_t hashConfigFile(const char *path, size_t fileSize, uint32_t *pHash)
+{
+    struct fs_file_t file;
+    fs_file_t_init(&file);
+    if (fs_open(&file, path, FS_O_READ) < 0)
+        return U_ERROR_COMMON_NOT_FOUND;
+
+    char chunk[64];
+    uint32_t hash = FNV_OFFSET_BASIS;
+    size_t total = 0;
+    ssize_t count;
+    while((count = fs_read(&file, chunk, sizeof(chunk))) > 0) {
+        hash = hashConfigText(hash, chunk, count);
+        total += count;
+    }
+
+    fs_close(&file);
+    if (count < 0 || total != fileSize)
+        return U_ERROR_COMMON_DEVICE_ERROR;
+
+    *pHash = hash;
+
+    return U_ERROR_COMMON_SUCCESS;
+}
+
+/// @brief Creates a path for a file which goes alongside the configuration
+///        file, mqttCredentials.txt => mqttCredentials.txt.snap
+/// @param buffer The buffer for the path
+/// @param size The size of the buffer, which should be EXT_FS_MAX_PATH_SIZE
+static const char *getConfigPath(char *buffer, size_t size, const char *filename, const char *extension)
+{
+    char pathFilename[CONFIG_FILENAME_MAX_SIZE];
+    snprintf(pathFilename, sizeof(pathFilename), "%s%s", filename, extension);
+
+    return extFsMakePath(buffer, size, pathFilename);
+}
+
+/// @brief Creates the path of a configuration file's snapshot
+/// @param buffer The buffer for the path
+/// @param size The size of the buffer, which should be EXT_FS_MAX_PATH_SIZE
+static const char *getSnapshotPath(char *buffer, size_t size, const char *filename)
+{
+    return getConfigPath(buffer, size, filename, CONFIG_SNAPSHOT_EXTENSION);
+}
+
+static void deleteConfigSnapshot(const char *filename)
+{
+    char pathBuffer[EXT_FS_MAX_PATH_SIZE];
+    const char *path = getSnapshotPath(pathBuffer, sizeof(pathBuffer), filename);
+    if (extFsFileExists(path))
+        fs_unlink(path);
+}
+
+/// @brief Saves the loaded configuration as a snapshot of the configuration file
+static int32_t saveConfigSnapshot(const configLayerData_t *data, const char *filename, uint32_t paramsHash,
+                                  size_t sourceSize, uint32_t sourceHash)
+{
+    const appConfig_t *configList = data->list;
+    const char *configText = data->text;
+    size_t configCount = data->count;
+
+    size_t textSize = sourceSize + 1;
+    if (textSize >= CONFIG_SNAPSHOT_NULL_OFFSET)
+        return U_ERROR_COMMON_NOT_SUPPORTED;
+
+    size_t entriesSize = configCount * sizeof(configSnapshotEntry_t);
+    configSnapshotEntry_t *entries = (configSnapshotEntry_t *)pUPortMalloc(MAX(entriesSize, 1));
+    if (entries == NULL)
+        return U_ERROR_COMMON_NO_MEMORY;
+
+    for(size_t i=0; i<configCount; i++) {
+        entries[i].keyOffset = configList[i].key - configText;
+        entries[i].valueOffset = configList[i].value == NULL ?
+                CONFIG_SNAPSHOT_NULL_OFFSET : configList[i].value - configText;
+    }
+
+    configSnapshotHeader_t header = {
+        .magic = CONFIG_SNAPSHOT_MAGIC,
+        .version = CONFIG_SNAPSHOT_VERSION,
+        .count = configCount,
+        .paramsHash = paramsHash,
+        .sourceSize = sourceSize,
+        .sourceHash = sourceHash,
+        .textSize = textSize
+    };
+    header.crc = crc32_ieee((uint8_t *)entries, entriesSize);
+    header.crc = crc32_ieee_update(header.crc, (uint8_t *)configText, textSize);
+
+    int32_t errorCode = U_ERROR_COMMON_SUCCESS;
+    char pathBuffer[EXT_FS_MAX_PATH_SIZE];
+    const char *path = getSnapshotPath(pathBuffer, sizeof(pathBuffer), filename);
+    deleteConfigSnapshot(filename);
+
+    struct fs_file_t snapshotFile;
+    fs_file_t_init(&snapshotFile);
+    if (fs_open(&snapshotFile, path, FS_O_CREATE | FS_O_WRITE) < 0) {
+        uPortFree(entries);
+        return U_ERROR_COMMON_DEVICE_ERROR;
+    }
+
+    if (fs_write(&snapshotFile, &header, sizeof(header)) != sizeof(header) ||
+        fs_write(&snapshotFile, entries, entriesSize) != entriesSize ||
+        fs_write(&snapshotFile, configText, textSize) != textSize) {
+        errorCode = U_ERROR_COMMON_DEVICE_ERROR;
+    }
+
+    fs_close(&snapshotFile);
+    uPortFree(entries);
+
+    if (errorCode < 0) {
+        writeWarn("Failed to write configuration snapshot for '%s'", filename);
+        deleteConfigSnapshot(filename);
+    }
+
+    return errorCode;
+}
 
-        if(count == 0) {
-            *head = newNode;
-            current = *head;
-        } else {
-            current->pNext = newNode;
-            current = current->pNext;
+/// @brief Loads the configuration from its snapshot, in a single read
+/// @param filename The configuration filename the snapshot was made from
+/// @param paramsHash The hash of the compiled in parameters the configuration
+///                   must be made from, or zero if there are none
+/// @param sourceSize The size of the configuration file
+/// @param sourceHash The hash of the configuration file contents
+/// @return 0 on success, negative if the snapshot is missing or out of date
+static int32_t loadConfigSnapshot(configLayerData_t *data, configLayer_t layer, const char *filename,
+                                  uint32_t paramsHash, size_t sourceSize, uint32_t sourceHash)
+{
+    char pathBuffer[EXT_FS_MAX_PATH_SIZE];
+    const char *path = getSnapshotPath(pathBuffer, sizeof(pathBuffer), filename);
+    size_t fileSize;
+    if (!extFsFileSize(path, &fileSize) || fileSize < sizeof(configSnapshotHeader_t))
+        return U_ERROR_COMMON_NOT_FOUND;
+
+    char *buffer = (char *)pUPortMalloc(fileSize);
+    if (buffer == NULL)
+        return U_ERROR_COMMON_NO_MEMORY;
+
+    struct fs_file_t snapshotFile;
+    fs_file_t_init(&snapshotFile);
+    int32_t count = -1;
+    if (fs_open(&snapshotFile, path, FS_O_READ) == 0) {
+        count = fs_read(&snapshotFile, buffer, fileSize);
+        fs_close(&snapshotFile);
+    }
+
+    // the header is only valid once the whole snapshot has been read
+    if (count != fileSize) {
+        uPortFree(buffer);
+        return U_ERROR_COMMON_NOT_FOUND;
+    }
+
+    configSnapshotHeader_t *header = (configSnapshotHeader_t *)buffer;
+    configSnapshotEntry_t *entries = (configSnapshotEntry_t *)(buffer + sizeof(configSnapshotHeader_t));
+    size_t entriesSize = header->count * sizeof(configSnapshotEntry_t);
+    char *text = (char *)entries + entriesSize;
+
+    if (header->magic != CONFIG_SNAPSHOT_MAGIC ||
+        header->version != CONFIG_SNAPSHOT_VERSION ||
+        fileSize != sizeof(configSnapshotHeader_t) + entriesSize + header->textSize ||
+        header->sourceSize != sourceSize ||
+        header->sourceHash != sourceHash ||
+        (paramsHash != 0 && header->paramsHash != paramsHash)) {
+        uPortFree(buffer);
+        return U_ERROR_COMMON_NOT_FOUND;
+    }
+
+    uint32_t crc = crc32_ieee((uint8_t *)entries, entriesSize);
+    crc = crc32_ieee_update(crc, (uint8_t *)text, header->textSize);
+    if (crc != header->crc) {
+        writeWarn("Configuration snapshot for '%s' is corrupt", filename);
+        uPortFree(buffer);
+        return U_ERROR_COMMON_NOT_FOUND;
+    }
+
+    appConfig_t *configList = (appConfig_t *)pUPortMalloc(MAX(header->count, 1) * sizeof(appConfig_t));
+    if (configList == NULL) {
+        uPortFree(buffer);
+        return U_ERROR_COMMON_NO_MEMORY;
+    }
+
+    for(size_t i=0; i<header->count; i++) {
+        configList[i].key = text + entries[i].keyOffset;
+        configList[i].value = entries[i].valueOffset == CONFIG_SNAPSHOT_NULL_OFFSET ?
+                                NULL : text + entries[i].valueOffset;
+        configList[i].layer = layer;
+    }
+
+    // the text is freed from the start of the snapshot buffer
+    data->list = configList;
+    data->text = buffer;
+    data->count = header->count;
+
+    return U_ERROR_COMMON_SUCCESS;
+}
+
+/// @brief Reads the configuration file in a single read and parses it
+/// @param pSourceHash Where to put the hash of the file contents
+/// @return 0 on success, negative on failure
+static int32_t readConfigFile(configLayerData_t *data, configLayer_t layer, const char *filename, size_t fileSize,
+                              uint32_t *pSourceHash)
+{
+    char *configText = (char *)pUPortMalloc(fileSize + 1);
+    if (configText == NULL) {
+        writeError("Failed to allocate memory for loading in configuration file, size: %d", fileSize);
+        return U_ERROR_COMMON_NO_MEMORY;
+    }
+
+    int32_t count = -1;
+    char path[EXT_FS_MAX_PATH_SIZE];
+    fs_file_t_init(&configFile);
+    int32_t success = fs_open(&configFile, extFsMakePath(path, sizeof(path), filename), FS_O_READ);
+    if (success == 0) {
+        count = fs_read(&configFile, configText, fileSize);
+        fs_close(&configFile);
+    }
+
+    if (count != fileSize) {
+        writeError("Failed to read configuration file '%s': %d", filename, success < 0 ? success : count);
+        uPortFree(configText);
+        return U_ERROR_COMMON_NOT_FOUND;
+    }
+
+    configText[fileSize] = 0;
+    data->text = configText;
+
+    // hashed before parsing, which splits the text up in place
+    *pSourceHash = hashConfigText(FNV_OFFSET_BASIS, configText, fileSize);
+
+    parseConfiguration(data, layer, configText);
+
+    return U_ERROR_COMMON_SUCCESS;
+}
+
+/// @brief Reads a whole file into a new buffer, which must be freed
+/// @return The buffer, null terminated, or NULL on failure
+static char *readWholeFile(const char *path, size_t *pSize)
+{
+    if (!extFsFileSize(path, pSize))
+        return NULL;
+
+    char *buffer = (char *)pUPortMalloc(*pSize + 1);
+    if (buffer == NULL)
+        return NULL;
+
+    struct fs_file_t file;
+    fs_file_t_init(&file);
+    int32_t count = -1;
+    if (fs_open(&file, path, FS_O_READ) == 0) {
+        count = fs_read(&file, buffer, *pSize);
+        fs_close(&file);
+    }
+
+    if (count != *pSize) {
+        uPortFree(buffer);
+        return NULL;
+    }
+
+    buffer[*pSize] = 0;
+
+    return buffer;
+}
+
+static int32_t writeWholeFile(const char *path, const char *buffer, size_t size)
+{
+    if (extFsFileExists(path))
+        fs_unlink(path);
+
+    struct fs_file_t file;
+    fs_file_t_init(&file);
+    if (fs_open(&file, path, FS_O_CREATE | FS_O_WRITE) < 0)
+        return U_ERROR_COMMON_DEVICE_ERROR;
+
+    int32_t count = fs_write(&file, buffer, size);
+    int32_t result = fs_close(&file);
+
+    return (count == size && result == 0) ? U_ERROR_COMMON_SUCCESS : U_ERROR_COMMON_DEVICE_ERROR;
+}
+
+/// @brief Validates a configuration text, which is parsed in place.
+///        Each line must be a key and value, and the values of any keys
+///        which are in the registered schemas must be valid.
+/// @return The number of key value pairs, or negative if invalid
+static int32_t validateConfigText(char *text)
+{
+    int32_t count = 0;
+    char *line;
+    while((line = strtok_r(text, "\r\n", &text)) != NULL) {
+        char *key = strtok_r(line, " ", &line);
+        char *value = strtok_r(NULL, " ", &line);
+        if (key == NULL)
+            continue;
+
+        if (value == NULL || strtok_r(NULL, " ", &line) != NULL) {
+            writeWarn("Invalid configuration line for '%s'", key);
+            return U_ERROR_COMMON_INVALID_PARAMETER;
+        }
+
+        const configSchema_t *entry = findSchemaEntry(key);
+        if (entry != NULL && strncmp(value, "NULL", 4) != 0 && !isValidSchemaValue(entry, value)) {
+            writeWarn("Invalid configuration value '%s' for '%s'", value, key);
+            return U_ERROR_COMMON_INVALID_PARAMETER;
         }
 
         count++;
-    } while(true);
+    }
 
-    return count;
+    return count > 0 ? count : U_ERROR_COMMON_INVALID_PARAMETER;
+}
+
+/// @brief Replaces the configuration file with the temporary file and reloads it
+static int32_t swapConfigFile(const char *filename, const char *tempPath)
+{
+    // the rename replaces the configuration file in one step
+    char path[EXT_FS_MAX_PATH_SIZE];
+    int32_t result = fs_rename(tempPath, extFsMakePath(path, sizeof(path), filename));
+    if (result < 0) {
+        writeError("Failed to replace the configuration file '%s': %d", filename, result);
+        return U_ERROR_COMMON_DEVICE_ERROR;
+    }
+
+    deleteConfigSnapshot(filename);
+
+    return loadConfigLayer(findConfigLayer(filename), filename);
 }
 
 static bool checkWrittenCount(ssize_t writeCount, int32_t paramSize)
@@ -128,6 +832,97 @@ static int32_t writeParam(const char *configParams[], int32_t paramIndex)
     return U_ERROR_COMMON_SUCCESS;
 }
 
+/// @brief Merges the configuration layers and parses them into the schemas
+static void applyConfigLayers(void)
+{
+    mergeConfigLayers();
+    missingKeyCount = 0;
+
+    if (applyConfigSchemas() > 0)
+        writeWarn("Configuration has invalid values");
+}
+
+/// @brief Loads a configuration layer from its snapshot, or parses the configuration
+///        file if the snapshot is out of date. If the configuration parameters
+///        are given the configuration file is only rewritten if they have changed.
+/// @param layer The configuration layer to load
+/// @param filename The filename of the configuration file
+/// @param configParams The compiled in configuration parameters, or NULL
+/// @param configParamsSize The number of compiled in configuration parameters
+/// @param required If the configuration file must exist
+/// @return 0 on success, negative on failure
+static int32_t loadConfigLayerFile(configLayer_t layer, const char *filename, const char *configParams[],
+                                   int32_t configParamsSize, bool required)
+{
+    int32_t errorCode;
+    int32_t startTime = uPortGetTickTimeMs();
+    bool fromSnapshot = false;
+    size_t fileSize = 0;
+    configLayerData_t *data = &configLayers[layer];
+
+    if (!canReloadConfigLayer(layer, 0)) {
+        writeError("Failed to reload configuration '%s', restart to apply it", filename);
+        return U_ERROR_COMMON_NO_MEMORY;
+    }
+
+    // loading replaces what was loaded in to this layer
+    if (data->text != NULL)
+        retireConfigLayer(layer);
+    snprintf(data->filename, CONFIG_FILENAME_MAX_SIZE, "%s", filename);
+
+    // reloading keeps the hash of the compiled in parameters, so that a
+    // configuration update is kept until the compiled in parameters change
+    uint32_t paramsHash = data->paramsHash;
+    if (configParams != NULL && configParamsSize > 0)
+        paramsHash = hashConfigParams(configParams, configParamsSize);
+
+    char pathBuffer[EXT_FS_MAX_PATH_SIZE];
+    const char *path = getConfigPath(pathBuffer, sizeof(pathBuffer), filename, "");
+    uint32_t sourceHash;
+    bool fileExists = extFsFileSize(path, &fileSize);
+    if (fileExists && hashConfigFile(path, fileSize, &sourceHash) == 0)
+        fromSnapshot = loadConfigSnapshot(data, layer, filename, paramsHash, fileSize, sourceHash) == 0;
+
+    if (!fromSnapshot && configParams != NULL && configParamsSize > 0) {
+        errorCode = saveConfigFile(filename, configParams, configParamsSize);
+        if (errorCode < 0) {
+            applyConfigLayers();
+            return errorCode;
+        }
+
+        fileExists = extFsFileSize(path, &fileSize);
+    }
+
+    if (!fromSnapshot) {
+        if (!fileExists) {
+            applyConfigLayers();
+            if (!required) {
+                printDebug("No %s configuration file '%s'", configLayerNames[layer], filename);
+                return U_ERROR_COMMON_SUCCESS;
+            }
+
+            writeError("Configuration file '%s' not found on file system", filename);
+            return U_ERROR_COMMON_NOT_FOUND;
+        }
+
+        errorCode = readConfigFile(data, layer, filename, fileSize, &sourceHash);
+        if (errorCode < 0) {
+            applyConfigLayers();
+            return errorCode;
+        }
+
+        saveConfigSnapshot(data, filename, paramsHash, fileSize, sourceHash);
+    }
+
+    data->paramsHash = paramsHash;
+    applyConfigLayers();
+
+    writeInfo("Loaded %s configuration '%s' from %s in %d ms", configLayerNames[layer], filename,
+                fromSnapshot ? "snapshot" : "file", uPortGetTickTimeMs() - startTime);
+
+    return U_ERROR_COMMON_SUCCESS;
+}
+
 /* ----------------------------------------------------------------
  * PUBLIC FUNCTIONS
  * -------------------------------------------------------------- */
@@ -147,7 +942,8 @@ int32_t saveConfigFile(const char *filename, const char *configParams[], int32_t
         return U_ERROR_COMMON_NOT_FOUND;
     }
 
-    const char *path = extFsPath(filename);
+    char pathBuffer[EXT_FS_MAX_PATH_SIZE];
+    const char *path = extFsMakePath(pathBuffer, sizeof(pathBuffer), filename);
 
     if (extFsFileExists(path)) {
         printDebug("Found old config file, deleting...");
@@ -169,99 +965,217 @@ int32_t saveConfigFile(const char *filename, const char *configParams[], int32_t
 
     fs_close(&configFile);
 
+    // the snapshot is made again when the configuration file is loaded
+    deleteConfigSnapshot(filename);
+
     return errorCode;
 }
 
-/// @brief Loads a configuration file ready for indexing. Can load multiple config files
+/// @brief Loads a configuration file, and indexes it by key
 /// @param filename The filename of the configuration file
 /// @return 0 on success, negative on failure
 int32_t loadConfigFile(const char *filename)
 {
-    int32_t success;
-    int32_t errorCode = U_ERROR_COMMON_SUCCESS;
+    return loadConfig(filename, NULL, 0);
+}
+
+/// @brief Loads the configuration from its snapshot, or parses the configuration
+///        file if the snapshot is out of date. If the configuration parameters
+///        are given the configuration file is only rewritten if they have changed.
+/// @param filename The filename of the configuration file
+/// @param configParams The compiled in configuration parameters, or NULL
+/// @param configParamsSize The number of compiled in configuration parameters
+/// @return 0 on success, negative on failure
+int32_t loadConfig(const char *filename, const char *configParams[], int32_t configParamsSize)
+{
+    return loadConfigLayerFile(CONFIG_LAYER_DEVICE, filename, configParams, configParamsSize, true);
+}
+
+/// @brief Loads a configuration layer from a configuration file, replacing
+///        what was loaded in to that layer. A missing file leaves the layer empty.
+/// @param layer The configuration layer, device or remote
+/// @param filename The filename of the configuration file
+/// @return 0 on success, negative on failure
+int32_t loadConfigLayer(configLayer_t layer, const char *filename)
+{
+    if (layer <= CONFIG_LAYER_COMPILED || layer >= CONFIG_LAYER_COUNT)
+        return U_ERROR_COMMON_INVALID_PARAMETER;
+
+    return loadConfigLayerFile(layer, filename, NULL, 0, false);
+}
+
+/// @brief Updates the configuration file with a new configuration. The new
+///        configuration is written to a temporary file, read back and validated,
+///        and then renamed over the configuration file and reloaded. The
+///        previous configuration file is kept for restoreConfigFile().
+/// @param filename The filename of the configuration file
+/// @param pText The new configuration text
+/// @param size The size of the new configuration text
+/// @return 0 on success, negative on failure
+int32_t updateConfigFile(const char *filename, const char *pText, size_t size)
+{
+    char tempPathBuffer[EXT_FS_MAX_PATH_SIZE];
+    char backupPathBuffer[EXT_FS_MAX_PATH_SIZE];
+    const char *tempPath = getConfigPath(tempPathBuffer, sizeof(tempPathBuffer), filename, CONFIG_TEMP_EXTENSION);
+    const char *backupPath = getConfigPath(backupPathBuffer, sizeof(backupPathBuffer), filename, CONFIG_BACKUP_EXTENSION);
 
-    const char *path = extFsPath(filename);
-    if (!extFsFileExists(path)) {
-        writeError("Cconfiguration file not found on file system");
-        errorCode = U_ERROR_COMMON_NOT_FOUND;
-        goto cleanUp;
+    // a reload is kept for restoring the configuration if the update fails
+    if (!canReloadConfigLayer(findConfigLayer(filename), 1)) {
+        writeError("Too many configuration updates for '%s', restart to apply more", filename);
+        return U_ERROR_COMMON_NO_MEMORY;
     }
 
-    size_t fileSize;
-    success = extFsFileSize(path, &fileSize);
-    if (!success) {
-        writeError("Failed to get filesize of configuration file '%s': %d", filename, success);
-        errorCode =  U_ERROR_COMMON_NOT_FOUND;
-        goto cleanUp;
+    int32_t errorCode = writeWholeFile(tempPath, pText, size);
+    if (errorCode < 0) {
+        writeError("Failed to write the configuration update for '%s'", filename);
+        return errorCode;
     }
 
-    configText = (char *)pUPortMalloc(fileSize);
-    if (configText == NULL) {
-        writeError("Failed to allocate memory for loading in configuration file, size: %d", fileSize);
-        errorCode = U_ERROR_COMMON_NO_MEMORY;
-        goto cleanUp;
+    // validate what was written, not what was received
+    size_t readSize;
+    char *buffer = readWholeFile(tempPath, &readSize);
+    if (buffer == NULL || readSize != size) {
+        writeError("Failed to read back the configuration update for '%s'", filename);
+        errorCode = U_ERROR_COMMON_DEVICE_ERROR;
+    } else {
+        errorCode = validateConfigText(buffer);
     }
 
-    fs_file_t_init(&configFile);
-    success = fs_open(&configFile, path, FS_O_READ);
-    if (success < 0) {
-        writeError("Failed to open configuration file: %d", success);
-        errorCode = U_ERROR_COMMON_NOT_FOUND;
-        goto cleanUp;
+    uPortFree(buffer);
+
+    if (errorCode < 0) {
+        fs_unlink(tempPath);
+        return errorCode;
     }
 
-    size_t count;
-    char *buffer = configText;
-    while((count = fs_read(&configFile, buffer, FILE_READ_BUFFER)) > 0) {
-        buffer = buffer + count;
+    int32_t count = errorCode;
+
+    // keep the current configuration for a rollback, which is empty if there
+    // is no configuration file yet, as for the first remote configuration
+    size_t currentSize = 0;
+    buffer = NULL;
+    char configPath[EXT_FS_MAX_PATH_SIZE];
+    extFsMakePath(configPath, sizeof(configPath), filename);
+    if (extFsFileExists(configPath)) {
+        buffer = readWholeFile(configPath, &currentSize);
+        errorCode = buffer != NULL ? U_ERROR_COMMON_SUCCESS : U_ERROR_COMMON_DEVICE_ERROR;
     }
 
-    parseConfiguration(configText, &configList);
+    if (errorCode >= 0)
+        errorCode = writeWholeFile(backupPath, buffer != NULL ? buffer : "", currentSize);
 
-cleanUp:
-    if (errorCode != 0) {
-        uPortFree(configText);
+    uPortFree(buffer);
+    if (errorCode < 0) {
+        writeError("Failed to back up the configuration file '%s'", filename);
+        fs_unlink(tempPath);
+        return errorCode;
     }
 
-    fs_close(&configFile);
+    writeLog("Updating configuration file '%s' with %d key values", filename, count);
 
-    return errorCode;
+    return swapConfigFile(filename, tempPath);
 }
 
-void printConfiguration(void)
+/// @brief Restores the configuration file from before the last update, and reloads it
+/// @param filename The filename of the configuration file
+/// @return 0 on success, negative on failure
+int32_t restoreConfigFile(const char *filename)
 {
-    size_t count=1;
-    appConfigList_t *kvp = configList;
-    const char *value;
+    char tempPathBuffer[EXT_FS_MAX_PATH_SIZE];
+    char backupPathBuffer[EXT_FS_MAX_PATH_SIZE];
+    const char *tempPath = getConfigPath(tempPathBuffer, sizeof(tempPathBuffer), filename, CONFIG_TEMP_EXTENSION);
+    const char *backupPath = getConfigPath(backupPathBuffer, sizeof(backupPathBuffer), filename, CONFIG_BACKUP_EXTENSION);
+
+    if (!canReloadConfigLayer(findConfigLayer(filename), 0)) {
+        writeError("Too many configuration updates for '%s', restart to restore it", filename);
+        return U_ERROR_COMMON_NO_MEMORY;
+    }
+
+    size_t size;
+    char *buffer = readWholeFile(backupPath, &size);
+    if (buffer == NULL) {
+        writeError("No backup of the configuration file '%s' to restore", filename);
+        return U_ERROR_COMMON_NOT_FOUND;
+    }
 
-    while(kvp != NULL) {
-        value = getConfig(kvp->key);
+    int32_t errorCode = writeWholeFile(tempPath, buffer, size);
+    uPortFree(buffer);
+    if (errorCode < 0)
+        return errorCode;
+
+    writeLog("Restoring the previous configuration file '%s'", filename);
+
+    return swapConfigFile(filename, tempPath);
+}
+
+void printConfiguration(void)
+{
+    k_mutex_lock(&configListMutex, K_FOREVER);
+    for(size_t i=0; i<configCount; i++) {
+        const char *value = configList[i].value;
         if (value == NULL) value = "N/A";
-        printDebug("   Key #%d: %s = %s", count, kvp->key, value);
+        printDebug("   Key #%d: %s = %s (%s)", i + 1, configList[i].key, value,
+                    configLayerNames[configList[i].layer]);
+    }
+    k_mutex_unlock(&configListMutex);
 
-        kvp = kvp->pNext;
-        count++;
+    // the schema keys which are not in a configuration file use their compiled defaults
+    for(size_t i=0; i<configSchemaCount; i++) {
+        for(size_t j=0; j<configSchemas[i].count; j++) {
+            const configSchema_t *entry = &configSchemas[i].schema[j];
+            if (findConfig(entry->key, NULL))
+                continue;
+
+            if (entry->type == CONFIG_TYPE_STRING)
+                printDebug("   %s = %s (%s)", entry->key, entry->pDefaultString != NULL ? entry->pDefaultString : "N/A",
+                            configLayerNames[CONFIG_LAYER_COMPILED]);
+            else
+                printDebug("   %s = %d (%s)", entry->key, entry->defaultValue, configLayerNames[CONFIG_LAYER_COMPILED]);
+        }
     }
 
     printDebug("");
 }
 
+/// @brief Returns the layer which a configuration value comes from
+/// @param key The configuration name
+/// @return The configuration layer, compiled if only the schema's default
+///         is used, or CONFIG_LAYER_NONE if the key is not configured
+configLayer_t getConfigLayer(const char *key)
+{
+    appConfig_t config;
+    if (findConfig(key, &config))
+        return config.layer;
+
+    if (findSchemaEntry(key) != NULL)
+        return CONFIG_LAYER_COMPILED;
+
+    return CONFIG_LAYER_NONE;
+}
+
+/// @brief Returns the name of a configuration layer
+/// @param layer The configuration layer
+/// @return The name of the layer
+const char *getConfigLayerName(configLayer_t layer)
+{
+    if (layer < 0 || layer >= CONFIG_LAYER_COUNT)
+        return "none";
+
+    return configLayerNames[layer];
+}
+
 /// @brief Returns the specified configuration value
 /// @param key The configuration name to return the value of
 /// @return The configuration value on succes, NULL on failure
 const char *getConfig(const char *key)
 {
-    for(appConfigList_t *kvp = configList; kvp != NULL; kvp=kvp->pNext) {
-        if (strcmp(kvp->key, key) == 0) {
-            if (strncmp(kvp->value, "NULL", 4) == 0)
-                return NULL;
-            else
-                return kvp->value;
-        }
+    appConfig_t config;
+    if (!findConfig(key, &config)) {
+        warnMissingKey(key);
+        return NULL;
     }
 
-    printWarn("Failed to find '%s' key", key);
-    return NULL;
+    return config.value;
 }
 
 /// @brief Sets an int value from a configuration key, if present
@@ -292,15 +1206,49 @@ bool setBoolParamFromConfig(const char *key, const char *compare, bool *param)
     return true;
 }
 
+/// @brief Registers a configuration schema, which is parsed into its values
+///        now if the configuration is loaded, and whenever it is loaded again.
+/// @param schema The configuration schema array, which must stay in scope
+/// @param count The number of entries in the schema array
+/// @return 0 on success, negative on failure
+int32_t registerConfigSchema(const configSchema_t *schema, size_t count)
+{
+    if (schema == NULL || count == 0)
+        return U_ERROR_COMMON_INVALID_PARAMETER;
+
+    if (configSchemaCount >= CONFIG_MAX_SCHEMAS) {
+        writeError("Failed to register configuration schema, maximum is %d", CONFIG_MAX_SCHEMAS);
+        return U_ERROR_COMMON_NO_MEMORY;
+    }
+
+    configSchemas[configSchemaCount].schema = schema;
+    configSchemas[configSchemaCount].count = count;
+    configSchemaCount++;
+
+    // the defaults are set even if there is no configuration loaded
+    for(size_t i=0; i<count; i++)
+        applySchemaEntry(&schema[i]);
+
+    return U_ERROR_COMMON_SUCCESS;
+}
+
 /// @brief frees memory from the configuration malloced array
 void closeConfig(void)
 {
-    appConfigList_t *pCfg = configList;
-    for(appConfigList_t *kvp = configList; kvp != NULL && pCfg != NULL;) {
-        kvp=pCfg->pNext;
-        uPortFree(pCfg);
-        pCfg = kvp;
-    }
+    k_mutex_lock(&configListMutex, K_FOREVER);
+    if (!configListRetired)
+        uPortFree(configList);
+
+    configList = NULL;
+    configCount = 0;
+    k_mutex_unlock(&configListMutex);
+    configListRetired = false;
+
+    for(int32_t layer=0; layer<CONFIG_LAYER_COUNT; layer++)
+        clearConfigLayer((configLayer_t)layer);
 
-    uPortFree(configText);
-}
\ No newline at end of file
+    freeRetiredConfigs();
+
+    // the string values pointed in to the configuration text
+    applyConfigSchemas();
+}
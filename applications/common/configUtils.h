@@ -23,15 +23,86 @@
 #ifndef _CONFIG_UTILS_H_
 #define _CONFIG_UTILS_H_
 
+/* ----------------------------------------------------------------
+ * PUBLIC TYPE DEFINITIONS
+ * -------------------------------------------------------------- */
+/// @brief The configuration layers, where a key in a higher layer overrides
+///        the same key in the layers below it
+typedef enum {
+    CONFIG_LAYER_NONE = -1,
+    CONFIG_LAYER_COMPILED,  // the schema defaults, from config.h
+    CONFIG_LAYER_DEVICE,    // the device configuration file
+    CONFIG_LAYER_REMOTE,    // the remote configuration file, from a configuration update
+    CONFIG_LAYER_COUNT
+} configLayer_t;
+
+/// @brief The type of a configuration value in a configuration schema
+typedef enum {
+    CONFIG_TYPE_STRING,     // const char *, NULL if not set
+    CONFIG_TYPE_INT,        // int32_t, range checked with min/max
+    CONFIG_TYPE_BOOL        // bool, true if the value matches pTrueValue
+} configType_t;
+
+/// @brief A configuration schema entry, describing a configuration key and
+///        where its parsed value is stored
+typedef struct {
+    const char *key;
+    configType_t type;
+    int32_t defaultValue;       // default for INT and BOOL types
+    int32_t minValue;           // range for INT types
+    int32_t maxValue;
+    const char *pTrueValue;     // value which is 'true' for BOOL types
+    const char *pDefaultString; // default for STRING types
+    void *pValue;               // where the parsed value is written to
+} configSchema_t;
+
+/// Helpers to declare the configuration schema entries
+#define CONFIG_STRING(key, pValue)                          {key, CONFIG_TYPE_STRING, 0, 0, 0, NULL, NULL, pValue}
+#define CONFIG_STRING_DEFAULT(key, def, pValue)             {key, CONFIG_TYPE_STRING, 0, 0, 0, NULL, def, pValue}
+#define CONFIG_INT(key, def, min, max, pValue)              {key, CONFIG_TYPE_INT, def, min, max, NULL, NULL, pValue}
+#define CONFIG_BOOL(key, def, pTrueValue, pValue)           {key, CONFIG_TYPE_BOOL, def, 0, 1, pTrueValue, NULL, pValue}
+
 /* ----------------------------------------------------------------
  * PUBLIC FUNCTIONS
  * -------------------------------------------------------------- */
 
-/// @brief Loads a configuration file ready for indexing
+/// @brief Loads a configuration file and indexes it by key, replacing
+///        any previously loaded configuration
 /// @param filename The filename of the configuration file
 /// @return 0 on success, negative on failure
 int32_t loadConfigFile(const char *filename);
 
+/// @brief Loads the device configuration layer from its snapshot, or parses the
+///        configuration file if the snapshot is out of date. If the configuration
+///        parameters are given the configuration file is only rewritten if they
+///        have changed.
+/// @param filename The filename of the configuration file
+/// @param configParams The compiled in configuration parameters, or NULL
+/// @param configParamsSize The number of compiled in configuration parameters
+/// @return 0 on success, negative on failure
+int32_t loadConfig(const char *filename, const char *configParams[], int32_t configParamsSize);
+
+/// @brief Loads a configuration layer from a configuration file, replacing
+///        what was loaded in to that layer. A missing file leaves the layer empty.
+/// @param layer The configuration layer, device or remote
+/// @param filename The filename of the configuration file
+/// @return 0 on success, negative on failure
+int32_t loadConfigLayer(configLayer_t layer, const char *filename);
+
+/// @brief Updates the configuration file with a new configuration. The new
+///        configuration is written to a temporary file, read back and validated,
+///        and then renamed over the configuration file and reloaded.
+/// @param filename The filename of the configuration file
+/// @param pText The new configuration text, "KEY VALUE" lines
+/// @param size The size of the new configuration text
+/// @return 0 on success, negative on failure
+int32_t updateConfigFile(const char *filename, const char *pText, size_t size);
+
+/// @brief Restores the configuration file from before the last update, and reloads it
+/// @param filename The filename of the configuration file
+/// @return 0 on success, negative on failure
+int32_t restoreConfigFile(const char *filename);
+
 /// @brief Saves the CONFIG_FILE_CONTENTS defined above
 /// @param filename The filename of the configuration file
 /// @param configParams The char array of the parameters (key value pair)
@@ -39,9 +110,20 @@ int32_t loadConfigFile(const char *filename);
 /// @return 0 on success, negative on failure
 int32_t saveConfigFile(const char *filename, const char *configParams[], int32_t configParamsSize);
 
-/// @brief Prints the configuration list
+/// @brief Prints the configuration list, and the layer each value comes from
 void printConfiguration(void);
 
+/// @brief Returns the layer which a configuration value comes from
+/// @param key The configuration name
+/// @return The configuration layer, compiled if only the schema's default
+///         is used, or CONFIG_LAYER_NONE if the key is not configured
+configLayer_t getConfigLayer(const char *key);
+
+/// @brief Returns the name of a configuration layer
+/// @param layer The configuration layer
+/// @return The name of the layer
+const char *getConfigLayerName(configLayer_t layer);
+
 /// @brief returns the specified configuration value
 /// @param key The configuration name to return the value of
 /// @return The configuration value on succes, NULL on failure
@@ -59,6 +141,14 @@ bool setIntParamFromConfig(const char *key, int32_t *param);
 /// @return True if the bool value was set, False otherwise
 bool setBoolParamFromConfig(const char *key, const char *value, bool *param);
 
+/// @brief Registers a configuration schema, which is parsed into its values
+///        now if the configuration is loaded, and whenever it is loaded again.
+///        Invalid values are reported and their default is used.
+/// @param schema The configuration schema array, which must stay in scope
+/// @param count The number of entries in the schema array
+/// @return 0 on success, negative on failure
+int32_t registerConfigSchema(const configSchema_t *schema, size_t count);
+
 /// @brief Clears down the memory allocated by the configuration
 void closeConfig(void);
 
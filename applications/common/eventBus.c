@@ -0,0 +1,184 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *
+ * Application event bus. The network, MQTT, time and exit state changes
+ * are published here, so the tasks can wait for them or handle them as
+ * they happen.
+ *
+ */
+
+#include "common.h"
+#include "eventBus.h"
+
+/* ----------------------------------------------------------------
+ * TYPE DEFINITIONS
+ * -------------------------------------------------------------- */
+typedef struct {
+    appEvent_t event;
+    eventHandler_t handler;
+    void *pContext;
+} eventSubscriber_t;
+
+/* ----------------------------------------------------------------
+ * STATIC VARIABLES
+ * -------------------------------------------------------------- */
+K_MUTEX_DEFINE(eventMutex);
+K_CONDVAR_DEFINE(eventPublished);
+
+// Subscribers are only ever added, so the ones below the count read with
+// the mutex held don't change and can be called without it
+static eventSubscriber_t subscribers[EVENT_BUS_MAX_SUBSCRIBERS];
+static size_t subscriberCount = 0;
+
+static uint32_t activeEvents = 0;
+static uint32_t eventCount = 0;
+
+/// The event each event ends, if it has one
+static const int32_t oppositeEvents[MAX_APP_EVENTS] = {
+    [EVENT_NETWORK_UP] = EVENT_NETWORK_DOWN,
+    [EVENT_NETWORK_DOWN] = EVENT_NETWORK_UP,
+    [EVENT_MQTT_CONNECTED] = EVENT_MQTT_DISCONNECTED,
+    [EVENT_MQTT_DISCONNECTED] = EVENT_MQTT_CONNECTED,
+    [EVENT_TIME_VALID] = -1,
+    [EVENT_EXIT_REQUESTED] = -1
+};
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+static uint32_t eventBit(appEvent_t event)
+{
+    return 1u << event;
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+int32_t subscribeToEvent(appEvent_t event, eventHandler_t handler, void *pContext)
+{
+    if ((uint32_t)event >= MAX_APP_EVENTS || handler == NULL)
+        return U_ERROR_COMMON_INVALID_PARAMETER;
+
+    int32_t errorCode = U_ERROR_COMMON_NO_MEMORY;
+
+    k_mutex_lock(&eventMutex, K_FOREVER);
+    if (subscriberCount < EVENT_BUS_MAX_SUBSCRIBERS) {
+        subscribers[subscriberCount++] = (eventSubscriber_t){event, handler, pContext};
+        errorCode = U_ERROR_COMMON_SUCCESS;
+    }
+    k_mutex_unlock(&eventMutex);
+
+    if (errorCode < 0)
+        writeError("Can't subscribe to event %d, all %d subscribers are used", event, EVENT_BUS_MAX_SUBSCRIBERS);
+
+    return errorCode;
+}
+
+void publishEvent(appEvent_t event)
+{
+    if ((uint32_t)event >= MAX_APP_EVENTS)
+        return;
+
+    size_t handlerCount = 0;
+
+    k_mutex_lock(&eventMutex, K_FOREVER);
+    if ((activeEvents & eventBit(event)) == 0) {
+        activeEvents |= eventBit(event);
+        if (oppositeEvents[event] >= 0)
+            activeEvents &= ~eventBit(oppositeEvents[event]);
+
+        eventCount++;
+        k_condvar_broadcast(&eventPublished);
+        handlerCount = subscriberCount;
+    }
+    k_mutex_unlock(&eventMutex);
+
+    // the handlers are called without the mutex, so they can publish too
+    for(size_t i=0; i<handlerCount; i++) {
+        if (subscribers[i].event == event)
+            subscribers[i].handler(event, subscribers[i].pContext);
+    }
+}
+
+bool isEventActive(appEvent_t event)
+{
+    if ((uint32_t)event >= MAX_APP_EVENTS)
+        return false;
+
+    k_mutex_lock(&eventMutex, K_FOREVER);
+    bool active = (activeEvents & eventBit(event)) != 0;
+    k_mutex_unlock(&eventMutex);
+
+    return active;
+}
+
+int32_t waitForEvent(appEvent_t event, int32_t timeoutMs)
+{
+    if ((uint32_t)event >= MAX_APP_EVENTS)
+        return U_ERROR_COMMON_INVALID_PARAMETER;
+
+    int32_t errorCode = U_ERROR_COMMON_SUCCESS;
+    int64_t endTimeMs = getMonotonicTimeMs() + timeoutMs;
+
+    k_mutex_lock(&eventMutex, K_FOREVER);
+    while((activeEvents & eventBit(event)) == 0) {
+        if (activeEvents & eventBit(EVENT_EXIT_REQUESTED)) {
+            errorCode = U_ERROR_COMMON_CANCELLED;
+            break;
+        }
+
+        k_timeout_t timeout = K_FOREVER;
+        if (timeoutMs >= 0) {
+            int64_t remainingMs = endTimeMs - getMonotonicTimeMs();
+            if (remainingMs <= 0) {
+                errorCode = U_ERROR_COMMON_TIMEOUT;
+                break;
+            }
+
+            timeout = K_MSEC(remainingMs);
+        }
+
+        k_condvar_wait(&eventPublished, &eventMutex, timeout);
+    }
+    k_mutex_unlock(&eventMutex);
+
+    return errorCode;
+}
+
+uint32_t getEventCount(void)
+{
+    k_mutex_lock(&eventMutex, K_FOREVER);
+    uint32_t count = eventCount;
+    k_mutex_unlock(&eventMutex);
+
+    return count;
+}
+
+bool waitForNextEvent(uint32_t *pEventCount, int32_t timeoutMs)
+{
+    k_mutex_lock(&eventMutex, K_FOREVER);
+    if (eventCount == *pEventCount)
+        k_condvar_wait(&eventPublished, &eventMutex, K_MSEC(timeoutMs));
+
+    bool published = eventCount != *pEventCount;
+    *pEventCount = eventCount;
+    k_mutex_unlock(&eventMutex);
+
+    return published;
+}
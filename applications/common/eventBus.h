@@ -0,0 +1,100 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *
+ * Application event bus header
+ *
+ */
+
+#ifndef _EVENT_BUS_H_
+#define _EVENT_BUS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ----------------------------------------------------------------
+ * DEFINITIONS
+ * -------------------------------------------------------------- */
+/// The number of event handlers which can be subscribed, for all events
+#define EVENT_BUS_MAX_SUBSCRIBERS   16
+
+/* ----------------------------------------------------------------
+ * PUBLIC TYPE DEFINITIONS
+ * -------------------------------------------------------------- */
+/// @brief The application events. An event stays active once it is
+///        published, until its opposite event is published.
+typedef enum {
+    EVENT_NETWORK_UP,
+    EVENT_NETWORK_DOWN,
+    EVENT_MQTT_CONNECTED,
+    EVENT_MQTT_DISCONNECTED,
+    EVENT_TIME_VALID,
+    EVENT_EXIT_REQUESTED,
+    MAX_APP_EVENTS
+} appEvent_t;
+
+/// @brief Event handler, which is called in the thread publishing the
+///        event, which can be a ubxlib callback, so it must not block
+///        and must keep its stack use small
+typedef void (*eventHandler_t)(appEvent_t event, void *pContext);
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+/// @brief Subscribes a handler to an event. A handler can't be
+///        unsubscribed.
+/// @param event The event to handle
+/// @param handler The handler function
+/// @param pContext The context passed to the handler
+/// @return 0 on success, negative on failure
+int32_t subscribeToEvent(appEvent_t event, eventHandler_t handler, void *pContext);
+
+/// @brief Publishes an event, which wakes up the threads waiting for it
+///        and calls its handlers. Publishing an event which is already
+///        active does nothing. This is called from the ubxlib callbacks,
+///        so it only holds the event mutex for a moment, and the handlers
+///        are called without it.
+/// @param event The event to publish
+void publishEvent(appEvent_t event);
+
+/// @brief Checks if an event has been published, and its opposite hasn't
+///        been published since
+/// @param event The event to check
+/// @return true if the event is active, false otherwise
+bool isEventActive(appEvent_t event);
+
+/// @brief Waits for an event to be active
+/// @param event The event to wait for
+/// @param timeoutMs The time to wait for, or negative to wait forever
+/// @return 0 if the event is active, U_ERROR_COMMON_TIMEOUT if it didn't
+///         become active in time, or U_ERROR_COMMON_CANCELLED if the
+///         application is exiting
+int32_t waitForEvent(appEvent_t event, int32_t timeoutMs);
+
+/// @brief Gets the count of the events which have been published, for
+///        waitForNextEvent()
+/// @return The event count
+uint32_t getEventCount(void);
+
+/// @brief Waits for any event to be published after the event count
+/// @param pEventCount The event count to wait after, which is updated
+/// @param timeoutMs The time to wait for
+/// @return true if an event was published, false on timeout
+bool waitForNextEvent(uint32_t *pEventCount, int32_t timeoutMs);
+
+#endif
@@ -15,6 +15,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "ext_fs.h"
 
@@ -22,6 +23,9 @@
 FS_FSTAB_DECLARE_ENTRY(PARTITION_NODE);
 struct fs_mount_t *gMountPoint;
 
+static char mountPrefix[EXT_FS_MAX_PATH_SIZE];
+static size_t mountPrefixLength = 0;
+
 bool extFsInit()
 {
     gMountPoint = &FS_FSTAB_ENTRY(PARTITION_NODE);
@@ -29,6 +33,10 @@ bool extFsInit()
     // Fix for error in partition manager
     gMountPoint->storage_dev = 0;
 #endif
+    // the mount point name doesn't change, so the path prefix is made once
+    int length = snprintf(mountPrefix, sizeof(mountPrefix), "%s/", gMountPoint->mnt_point);
+    mountPrefixLength = (length > 0 && length < sizeof(mountPrefix)) ? length : 0;
+
     return fs_mount(gMountPoint) == 0;
 }
 
@@ -37,11 +45,17 @@ struct fs_mount_t *extFsMountPoint()
     return gMountPoint;
 }
 
-const char *extFsPath(const char *fileName)
+const char *extFsMakePath(char *pPath, size_t pathSize, const char *fileName)
 {
-    static char path[100];
-    snprintf(path, sizeof(path), "%s/%s", gMountPoint->mnt_point, fileName);
-    return path;
+    size_t nameLength = strlen(fileName);
+    if (mountPrefixLength + nameLength >= pathSize) {
+        pPath[0] = 0;
+        return pPath;
+    }
+
+    memcpy(pPath, mountPrefix, mountPrefixLength);
+    memcpy(pPath + mountPrefixLength, fileName, nameLength + 1);
+    return pPath;
 }
 
 unsigned long extFsFree()
@@ -56,13 +70,13 @@ unsigned long extFsFree()
 
 bool extFsFileExists(const char *fileName)
 {
-    static struct fs_dirent dirent;
+    struct fs_dirent dirent;
     return fs_stat(fileName, &dirent) == 0;
 }
 
 bool extFsFileSize(const char *fileName, size_t *size)
 {
-    static struct fs_dirent dirent;
+    struct fs_dirent dirent;
     bool ok = fs_stat(fileName, &dirent) == 0;
     *size = ok ? dirent.size : 0;
     return ok;
@@ -71,7 +85,8 @@ bool extFsFileSize(const char *fileName, size_t *size)
 void extFSList()
 {
     struct fs_dir_t dirp;
-    static struct fs_dirent entry;
+    struct fs_dirent entry;
+    char path[EXT_FS_MAX_PATH_SIZE];
 
     struct fs_statvfs sbuf;
     if (fs_statvfs(extFsMountPoint()->mnt_point, &sbuf) == 0) {
@@ -86,11 +101,8 @@ void extFSList()
     printf("\nDirectory listing:\n");
     printf("--------------------------------\n");
     while (fs_readdir(&dirp, &entry) == 0 && entry.name[0] != 0) {
-        const char *path = extFsPath(entry.name);
-        static struct fs_dirent dirent;
-        if (fs_stat(path, &dirent) != 0) {
-        }
-        printf("%-25s %6u\n", path, dirent.size);
+        extFsMakePath(path, sizeof(path), entry.name);
+        printf("%-25s %6u\n", path, entry.size);
     }
     fs_closedir(&dirp);
     printf("--------------------------------\n");
@@ -17,6 +17,9 @@
 #include <fs/fs.h>
 #include <zephyr.h>
 
+/** The size of a full file path buffer, including the mount point name. */
+#define EXT_FS_MAX_PATH_SIZE 100
+
 /**
  * Initiate little_fs on the external flash memory of the XPLR-IOT-1.
  * @return  Success or failure.
@@ -31,9 +34,15 @@ struct fs_mount_t *extFsMountPoint();
 
 /**
  * Get the full file system path including mount point name.
- * @return  Pointer to the full path.
+ * The path is written to the caller's buffer, so this can be
+ * used from any number of tasks at the same time.
+ * @param   pPath     Buffer for the full path.
+ * @param   pathSize  Size of the buffer, normally EXT_FS_MAX_PATH_SIZE.
+ * @param   fileName  File name on the file system.
+ * @return            Pointer to the full path in the buffer,
+ *                    which is empty if the path does not fit.
  */
-const char *extFsPath(const char *fileName);
+const char *extFsMakePath(char *pPath, size_t pathSize, const char *fileName);
 
 /**
  * Get the size of the free space on the file system in kB.
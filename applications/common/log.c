@@ -28,6 +28,10 @@
 #include "log.h"
 #include "ext_fs.h"
 
+#ifdef LOG_FILE_RECORD_FRAMING
+#include <sys/crc.h>
+#endif
+
 /* ----------------------------------------------------------------
  * DEFINITIONS
  * -------------------------------------------------------------- */
@@ -41,6 +45,38 @@
 
 #define FILE_READ_BUFFER 512
 
+// The log index file has one entry for each of these time buckets
+// which has log entries in it, pointing to the first entry's offset
+#define LOG_INDEX_BUCKET_SECONDS 60
+#define LOG_INDEX_EXTENSION ".idx"
+#define LOG_FILENAME_MAX_SIZE 32
+
+// Log file record framing
+#define LOG_RECORD_MAGIC_0 0xA5
+#define LOG_RECORD_MAGIC_1 0x5A
+
+#ifndef LOG_FILE_RECOVERY_TAIL_SIZE
+#define LOG_FILE_RECOVERY_TAIL_SIZE 4096
+#endif
+
+/* ----------------------------------------------------------------
+ * TYPE DEFINITIONS
+ * -------------------------------------------------------------- */
+/// @brief Log index entry, mapping a unix time to an offset in the log file
+typedef struct {
+    uint32_t time;
+    uint32_t offset;
+} logIndexEntry_t;
+
+/// @brief Log record header, which is followed by 'length' bytes of the log
+///        entry. The CRC covers the length, sequence and the log entry.
+typedef struct __attribute__((packed)) {
+    uint8_t magic[2];
+    uint16_t length;
+    uint32_t sequence;
+    uint32_t crc;
+} logRecordHeader_t;
+
 /* ----------------------------------------------------------------
  * STATIC VARIABLES
  * -------------------------------------------------------------- */
@@ -49,31 +85,318 @@ static char buff2[LOGBUFF2SIZE];
 
 static struct fs_file_t logFile;
 static bool logFileOpen = false;
+static char logFilename[LOG_FILENAME_MAX_SIZE];
+static char logFilePath[EXT_FS_MAX_PATH_SIZE];
+
+// The log index file is a sparse list of logIndexEntry_t
+static struct fs_file_t logIndexFile;
+static bool logIndexOpen = false;
+static char logIndexFilename[LOG_FILENAME_MAX_SIZE];
+static char logIndexPath[EXT_FS_MAX_PATH_SIZE];
+static size_t logFileOffset = 0;
+static uint32_t lastIndexBucket = 0;
+
+#ifdef LOG_FILE_RECORD_FRAMING
+static uint32_t logRecordSequence = 0;
+#endif
 
 static uPortMutexHandle_t pLogMutex = NULL;
 static uPortTimerHandle_t pFlushTimerHandle = NULL;
 
 static logLevels_t gLogLevel = eINFO;
 
+// effective log level of each module, so the level check is a single lookup
+static logLevels_t moduleLogLevel[LOG_MAX_MODULES] = {
+    [0 ... LOG_MAX_MODULES-1] = eINFO
+};
+static bool moduleLevelOverridden[LOG_MAX_MODULES];
+
 static bool flushLogFileCache = false;
 
-/* ----------------------------------------------------------------
- * GLOBAL VARIABLES
- * -------------------------------------------------------------- */
-/// The unix network time, which is retrieved after first registration
-int64_t unixNetworkTime = 0;
+static struct k_spinlock rateLimitLock;
 
 /* ----------------------------------------------------------------
  * STATIC FUNCTIONS
  * -------------------------------------------------------------- */
-static void createTimeStampLog(const char *log)
+static void createTimeStampLog(const char *log, uint32_t suppressed)
 {
     char timeStamp[TIMESTAMP_MAX_LENTH_BYTES];
     getTimeStamp(timeStamp);
-    snprintf(buff1, LOGBUFF1SIZE, "%s: %s\n", timeStamp, log);
+    if (suppressed > 0)
+        snprintf(buff1, LOGBUFF1SIZE, "%s: %s (%u similar messages suppressed)\n", timeStamp, log, suppressed);
+    else
+        snprintf(buff1, LOGBUFF1SIZE, "%s: %s\n", timeStamp, log);
+}
+
+/// @brief Gets the current unix time in seconds, if it is known
+/// @return the unix time, or zero if the network time is not known yet
+static uint32_t getLogTime(void)
+{
+    return (uint32_t)(getUnixTimeMs() / 1000);
+}
+
+/// @brief Creates the log index filename from the log filename, log.csv => log.idx
+static void setLogIndexFilename(const char *pFilename)
+{
+    snprintf(logIndexFilename, LOG_FILENAME_MAX_SIZE, "%s", pFilename);
+    char *extension = strrchr(logIndexFilename, '.');
+    if (extension != NULL)
+        *extension = 0;
+
+    strncat(logIndexFilename, LOG_INDEX_EXTENSION,
+                LOG_FILENAME_MAX_SIZE - strlen(logIndexFilename) - 1);
+
+    extFsMakePath(logIndexPath, EXT_FS_MAX_PATH_SIZE, logIndexFilename);
+}
+
+/// @brief Adds an index entry for the current log file offset if we have
+///        moved in to a new time bucket. Must be called inside the MUTEX lock.
+static void updateLogIndex(void)
+{
+    if (!logIndexOpen)
+        return;
+
+    uint32_t time = getLogTime();
+    if (time == 0)
+        return;
+
+    uint32_t bucket = time / LOG_INDEX_BUCKET_SECONDS;
+    if (bucket == lastIndexBucket)
+        return;
+
+    logIndexEntry_t entry = {time, (uint32_t)logFileOffset};
+    int result = fs_write(&logIndexFile, &entry, sizeof(entry));
+    if (result != sizeof(entry)) {
+        printf("Failed to write to log index file: %d", result);
+        return;
+    }
+
+    lastIndexBucket = bucket;
+}
+
+#ifdef LOG_FILE_RECORD_FRAMING
+static uint32_t getLogRecordCRC(const logRecordHeader_t *header, const void *data)
+{
+    uint32_t crc = crc32_ieee((const uint8_t *)&header->length, sizeof(header->length) + sizeof(header->sequence));
+    return crc32_ieee_update(crc, data, header->length);
+}
+
+/// @brief Writes a log entry to the log file as a framed record
+static int writeLogRecord(const void *data, size_t length)
+{
+    logRecordHeader_t header = {
+        .magic = {LOG_RECORD_MAGIC_0, LOG_RECORD_MAGIC_1},
+        .length = (uint16_t)length,
+        .sequence = logRecordSequence++
+    };
+    header.crc = getLogRecordCRC(&header, data);
+
+    int result = fs_write(&logFile, &header, sizeof(header));
+    if (result != sizeof(header))
+        return result < 0 ? result : U_ERROR_COMMON_DEVICE_ERROR;
+
+    logFileOffset += result;
+
+    return fs_write(&logFile, data, length);
+}
+
+/// @brief Checks if there is a valid log record at the position in the buffer
+/// @return true if the record is complete and its CRC is correct
+static bool isValidLogRecord(const uint8_t *buffer, size_t size, size_t pos, logRecordHeader_t *header)
+{
+    if (pos + sizeof(logRecordHeader_t) > size)
+        return false;
+
+    if (buffer[pos] != LOG_RECORD_MAGIC_0 || buffer[pos+1] != LOG_RECORD_MAGIC_1)
+        return false;
+
+    memcpy(header, buffer + pos, sizeof(logRecordHeader_t));
+    if (pos + sizeof(logRecordHeader_t) + header->length > size)
+        return false;
+
+    return getLogRecordCRC(header, buffer + pos + sizeof(logRecordHeader_t)) == header->crc;
+}
+
+/// @brief Scans the end of the log file for the last valid record, and
+///        removes anything after it, which is a torn record from a reset or
+///        power loss. Only the tail of the file is read, so the time taken
+///        does not depend on the size of the log file.
+static void recoverLogFile(void)
+{
+    size_t fileSize;
+    if (!extFsFileSize(logFilePath, &fileSize) || fileSize == 0)
+        return;
+
+    size_t tailSize = MIN(fileSize, LOG_FILE_RECOVERY_TAIL_SIZE);
+    size_t tailStart = fileSize - tailSize;
+    int32_t startTime = uPortGetTickTimeMs();
+
+    uint8_t *buffer = (uint8_t *)pUPortMalloc(tailSize);
+    if (buffer == NULL) {
+        printWarn("Not enough memory to check the log file");
+        return;
+    }
+
+    int result = readLogFile(tailStart, buffer, tailSize);
+    if (result != tailSize) {
+        printWarn("Failed to read the end of the log file: %d", result);
+        uPortFree(buffer);
+        return;
+    }
+
+    logRecordHeader_t header;
+    bool found = false;
+    size_t validEnd = 0;
+    size_t pos = 0;
+    while(pos + sizeof(logRecordHeader_t) <= tailSize) {
+        if (isValidLogRecord(buffer, tailSize, pos, &header)) {
+            found = true;
+            logRecordSequence = header.sequence + 1;
+            pos += sizeof(logRecordHeader_t) + header.length;
+            validEnd = pos;
+        } else {
+            pos++;
+        }
+    }
+
+    uPortFree(buffer);
+
+    if (!found) {
+        printWarn("No valid log records in the last %u bytes of the log file, it is not checked", tailSize);
+        return;
+    }
+
+    if (tailStart + validEnd < fileSize) {
+        result = fs_truncate(&logFile, tailStart + validEnd);
+        if (result == 0)
+            printWarn("Removed %u bytes of torn log record from the end of the log file", fileSize - tailStart - validEnd);
+        else
+            printWarn("Failed to remove the torn log record from the log file: %d", result);
+    }
+
+    printInfo("Checked the log file in %d ms, next record is #%u", uPortGetTickTimeMs() - startTime, logRecordSequence);
+}
+
+/// @brief Displays the log file records, checking their CRCs
+/// @return the number of bytes read from the log file
+static size_t printLogRecords(struct fs_file_t *file, size_t remaining)
+{
+    char buffer[FILE_READ_BUFFER];
+    logRecordHeader_t header;
+    size_t total = 0;
+
+    while(remaining >= sizeof(header) && fs_read(file, &header, sizeof(header)) == sizeof(header)) {
+        if (header.magic[0] != LOG_RECORD_MAGIC_0 || header.magic[1] != LOG_RECORD_MAGIC_1) {
+            printf("\n*** Invalid log record at offset %u ***\n", total);
+            break;
+        }
+
+        remaining -= sizeof(header);
+        total += sizeof(header);
+
+        uint32_t crc = crc32_ieee((const uint8_t *)&header.length, sizeof(header.length) + sizeof(header.sequence));
+        size_t length = header.length;
+        int count = 0;
+        while(length > 0 && remaining > 0 && (count = fs_read(file, buffer, MIN(length, FILE_READ_BUFFER))) > 0) {
+            crc = crc32_ieee_update(crc, (uint8_t *)buffer, count);
+            printf("%.*s", count, buffer);
+            length -= count;
+            remaining -= MIN(count, remaining);
+            total += count;
+        }
+
+        if (length > 0 || crc != header.crc)
+            printf("\n*** Log record #%u is corrupt ***\n", header.sequence);
+    }
+
+    return total;
+}
+#endif
+
+/// @brief Writes to the log file, keeping track of the file offset for the index
+static int writeLogFile(const void *data, size_t length)
+{
+#ifdef LOG_FILE_RECORD_FRAMING
+    int result = writeLogRecord(data, length);
+#else
+    int result = fs_write(&logFile, data, length);
+#endif
+    if (result > 0)
+        logFileOffset += result;
+
+    return result;
+}
+
+/// @brief Displays the log file contents, decoding the records if they are framed
+static void printLogData(struct fs_file_t *file, size_t remaining)
+{
+#ifdef LOG_FILE_RECORD_FRAMING
+    printLogRecords(file, remaining);
+#else
+    char buffer[FILE_READ_BUFFER];
+    int count;
+
+    while(remaining > 0 && (count = fs_read(file, buffer, MIN(remaining, FILE_READ_BUFFER))) > 0) {
+        printf("%.*s", count, buffer);
+        remaining -= count;
+    }
+#endif
+}
+
+/// @brief Reads an entry from the index file
+/// @return true if the entry was read
+static bool readLogIndexEntry(struct fs_file_t *indexFile, size_t entryIndex, logIndexEntry_t *entry)
+{
+    if (fs_seek(indexFile, entryIndex * sizeof(logIndexEntry_t), FS_SEEK_SET) != 0)
+        return false;
+
+    return fs_read(indexFile, entry, sizeof(logIndexEntry_t)) == sizeof(logIndexEntry_t);
+}
+
+/// @brief Binary search of the index file for the first entry after the time
+/// @return index of the first entry which has a time greater than 'time'
+static size_t searchLogIndex(struct fs_file_t *indexFile, size_t entryCount, uint32_t time)
+{
+    logIndexEntry_t entry;
+    size_t low = 0;
+    size_t high = entryCount;
+
+    while(low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (!readLogIndexEntry(indexFile, mid, &entry))
+            break;
+
+        if (entry.time <= time)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+static void openLogIndexFile(void)
+{
+    setLogIndexFilename(logFilename);
+
+    fs_file_t_init(&logIndexFile);
+    int result = fs_open(&logIndexFile, logIndexPath, FS_O_APPEND | FS_O_CREATE | FS_O_RDWR);
+    if (result != 0) {
+        printWarn("Failed to open log index file: %d\n Log time range queries will not be available.", result);
+        logIndexOpen = false;
+        return;
+    }
+
+    // the log is appended from the end of the current file
+    size_t fileSize;
+    logFileOffset = extFsFileSize(logFilePath, &fileSize) ? fileSize : 0;
+    lastIndexBucket = 0;
+    logIndexOpen = true;
 }
 
-static bool printHeader(logLevels_t level, bool writeToFile)
+/// @brief Gets the banner written before a log entry of this level
+/// @return The banner, or NULL if the level doesn't have one
+static const char *getLevelHeader(logLevels_t level)
 {
     const char *header = NULL;
     switch(level) {
@@ -97,15 +420,48 @@ static bool printHeader(logLevels_t level, bool writeToFile)
             break;
     }
 
-    if (header == NULL)
-        return false;
+    return header;
+}
 
-    printf("%s", header);
+/// @brief Takes a token from the rate limit's bucket, which is refilled with
+///        one token every LOG_RATE_LIMIT_INTERVAL_MS up to LOG_RATE_LIMIT_BURST
+/// @param pRateLimit The rate limit of the log entry
+/// @param pSuppressed The number of log entries suppressed since the last one
+/// @return True if the log entry can be written
+static bool takeRateLimitToken(logRateLimit_t *pRateLimit, uint32_t *pSuppressed)
+{
+    int64_t now = getMonotonicTimeMs();
+    bool allowed = false;
 
-    if (logFileOpen && writeToFile)
-        fs_write(&logFile, header, strlen(header));
+    k_spinlock_key_t key = k_spin_lock(&rateLimitLock);
 
-    return true;
+    if (!pRateLimit->started) {
+        pRateLimit->started = true;
+        pRateLimit->tokens = LOG_RATE_LIMIT_BURST;
+        pRateLimit->refillTimeMs = now;
+    } else if (pRateLimit->tokens >= LOG_RATE_LIMIT_BURST) {
+        pRateLimit->refillTimeMs = now;
+    } else {
+        int64_t refills = (now - pRateLimit->refillTimeMs) / LOG_RATE_LIMIT_INTERVAL_MS;
+        if (refills > 0) {
+            int64_t tokens = pRateLimit->tokens + refills;
+            pRateLimit->tokens = tokens < LOG_RATE_LIMIT_BURST ? tokens : LOG_RATE_LIMIT_BURST;
+            pRateLimit->refillTimeMs += refills * LOG_RATE_LIMIT_INTERVAL_MS;
+        }
+    }
+
+    if (pRateLimit->tokens > 0) {
+        pRateLimit->tokens--;
+        *pSuppressed = pRateLimit->suppressed;
+        pRateLimit->suppressed = 0;
+        allowed = true;
+    } else {
+        pRateLimit->suppressed++;
+    }
+
+    k_spin_unlock(&rateLimitLock, key);
+
+    return allowed;
 }
 
 static void flushTimerCallback(void *callbackHandle, void *param)
@@ -130,12 +486,18 @@ static void startFlushTimer()
 
 static bool openLogFile(const char *pFilename)
 {
+    snprintf(logFilename, LOG_FILENAME_MAX_SIZE, "%s", pFilename);
+    extFsMakePath(logFilePath, EXT_FS_MAX_PATH_SIZE, pFilename);
+
     fs_file_t_init(&logFile);
-    const char *path = extFsPath(pFilename);
-    int result = fs_open(&logFile, path, FS_O_APPEND | FS_O_CREATE | FS_O_RDWR);
+    int result = fs_open(&logFile, logFilePath, FS_O_APPEND | FS_O_CREATE | FS_O_RDWR);
 
     if (result == 0) {
         printLog("File logging enabled");
+#ifdef LOG_FILE_RECORD_FRAMING
+        recoverLogFile();
+#endif
+        openLogIndexFile();
         logFileOpen = true;
     } else {
         printError("Failed to open log file: %d\n Logging to the log file will not be available.", result);
@@ -161,53 +523,87 @@ void setLogLevel(logLevels_t logLevel)
 {
     printInfo("Setting log level to %d", logLevel);
     gLogLevel = logLevel;
+
+    for(int32_t i=0; i<LOG_MAX_MODULES; i++) {
+        if (!moduleLevelOverridden[i])
+            moduleLogLevel[i] = logLevel;
+    }
+}
+
+int32_t setModuleLogLevel(int32_t module, logLevels_t logLevel)
+{
+    if (module < 0 || module >= LOG_MAX_MODULES)
+        return U_ERROR_COMMON_INVALID_PARAMETER;
+
+    if (logLevel >= eMAXLOGLEVELS) {
+        printInfo("Setting log level of module %d to the default", module);
+        moduleLevelOverridden[module] = false;
+        moduleLogLevel[module] = gLogLevel;
+    } else {
+        printInfo("Setting log level of module %d to %d", module, logLevel);
+        moduleLevelOverridden[module] = true;
+        moduleLogLevel[module] = logLevel;
+    }
+
+    return U_ERROR_COMMON_SUCCESS;
+}
+
+/// @brief Checks the log level of a module
+/// @return True if a log entry of this level is logged for the module
+static bool isLogLevelEnabled(logLevels_t level, int32_t module)
+{
+    if ((uint32_t)module >= LOG_MAX_MODULES)
+        module = LOG_MODULE_APP;
+
+    return level >= moduleLogLevel[module];
 }
 
 /// @brief Writes a log message to the terminal and the log file
 /// @param log The log, which can contain string formating
-/// @param  ... The variables for the string format
-void _writeLog(const char *log, logLevels_t level, bool writeToFile, ...)
+/// @param suppressed The number of similar log entries which were suppressed
+/// @param arglist The variables for the string format
+static void writeLogEntry(const char *log, logLevels_t level, bool writeToFile, uint32_t suppressed, va_list arglist)
 {
     // writeLog("The %s value is %d", "rssi", 1234)
     // will log "<time>: The rssi value is 1234"
 
-    if (level < gLogLevel)
-        return;
-
     MUTEX_LOCK
 
         // DO NOT PUT PRINTLOG OR WRITELOG MARCOS INSIDE
         // THIS MUTEX LOCK - *ONLY* USE PRINTF() !!!!!!
 
-        createTimeStampLog(log);
+        createTimeStampLog(log, suppressed);
+
+        // the whole entry, with its level header, is built first so that it
+        // is written to the log file as one record
+        const char *header = getLevelHeader(level);
+        size_t length = 0;
+        if (header != NULL)
+            length = snprintf(buff2, LOGBUFF2SIZE, "%s", header);
+
+        // now construct the application's arguments into the log string,
+        // leaving room for the newline after an entry with a header
+        int count = vsnprintf(buff2 + length, LOGBUFF2SIZE - length - 1, buff1, arglist);
+        if (count > 0)
+            length += MIN((size_t)count, LOGBUFF2SIZE - length - 2);
 
-        // now construct the application's arguments into the log string
-        va_list arglist;
+        if (header != NULL) {
+            buff2[length++] = '\n';
+            buff2[length] = 0;
+        }
 
-        #pragma GCC diagnostic ignored "-Wvarargs"
-        va_start(arglist, buff1);
-        vsnprintf(buff2, LOGBUFF2SIZE, buff1, arglist);
-        va_end(arglist);
+        if (logFileOpen && writeToFile)
+            updateLogIndex();
 
-        bool header = printHeader(level, writeToFile);
         printf("%s", buff2);
-        if (header)
-            printf("\n");
 
         if (logFileOpen) {
             if (writeToFile) {
-                int result = fs_write(&logFile, buff2, strlen(buff2));
+                int result = writeLogFile(buff2, length);
                 if (result < 0) {
                     printf("Failed to write to log file: %d", result);
                 }
 
-                if (header) {
-                    result = fs_write(&logFile, "\n", 1);
-                    if (result < 0) {
-                        printf("Failed to write to log file: %d", result);
-                    }
-                }
-
                 if (flushLogFileCache) {
                     flushLogFileCache = false;
                     printf("Flushing log file...");
@@ -226,6 +622,38 @@ void _writeLog(const char *log, logLevels_t level, bool writeToFile, ...)
     MUTEX_UNLOCK;
 }
 
+/// @brief Writes a log message to the terminal and the log file
+/// @param log The log, which can contain string formating
+/// @param module The logging module, used to look up the log level
+/// @param  ... The variables for the string format
+void _writeLog(const char *log, logLevels_t level, bool writeToFile, int32_t module, ...)
+{
+    if (!isLogLevelEnabled(level, module))
+        return;
+
+    va_list arglist;
+    va_start(arglist, module);
+    writeLogEntry(log, level, writeToFile, 0, arglist);
+    va_end(arglist);
+}
+
+void _writeLogLimited(logRateLimit_t *pRateLimit, const char *log, logLevels_t level,
+                      bool writeToFile, int32_t module, ...)
+{
+    // filtered log entries don't use up the rate limit
+    if (!isLogLevelEnabled(level, module))
+        return;
+
+    uint32_t suppressed = 0;
+    if (!takeRateLimitToken(pRateLimit, &suppressed))
+        return;
+
+    va_list arglist;
+    va_start(arglist, module);
+    writeLogEntry(log, level, writeToFile, suppressed, arglist);
+    va_end(arglist);
+}
+
 /// @brief Close the log file
 void closeLogFile(bool displayWarning)
 {
@@ -240,6 +668,11 @@ void closeLogFile(bool displayWarning)
         logFileOpen = false;
         fs_close(&logFile);
 
+        if (logIndexOpen) {
+            logIndexOpen = false;
+            fs_close(&logIndexFile);
+        }
+
         if (pFlushTimerHandle != NULL)
             uPortTimerStop(pFlushTimerHandle);
     
@@ -251,9 +684,6 @@ void closeLogFile(bool displayWarning)
 
 void displayLogFile(void)
 {
-    char buffer[FILE_READ_BUFFER];
-    int count;
-
     if (!logFileOpen) {
         printf("Opening log file failed, cannot display log.");
         return;
@@ -263,30 +693,147 @@ void displayLogFile(void)
                "*** LOG START ******************************************\n"
                "********************************************************\n");
 
-    while((count = fs_read(&logFile, buffer, FILE_READ_BUFFER)) > 0)
-        printf("%.*s", count, buffer);
+    printLogData(&logFile, SIZE_MAX);
 
     printf("\n********************************************************\n"
                "*** LOG END ********************************************\n"
                "********************************************************\n");
 }
 
+int32_t getLogFileRange(int64_t startTime, int64_t endTime, size_t *pStartOffset, size_t *pEndOffset)
+{
+    int32_t errorCode = U_ERROR_COMMON_SUCCESS;
+    size_t logSize, indexSize;
+
+    if (!extFsFileSize(logFilePath, &logSize))
+        return U_ERROR_COMMON_NOT_FOUND;
+
+    // Without an index the range is the whole log file
+    struct fs_file_t indexFile;
+    fs_file_t_init(&indexFile);
+    if (!extFsFileSize(logIndexPath, &indexSize) ||
+        fs_open(&indexFile, logIndexPath, FS_O_READ) != 0) {
+        indexSize = 0;
+    }
+
+    size_t entryCount = indexSize / sizeof(logIndexEntry_t);
+    logIndexEntry_t entry;
+
+    // The start is the bucket entry which is at, or just before, the start time
+    *pStartOffset = 0;
+    size_t startIndex = searchLogIndex(&indexFile, entryCount, (uint32_t)startTime);
+    if (startIndex > 0 && readLogIndexEntry(&indexFile, startIndex - 1, &entry))
+        *pStartOffset = entry.offset;
+
+    // The end is the first bucket entry after the end time
+    *pEndOffset = logSize;
+    size_t endIndex = searchLogIndex(&indexFile, entryCount, (uint32_t)endTime);
+    if (endIndex < entryCount && readLogIndexEntry(&indexFile, endIndex, &entry))
+        *pEndOffset = entry.offset;
+
+    if (*pEndOffset > logSize)
+        *pEndOffset = logSize;
+
+    if (*pStartOffset > *pEndOffset)
+        errorCode = U_ERROR_COMMON_NOT_FOUND;
+
+    fs_close(&indexFile);
+
+    return errorCode;
+}
+
+void flushLogFile(void)
+{
+    if (!logFileOpen)
+        return;
+
+    MUTEX_LOCK
+        fs_sync(&logFile);
+        if (logIndexOpen)
+            fs_sync(&logIndexFile);
+    MUTEX_UNLOCK
+}
+
+int32_t readLogFile(size_t offset, void *pBuffer, size_t size)
+{
+    struct fs_file_t readFile;
+    fs_file_t_init(&readFile);
+
+    int32_t result = fs_open(&readFile, logFilePath, FS_O_READ);
+    if (result != 0)
+        return U_ERROR_COMMON_NOT_FOUND;
+
+    result = fs_seek(&readFile, offset, FS_SEEK_SET);
+    if (result == 0)
+        result = fs_read(&readFile, pBuffer, size);
+
+    fs_close(&readFile);
+
+    return result;
+}
+
+void displayLogFileRange(int64_t startTime, int64_t endTime)
+{
+    size_t startOffset, endOffset;
+
+    if (!logFileOpen) {
+        printf("Log file is not open, cannot display log.");
+        return;
+    }
+
+    flushLogFile();
+
+    if (getLogFileRange(startTime, endTime, &startOffset, &endOffset) < 0) {
+        printWarn("No log entries found between %lld and %lld", startTime, endTime);
+        return;
+    }
+
+    struct fs_file_t readFile;
+    fs_file_t_init(&readFile);
+    if (fs_open(&readFile, logFilePath, FS_O_READ) != 0 ||
+        fs_seek(&readFile, startOffset, FS_SEEK_SET) != 0) {
+        printWarn("Failed to open log file for reading");
+        fs_close(&readFile);
+        return;
+    }
+
+    printf("\n********************************************************\n"
+               "*** LOG RANGE START ************************************\n"
+               "********************************************************\n");
+
+    printLogData(&readFile, endOffset - startOffset);
+
+    printf("\n********************************************************\n"
+               "*** LOG RANGE END **************************************\n"
+               "********************************************************\n");
+
+    fs_close(&readFile);
+}
+
 void displayFileSpace(const char *pFilename)
 {
     uint32_t freeSpace = extFsFree() * 1024;
     printLog("File system free space: %u bytes", freeSpace);
 
     size_t fileSize;
-    const char *path = extFsPath(pFilename);
-    if (extFsFileSize(path, &fileSize)) {
+    char path[EXT_FS_MAX_PATH_SIZE];
+    if (extFsFileSize(extFsMakePath(path, sizeof(path), pFilename), &fileSize)) {
         printLog("Log file size: %u bytes", fileSize);
     }
 }
 
+void deleteLogFile(const char *pFilename)
+{
+    deleteFile(pFilename);
+
+    setLogIndexFilename(pFilename);
+    deleteFile(logIndexFilename);
+}
+
 void deleteFile(const char *pFilename)
 {
-    const char *path = extFsPath(pFilename);
-    if (fs_unlink(path) == 0)
+    char path[EXT_FS_MAX_PATH_SIZE];
+    if (fs_unlink(extFsMakePath(path, sizeof(path), pFilename)) == 0)
         printLog("Deleted file: %s", pFilename);
     else
         printLog("Failed to delete file: %s", pFilename);
@@ -26,27 +26,53 @@
 /* ----------------------------------------------------------------
  * DEFINITIONS
  * -------------------------------------------------------------- */
-#define printLog(log, ...) _writeLog(log, eINFO, false, ##__VA_ARGS__)
-#define writeLog(log, ...) _writeLog(log, eINFO, true, ##__VA_ARGS__)
-
-#define printLog2(log, level, ...) _writeLog(log, level, false, ##__VA_ARGS__)
-#define writeLog2(log, level, ...) _writeLog(log, level, true, ##__VA_ARGS__)
-
-#define printTrace(log, ...) _writeLog(log, eTRACE, false, ##__VA_ARGS__)
-#define printDebug(log, ...) _writeLog(log, eDEBUG, false, ##__VA_ARGS__)
-#define printInfo(log, ...) _writeLog(log, eINFO, false,  ##__VA_ARGS__)
-#define printWarn(log, ...) _writeLog(log, eWARN, false, ##__VA_ARGS__)
-#define printError(log, ...) _writeLog(log, eERROR, false, ##__VA_ARGS__)
-#define printFatal(log, ...) _writeLog(log, eFATAL, false, ##__VA_ARGS__)
-#define printAlways(log, ...) _writeLog(log, eNOFILTER, false, ##__VA_ARGS__)
-
-#define writeTrace(log, ...) _writeLog(log, eTRACE, true, ##__VA_ARGS__)
-#define writeDebug(log, ...) _writeLog(log, eDEBUG, true, ##__VA_ARGS__)
-#define writeInfo(log, ...) _writeLog(log, eINFO, true,  ##__VA_ARGS__)
-#define writeWarn(log, ...) _writeLog(log, eWARN, true, ##__VA_ARGS__)
-#define writeError(log, ...) _writeLog(log, eERROR, true, ##__VA_ARGS__)
-#define writeFatal(log, ...) _writeLog(log, eFATAL, true, ##__VA_ARGS__)
-#define writeAlways(log, ...) _writeLog(log, eNOFILTER, true, ##__VA_ARGS__)
+/// Logging module of the source file, which is used to look up its log level.
+/// Define LOG_MODULE as the task ID before including common.h to give the
+/// task its own log level, otherwise the application's module is used.
+#define LOG_MAX_MODULES 16
+#define LOG_MODULE_APP (LOG_MAX_MODULES - 1)
+
+#ifndef LOG_MODULE
+#define LOG_MODULE LOG_MODULE_APP
+#endif
+
+#define printLog(log, ...) _writeLog(log, eINFO, false, LOG_MODULE, ##__VA_ARGS__)
+#define writeLog(log, ...) _writeLog(log, eINFO, true, LOG_MODULE, ##__VA_ARGS__)
+
+#define printLog2(log, level, ...) _writeLog(log, level, false, LOG_MODULE, ##__VA_ARGS__)
+#define writeLog2(log, level, ...) _writeLog(log, level, true, LOG_MODULE, ##__VA_ARGS__)
+
+#define printTrace(log, ...) _writeLog(log, eTRACE, false, LOG_MODULE, ##__VA_ARGS__)
+#define printDebug(log, ...) _writeLog(log, eDEBUG, false, LOG_MODULE, ##__VA_ARGS__)
+#define printInfo(log, ...) _writeLog(log, eINFO, false, LOG_MODULE,  ##__VA_ARGS__)
+#define printWarn(log, ...) _writeLog(log, eWARN, false, LOG_MODULE, ##__VA_ARGS__)
+#define printError(log, ...) _writeLog(log, eERROR, false, LOG_MODULE, ##__VA_ARGS__)
+#define printFatal(log, ...) _writeLog(log, eFATAL, false, LOG_MODULE, ##__VA_ARGS__)
+#define printAlways(log, ...) _writeLog(log, eNOFILTER, false, LOG_MODULE, ##__VA_ARGS__)
+
+#define writeTrace(log, ...) _writeLog(log, eTRACE, true, LOG_MODULE, ##__VA_ARGS__)
+#define writeDebug(log, ...) _writeLog(log, eDEBUG, true, LOG_MODULE, ##__VA_ARGS__)
+#define writeInfo(log, ...) _writeLog(log, eINFO, true, LOG_MODULE,  ##__VA_ARGS__)
+#define writeWarn(log, ...) _writeLog(log, eWARN, true, LOG_MODULE, ##__VA_ARGS__)
+#define writeError(log, ...) _writeLog(log, eERROR, true, LOG_MODULE, ##__VA_ARGS__)
+#define writeFatal(log, ...) _writeLog(log, eFATAL, true, LOG_MODULE, ##__VA_ARGS__)
+#define writeAlways(log, ...) _writeLog(log, eNOFILTER, true, LOG_MODULE, ##__VA_ARGS__)
+
+/// Rate limited logging for messages which can repeat quickly, such as when
+/// the network is not available. Each place these are used can log a burst
+/// of LOG_RATE_LIMIT_BURST messages and then one every LOG_RATE_LIMIT_INTERVAL_MS.
+/// The number of messages dropped is added to the next one which is logged.
+#define LOG_RATE_LIMIT_BURST 3
+#define LOG_RATE_LIMIT_INTERVAL_MS (60 * 1000)
+
+#define _writeLogRateLimited(log, level, writeToFile, ...) do {                             \
+        static logRateLimit_t rateLimit;                                                    \
+        _writeLogLimited(&rateLimit, log, level, writeToFile, LOG_MODULE, ##__VA_ARGS__);   \
+    } while (0)
+
+#define printWarnLimited(log, ...) _writeLogRateLimited(log, eWARN, false, ##__VA_ARGS__)
+#define writeWarnLimited(log, ...) _writeLogRateLimited(log, eWARN, true, ##__VA_ARGS__)
+#define writeErrorLimited(log, ...) _writeLogRateLimited(log, eERROR, true, ##__VA_ARGS__)
 
 /* ----------------------------------------------------------------
  * PUBLIC TYPE DEFINITIONS
@@ -64,6 +90,14 @@ typedef enum {
     eNOFILTER
 } logLevels_t;
 
+/// @brief The token bucket of a rate limited log message
+typedef struct {
+    bool started;
+    uint16_t tokens;
+    uint32_t suppressed;
+    int64_t refillTimeMs;
+} logRateLimit_t;
+
 /* ----------------------------------------------------------------
  * PUBLIC FUNCTIONS
  * -------------------------------------------------------------- */
@@ -71,19 +105,66 @@ typedef enum {
 /// @param pFilename The filename to log to
 void startLogging(const char *pFilename);
 
-/// @brief set the logging level of printLog and writeLog
+/// @brief set the default logging level of printLog and writeLog, which is
+///        used for all the modules without their own log level
 void setLogLevel(logLevels_t level);
 
+/// @brief set the logging level of a single module, overriding the default
+/// @param module The logging module, which is the task ID or LOG_MODULE_APP
+/// @param level The log level, or eMAXLOGLEVELS to use the default level again
+/// @return 0 on success, negative if the module is invalid
+int32_t setModuleLogLevel(int32_t module, logLevels_t level);
+
 /// @brief Write a log entry to the log file and terminal
 /// @param log The log format to write
 /// @param level The level of terminal logging
 /// @param writeToFile Set to false to not write to the file
+/// @param module The logging module the entry is from
+/// @param ... The arguments to use in the log entry
+void _writeLog(const char *log, logLevels_t level, bool writeToFile, int32_t module, ...);
+
+/// @brief Write a log entry if the rate limit allows it, otherwise count it
+///        as suppressed
+/// @param pRateLimit The rate limit of the place the log entry is from
+/// @param log The log format to write
+/// @param level The level of terminal logging
+/// @param writeToFile Set to false to not write to the file
+/// @param module The logging module the entry is from
 /// @param ... The arguments to use in the log entry
-void _writeLog(const char *log, logLevels_t level, bool writeToFile, ...);
+void _writeLogLimited(logRateLimit_t *pRateLimit, const char *log, logLevels_t level,
+                      bool writeToFile, int32_t module, ...);
 
 /// @brief Display the entire log file to the terminal
 void displayLogFile(void);
 
+/// @brief Display the log file entries between two times to the terminal.
+///        Uses the log index so only the requested part of the file is read.
+/// @param startTime The unix time (seconds) of the first entries to display
+/// @param endTime The unix time (seconds) of the last entries to display
+void displayLogFileRange(int64_t startTime, int64_t endTime);
+
+/// @brief Gets the log file offsets which cover a time range, from the log index
+/// @param startTime The unix time (seconds) of the start of the range
+/// @param endTime The unix time (seconds) of the end of the range
+/// @param pStartOffset The offset of the start of the range in the log file
+/// @param pEndOffset The offset of the end of the range in the log file
+/// @return 0 on success, negative on failure
+int32_t getLogFileRange(int64_t startTime, int64_t endTime, size_t *pStartOffset, size_t *pEndOffset);
+
+/// @brief Flushes the log file and its index to the file system
+void flushLogFile(void);
+
+/// @brief Reads a block of the log file
+/// @param offset The offset in the log file to read from
+/// @param pBuffer The buffer to read into
+/// @param size The number of bytes to read
+/// @return The number of bytes read, or negative on failure
+int32_t readLogFile(size_t offset, void *pBuffer, size_t size);
+
+/// @brief Delete the log file and its time index file
+/// @param pFilename The log file to delete
+void deleteLogFile(const char *pFilename);
+
 /// @brief Delete the specified file
 /// @param pFilename The file to delete
 void deleteFile(const char *pFilename);
@@ -0,0 +1,253 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *
+ * Periodic job scheduler. The task loops and the application loop plan
+ * their next run here, and a run which is due within the window of
+ * another job's planned run is moved to it. The jobs then run one after
+ * the other, and the modem has longer idle gaps between them.
+ *
+ * The scheduler only uses the platform through its port, so that it can
+ * be built and tested on the host.
+ *
+ */
+
+#include <stddef.h>
+
+#include "u_error_common.h"
+
+#include "scheduler.h"
+
+/* ----------------------------------------------------------------
+ * DEFINES
+ * -------------------------------------------------------------- */
+#define NO_RUNNING_JOB -1
+
+#define LATEST(a, b) ((a) > (b) ? (a) : (b))
+
+/* ----------------------------------------------------------------
+ * TYPE DEFINITIONS
+ * -------------------------------------------------------------- */
+typedef struct {
+    const char *pName;
+    int32_t periodMs;
+    int32_t windowMs;
+
+    /// @brief The planned run, or zero if there isn't one
+    int64_t nextRunMs;
+} scheduledJob_t;
+
+/* ----------------------------------------------------------------
+ * STATIC VARIABLES
+ * -------------------------------------------------------------- */
+static const schedulerPort_t *port = NULL;
+
+static scheduledJob_t jobs[SCHEDULER_MAX_JOBS];
+static size_t jobCount = 0;
+
+/// @brief The job which is running, so the jobs due at the same time run in turn
+static int32_t runningJob = NO_RUNNING_JOB;
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+static scheduledJob_t *getJob(int32_t jobHandle)
+{
+    if (jobHandle < 0 || (size_t)jobHandle >= jobCount)
+        return NULL;
+
+    return &jobs[jobHandle];
+}
+
+/// @brief Finds the latest run of the other jobs between the two times,
+///        from their planned runs and the periods after them. Must be
+///        called with the scheduler locked.
+static int64_t findSharedRun(scheduledJob_t *pJob, int64_t fromMs, int64_t toMs)
+{
+    int64_t sharedMs = 0;
+
+    for(size_t i=0; i<jobCount; i++) {
+        int64_t runMs = jobs[i].nextRunMs;
+        if (&jobs[i] == pJob || runMs == 0 || runMs > toMs)
+            continue;
+
+        // the last run of this job which isn't after the window
+        runMs += ((toMs - runMs) / jobs[i].periodMs) * jobs[i].periodMs;
+        if (runMs >= fromMs && runMs > sharedMs)
+            sharedMs = runMs;
+    }
+
+    return sharedMs;
+}
+
+/// @brief Ends the run of a job, if it is the job which is running. Must be
+///        called with the scheduler locked.
+static void releaseRun(int32_t jobHandle)
+{
+    if (runningJob == jobHandle) {
+        runningJob = NO_RUNNING_JOB;
+        port->signal();
+    }
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+void setSchedulerPort(const schedulerPort_t *pPort)
+{
+    port = pPort;
+    jobCount = 0;
+    runningJob = NO_RUNNING_JOB;
+}
+
+int64_t getSchedulerTimeMs(void)
+{
+    return port != NULL ? port->getTimeMs() : 0;
+}
+
+int32_t addScheduledJob(const char *pName, int32_t periodMs, int32_t windowMs)
+{
+    if (port == NULL)
+        return U_ERROR_COMMON_NOT_INITIALISED;
+
+    if (periodMs <= 0 || windowMs < 0)
+        return U_ERROR_COMMON_INVALID_PARAMETER;
+
+    int32_t jobHandle = U_ERROR_COMMON_NO_MEMORY;
+
+    port->lock();
+    if (jobCount < SCHEDULER_MAX_JOBS) {
+        jobHandle = (int32_t)jobCount;
+        jobs[jobCount++] = (scheduledJob_t){pName, periodMs, windowMs, 0};
+    }
+    port->unlock();
+
+    return jobHandle;
+}
+
+int32_t setScheduledJobPeriod(int32_t jobHandle, int32_t periodMs, int32_t windowMs)
+{
+    if (port == NULL)
+        return U_ERROR_COMMON_NOT_INITIALISED;
+
+    if (periodMs <= 0 || windowMs < 0)
+        return U_ERROR_COMMON_INVALID_PARAMETER;
+
+    int32_t errorCode = U_ERROR_COMMON_NOT_FOUND;
+
+    port->lock();
+    scheduledJob_t *pJob = getJob(jobHandle);
+    if (pJob != NULL) {
+        if (pJob->periodMs != periodMs)
+            pJob->nextRunMs = 0;
+
+        pJob->periodMs = periodMs;
+        pJob->windowMs = windowMs;
+        errorCode = U_ERROR_COMMON_SUCCESS;
+    }
+    port->unlock();
+
+    return errorCode;
+}
+
+int64_t getNextScheduledRun(int32_t jobHandle)
+{
+    if (port == NULL)
+        return U_ERROR_COMMON_NOT_INITIALISED;
+
+    int64_t nowMs = port->getTimeMs();
+    int64_t nextRunMs = U_ERROR_COMMON_NOT_FOUND;
+
+    port->lock();
+    scheduledJob_t *pJob = getJob(jobHandle);
+    if (pJob != NULL) {
+        if (pJob->nextRunMs > nowMs) {
+            // woken up before the planned run
+            nextRunMs = pJob->nextRunMs;
+        } else {
+            // keep to the period, unless the run is already too late for it
+            nextRunMs = pJob->nextRunMs + pJob->periodMs;
+            if (pJob->nextRunMs == 0 || nextRunMs - pJob->windowMs <= nowMs)
+                nextRunMs = nowMs + pJob->periodMs;
+
+            int64_t earliestMs = nextRunMs - pJob->windowMs;
+            int64_t sharedMs = findSharedRun(pJob, LATEST(earliestMs, nowMs + 1), nextRunMs);
+            if (sharedMs != 0)
+                nextRunMs = sharedMs;
+
+            pJob->nextRunMs = nextRunMs;
+        }
+    }
+    port->unlock();
+
+    return nextRunMs;
+}
+
+int32_t beginScheduledRun(int32_t jobHandle, int32_t timeoutMs)
+{
+    if (port == NULL)
+        return U_ERROR_COMMON_NOT_INITIALISED;
+
+    int32_t errorCode = U_ERROR_COMMON_SUCCESS;
+    int64_t endTimeMs = port->getTimeMs() + timeoutMs;
+
+    port->lock();
+    if (getJob(jobHandle) == NULL) {
+        errorCode = U_ERROR_COMMON_NOT_FOUND;
+    } else {
+        while(runningJob != NO_RUNNING_JOB && runningJob != jobHandle) {
+            int64_t remainingMs = endTimeMs - port->getTimeMs();
+            if (remainingMs <= 0) {
+                errorCode = U_ERROR_COMMON_TIMEOUT;
+                break;
+            }
+
+            port->wait((int32_t)remainingMs);
+        }
+
+        if (errorCode == U_ERROR_COMMON_SUCCESS)
+            runningJob = jobHandle;
+    }
+    port->unlock();
+
+    return errorCode;
+}
+
+void endScheduledRun(int32_t jobHandle)
+{
+    if (port == NULL)
+        return;
+
+    port->lock();
+    releaseRun(jobHandle);
+    port->unlock();
+}
+
+void cancelScheduledRun(int32_t jobHandle)
+{
+    if (port == NULL)
+        return;
+
+    port->lock();
+    scheduledJob_t *pJob = getJob(jobHandle);
+    if (pJob != NULL)
+        pJob->nextRunMs = 0;
+
+    releaseRun(jobHandle);
+    port->unlock();
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *
+ * Periodic job scheduler header
+ *
+ */
+
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ----------------------------------------------------------------
+ * DEFINITIONS
+ * -------------------------------------------------------------- */
+/// The number of periodic jobs which can be scheduled, one for each task
+/// loop and one for the application loop
+#define SCHEDULER_MAX_JOBS              12
+
+/// The default window a job can be run early in, to share a wake up with
+/// another job, as a percentage of its period
+#define SCHEDULER_WINDOW_PERCENT        20
+
+#define SCHEDULER_DEFAULT_WINDOW_MS(periodMs) \
+                                        ((int32_t)(((int64_t)(periodMs) * SCHEDULER_WINDOW_PERCENT) / 100))
+
+/// How long a job waits for the job which is running to finish, before
+/// it runs anyway
+#define SCHEDULER_RUN_TIMEOUT_MS        10000
+
+/* ----------------------------------------------------------------
+ * PUBLIC TYPE DEFINITIONS
+ * -------------------------------------------------------------- */
+/// @brief The platform functions the scheduler uses, so that it can be
+///        run on the host with a virtual clock
+typedef struct {
+    /// @brief The clock of the scheduler, in milliseconds
+    int64_t (*getTimeMs)(void);
+
+    /// @brief Locks and unlocks the scheduler's state
+    void (*lock)(void);
+    void (*unlock)(void);
+
+    /// @brief Waits for signal(), or the timeout, with the lock held. The
+    ///        lock is released while waiting.
+    void (*wait)(int32_t timeoutMs);
+
+    /// @brief Wakes up everything in wait()
+    void (*signal)(void);
+} schedulerPort_t;
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+/// @brief Sets the platform functions the scheduler uses, which must be
+///        set before any jobs are added. The jobs are removed.
+/// @param pPort The platform functions, which must stay in scope
+void setSchedulerPort(const schedulerPort_t *pPort);
+
+/// @brief Gets the time of the scheduler's clock
+/// @return The time in milliseconds
+int64_t getSchedulerTimeMs(void);
+
+/// @brief Adds a periodic job to the scheduler
+/// @param pName The name of the job, for logging
+/// @param periodMs The period of the job
+/// @param windowMs How much earlier than its period the job can be run, so
+///                 that it shares a wake up with another job
+/// @return The job handle, or negative on failure
+int32_t addScheduledJob(const char *pName, int32_t periodMs, int32_t windowMs);
+
+/// @brief Changes the period and window of a job. A changed period starts
+///        again from the next call to getNextScheduledRun().
+/// @param jobHandle The handle of the job
+/// @param periodMs The period of the job
+/// @param windowMs How much earlier than its period the job can be run
+/// @return 0 on success, negative on failure
+int32_t setScheduledJobPeriod(int32_t jobHandle, int32_t periodMs, int32_t windowMs);
+
+/// @brief Gets the time the job is to run next, which is aligned with the
+///        next run of another job if one is due within the job's window.
+///        The job calls this when it has run, and waits until this time.
+///        A job which hasn't reached its planned run yet keeps it.
+/// @param jobHandle The handle of the job
+/// @return The time of the next run on the scheduler's clock, or negative
+///         on failure
+int64_t getNextScheduledRun(int32_t jobHandle);
+
+/// @brief Starts the run of a job, when its planned run is due. Jobs which
+///        are due at the same time are run one after the other, so this
+///        waits for the job which is running to end its run.
+/// @param jobHandle The handle of the job
+/// @param timeoutMs How long to wait for the job which is running
+/// @return 0 when the job can run, U_ERROR_COMMON_TIMEOUT if another job is
+///         still running, or negative on another failure
+int32_t beginScheduledRun(int32_t jobHandle, int32_t timeoutMs);
+
+/// @brief Ends the run of a job, so the next job which is due can run
+/// @param jobHandle The handle of the job
+void endScheduledRun(int32_t jobHandle);
+
+/// @brief Cancels the next run of a job, such as when its task has
+///        stopped, so other jobs aren't aligned with it, and ends its run
+/// @param jobHandle The handle of the job
+void cancelScheduledRun(int32_t jobHandle);
+
+#endif
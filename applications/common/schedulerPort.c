@@ -0,0 +1,65 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ *
+ * The scheduler's platform functions on the Zephyr kernel, with the
+ * monotonic application clock
+ *
+ */
+
+#include "common.h"
+#include "schedulerPort.h"
+
+/* ----------------------------------------------------------------
+ * STATIC VARIABLES
+ * -------------------------------------------------------------- */
+K_MUTEX_DEFINE(schedulerMutex);
+K_CONDVAR_DEFINE(schedulerRunEnded);
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+static void lockScheduler(void)
+{
+    k_mutex_lock(&schedulerMutex, K_FOREVER);
+}
+
+static void unlockScheduler(void)
+{
+    k_mutex_unlock(&schedulerMutex);
+}
+
+static void waitForScheduler(int32_t timeoutMs)
+{
+    k_condvar_wait(&schedulerRunEnded, &schedulerMutex, K_MSEC(timeoutMs));
+}
+
+static void signalScheduler(void)
+{
+    k_condvar_broadcast(&schedulerRunEnded);
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC VARIABLES
+ * -------------------------------------------------------------- */
+const schedulerPort_t schedulerKernelPort = {
+    .getTimeMs = getMonotonicTimeMs,
+    .lock = lockScheduler,
+    .unlock = unlockScheduler,
+    .wait = waitForScheduler,
+    .signal = signalScheduler
+};
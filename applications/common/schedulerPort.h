@@ -0,0 +1,34 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ *
+ * Scheduler port header
+ *
+ */
+
+#ifndef _SCHEDULER_PORT_H_
+#define _SCHEDULER_PORT_H_
+
+#include "scheduler.h"
+
+/* ----------------------------------------------------------------
+ * PUBLIC VARIABLES
+ * -------------------------------------------------------------- */
+/// @brief The scheduler's platform functions on the Zephyr kernel
+extern const schedulerPort_t schedulerKernelPort;
+
+#endif
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *
+ * Time service. The wall clock time is an offset from the 64 bit
+ * monotonic uptime, which is anchored each time a time source gives
+ * the current time.
+ *
+ */
+
+#include <time.h>
+
+#include "common.h"
+
+/* ----------------------------------------------------------------
+ * DEFINITIONS
+ * -------------------------------------------------------------- */
+// length of the "YYYY-MM-DDTHH:MM:SS" part of the timestamp
+#define TIMESTAMP_DATE_TIME_LENGTH 19
+
+// a less accurate time source can re-anchor the time after this long
+#define TIME_ANCHOR_MAX_AGE_MS (24LL * 60 * 60 * 1000)
+
+/* ----------------------------------------------------------------
+ * STATIC VARIABLES
+ * -------------------------------------------------------------- */
+// the wall clock time is the monotonic time plus this offset
+static struct k_spinlock timeLock;
+static int64_t unixOffsetMs = 0;
+static int64_t anchorTimeMs = 0;
+static timeSource_t timeSource = TIME_SOURCE_NONE;
+
+// the last formatted timestamp second, shared by all the tasks
+static struct k_spinlock timeStampLock;
+static int64_t timeStampSecond = -1;
+static char timeStampText[TIMESTAMP_DATE_TIME_LENGTH];
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+int64_t getMonotonicTimeMs(void)
+{
+    return k_uptime_get();
+}
+
+int64_t getUnixTimeMs(void)
+{
+    int64_t now = getMonotonicTimeMs();
+
+    k_spinlock_key_t key = k_spin_lock(&timeLock);
+    bool valid = timeSource != TIME_SOURCE_NONE;
+    int64_t offset = unixOffsetMs;
+    k_spin_unlock(&timeLock, key);
+
+    return valid ? now + offset : 0;
+}
+
+bool isTimeValid(void)
+{
+    return getTimeSource() != TIME_SOURCE_NONE;
+}
+
+timeSource_t getTimeSource(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&timeLock);
+    timeSource_t source = timeSource;
+    k_spin_unlock(&timeLock, key);
+
+    return source;
+}
+
+bool setUnixTime(int64_t unixTimeMs, timeSource_t source)
+{
+    if (unixTimeMs <= 0 || source == TIME_SOURCE_NONE)
+        return false;
+
+    int64_t now = getMonotonicTimeMs();
+    int64_t offset = unixTimeMs - now;
+    int64_t correctionMs = 0;
+    bool anchored = false;
+
+    k_spinlock_key_t key = k_spin_lock(&timeLock);
+    if (source >= timeSource || now - anchorTimeMs > TIME_ANCHOR_MAX_AGE_MS) {
+        if (timeSource != TIME_SOURCE_NONE)
+            correctionMs = offset - unixOffsetMs;
+
+        unixOffsetMs = offset;
+        anchorTimeMs = now;
+        timeSource = source;
+        anchored = true;
+    }
+    k_spin_unlock(&timeLock, key);
+
+    if (anchored && correctionMs != 0)
+        printDebug("Time re-anchored from source %d, corrected by %lld ms", source, (long long)correctionMs);
+
+    if (anchored)
+        publishEvent(EVENT_TIME_VALID);
+
+    return anchored;
+}
+
+void getTimeStamp(char *timeStamp)
+{
+    int64_t unixTimeMs = getUnixTimeMs();
+    if (unixTimeMs == 0) {
+        snprintf(timeStamp, TIMESTAMP_MAX_LENTH_BYTES, "%lld", (long long)getMonotonicTimeMs());
+        return;
+    }
+
+    int64_t second = unixTimeMs / 1000;
+    int32_t milliseconds = unixTimeMs % 1000;
+
+    // the "YYYY-MM-DDTHH:MM:SS" part only changes once a second, so it is cached
+    k_spinlock_key_t key = k_spin_lock(&timeStampLock);
+    bool cached = (second == timeStampSecond);
+    if (cached)
+        memcpy(timeStamp, timeStampText, TIMESTAMP_DATE_TIME_LENGTH);
+    k_spin_unlock(&timeStampLock, key);
+
+    if (!cached) {
+        struct tm time;
+        time_t tmTime = (time_t)second;
+        gmtime_r(&tmTime, &time);
+        snprintf(timeStamp, TIMESTAMP_MAX_LENTH_BYTES, "%04u-%02u-%02uT%02u:%02u:%02u",
+                                    (unsigned)(time.tm_year + 1900) % 10000,
+                                    (unsigned)(time.tm_mon + 1) % 100,
+                                    (unsigned)time.tm_mday % 100,
+                                    (unsigned)time.tm_hour % 100,
+                                    (unsigned)time.tm_min % 100,
+                                    (unsigned)time.tm_sec % 100);
+
+        key = k_spin_lock(&timeStampLock);
+        memcpy(timeStampText, timeStamp, TIMESTAMP_DATE_TIME_LENGTH);
+        timeStampSecond = second;
+        k_spin_unlock(&timeStampLock, key);
+    }
+
+    char *ms = timeStamp + TIMESTAMP_DATE_TIME_LENGTH;
+    ms[0] = '.';
+    ms[1] = '0' + (milliseconds / 100);
+    ms[2] = '0' + (milliseconds / 10) % 10;
+    ms[3] = '0' + milliseconds % 10;
+    ms[4] = 'Z';
+    ms[5] = 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *
+ * Time service header
+ *
+ */
+
+#ifndef _TIME_SERVICE_H_
+#define _TIME_SERVICE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ----------------------------------------------------------------
+ * DEFINITIONS
+ * -------------------------------------------------------------- */
+/// The size of a timestamp, "YYYY-MM-DDTHH:MM:SS.mmmZ" and the null terminator
+#define TIMESTAMP_MAX_LENTH_BYTES   25
+
+/* ----------------------------------------------------------------
+ * PUBLIC TYPE DEFINITIONS
+ * -------------------------------------------------------------- */
+/// @brief Where the wall clock time came from, in order of accuracy
+typedef enum {
+    TIME_SOURCE_NONE,           // the wall clock time is not known yet
+    TIME_SOURCE_CELLULAR,       // the cellular network time, to the second
+    TIME_SOURCE_NTP             // an NTP server
+} timeSource_t;
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+/// @brief Gets the monotonic time since boot, which does not wrap
+/// @return The time since boot in milliseconds
+int64_t getMonotonicTimeMs(void);
+
+/// @brief Gets the wall clock time, if it is known
+/// @return The unix time in milliseconds, or zero if the time is not valid
+int64_t getUnixTimeMs(void);
+
+/// @brief Checks if the wall clock time is known
+/// @return true if the wall clock time is valid
+bool isTimeValid(void);
+
+/// @brief Gets the source of the wall clock time
+/// @return The time source, TIME_SOURCE_NONE if the time is not valid
+timeSource_t getTimeSource(void);
+
+/// @brief Sets the wall clock time from a time source. The time is used if
+///        the source is at least as accurate as the current source, or the
+///        current time was set too long ago.
+/// @param unixTimeMs The unix time in milliseconds
+/// @param source Where the time came from
+/// @return true if the wall clock time was set from this time
+bool setUnixTime(int64_t unixTimeMs, timeSource_t source);
+
+/// @brief Writes the timestamp, as "YYYY-MM-DDTHH:MM:SS.mmmZ" UTC if the wall
+///        clock time is valid, or the milliseconds since boot if not
+/// @param timeStamp The string to write the timestamp to. Must be minimum size
+///        of TIMESTAMP_MAX_LENTH_BYTES
+void getTimeStamp(char *timeStamp);
+
+#endif
@@ -0,0 +1,276 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *
+ * Worker pool. A fixed set of worker threads runs the one-shot jobs of
+ * the tasks from a priority job queue, instead of each job creating and
+ * deleting its own thread.
+ *
+ */
+
+#include "common.h"
+#include "workerPool.h"
+
+/* ----------------------------------------------------------------
+ * TYPE DEFINITIONS
+ * -------------------------------------------------------------- */
+typedef struct {
+    const char *pName;
+    workerJob_t job;
+    void *pParams;
+    workerPriority_t priority;
+    uint32_t sequence;
+    int64_t submitTimeMs;
+} workerJobEntry_t;
+
+/* ----------------------------------------------------------------
+ * STATIC VARIABLES
+ * -------------------------------------------------------------- */
+static uPortMutexHandle_t poolMutex = NULL;
+static uPortSemaphoreHandle_t jobSemaphore = NULL;
+static uPortSemaphoreHandle_t workerStoppedSemaphore = NULL;
+
+static workerJobEntry_t jobQueue[WORKER_POOL_QUEUE_SIZE];
+static size_t jobCount = 0;
+static uint32_t jobSequence = 0;
+
+static bool poolExiting = false;
+static int32_t workersRunning = 0;
+
+// the time each worker started its current job, or zero if it is idle
+static int64_t jobStartTimeMs[WORKER_POOL_SIZE];
+
+static workerPoolMetrics_t metrics;
+static int64_t busyTimeMs = 0;
+static int64_t poolStartTimeMs = 0;
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+/// @brief Takes the highest priority job, which was submitted first, off
+///        the job queue. Must be called with the pool mutex locked.
+static bool takeNextJob(workerJobEntry_t *pJob)
+{
+    if (jobCount == 0)
+        return false;
+
+    size_t next = 0;
+    for(size_t i=1; i<jobCount; i++) {
+        if (jobQueue[i].priority > jobQueue[next].priority ||
+            (jobQueue[i].priority == jobQueue[next].priority &&
+             (int32_t)(jobQueue[i].sequence - jobQueue[next].sequence) < 0))
+            next = i;
+    }
+
+    *pJob = jobQueue[next];
+    jobQueue[next] = jobQueue[--jobCount];
+
+    return true;
+}
+
+static void workerLoop(void *pParameters)
+{
+    int32_t worker = (int32_t)(intptr_t)pParameters;
+    workerJobEntry_t job;
+
+    while(!poolExiting) {
+        if (uPortSemaphoreTake(jobSemaphore) != 0)
+            continue;
+
+        uPortMutexLock(poolMutex);
+        bool haveJob = !poolExiting && takeNextJob(&job);
+        if (haveJob) {
+            int64_t now = getMonotonicTimeMs();
+            int64_t latencyMs = now - job.submitTimeMs;
+            jobStartTimeMs[worker] = now;
+            metrics.totalStartLatencyMs += latencyMs;
+            if (latencyMs > metrics.maxStartLatencyMs)
+                metrics.maxStartLatencyMs = latencyMs;
+            metrics.workersBusy++;
+        }
+        uPortMutexUnlock(poolMutex);
+
+        if (!haveJob)
+            continue;
+
+        printDebug("Worker #%d running %s job", worker, job.pName);
+        job.job(job.pParams);
+
+        uPortMutexLock(poolMutex);
+        busyTimeMs += getMonotonicTimeMs() - jobStartTimeMs[worker];
+        jobStartTimeMs[worker] = 0;
+        metrics.workersBusy--;
+        metrics.jobsRun++;
+        uPortMutexUnlock(poolMutex);
+    }
+
+    uPortMutexLock(poolMutex);
+    workersRunning--;
+    uPortMutexUnlock(poolMutex);
+
+    uPortSemaphoreGive(workerStoppedSemaphore);
+    uPortTaskDelete(NULL);
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+int32_t initWorkerPool(void)
+{
+    if (poolMutex != NULL)
+        return U_ERROR_COMMON_SUCCESS;
+
+    int32_t errorCode = uPortMutexCreate(&poolMutex);
+    if (errorCode != 0) {
+        writeFatal("Failed to create the worker pool mutex: %d", errorCode);
+        return errorCode;
+    }
+
+    // a give for each waiting job, and one for each worker when closing
+    errorCode = uPortSemaphoreCreate(&jobSemaphore, 0, WORKER_POOL_QUEUE_SIZE + WORKER_POOL_SIZE);
+    if (errorCode != 0) {
+        writeFatal("Failed to create the worker pool semaphore: %d", errorCode);
+        uPortMutexDelete(poolMutex);
+        poolMutex = NULL;
+        return errorCode;
+    }
+
+    errorCode = uPortSemaphoreCreate(&workerStoppedSemaphore, 0, WORKER_POOL_SIZE);
+    if (errorCode != 0) {
+        writeFatal("Failed to create the worker pool semaphore: %d", errorCode);
+        uPortSemaphoreDelete(jobSemaphore);
+        jobSemaphore = NULL;
+        uPortMutexDelete(poolMutex);
+        poolMutex = NULL;
+        return errorCode;
+    }
+
+    poolExiting = false;
+    poolStartTimeMs = getMonotonicTimeMs();
+
+    for(int32_t i=0; i<WORKER_POOL_SIZE; i++) {
+        uPortTaskHandle_t taskHandle;
+        errorCode = uPortTaskCreate(workerLoop, "Worker", WORKER_POOL_STACK_SIZE,
+                                    (void *)(intptr_t)i, WORKER_POOL_THREAD_PRIORITY, &taskHandle);
+        if (errorCode != 0) {
+            writeError("Failed to start worker #%d: %d", i, errorCode);
+            break;
+        }
+
+        uPortMutexLock(poolMutex);
+        workersRunning++;
+        uPortMutexUnlock(poolMutex);
+    }
+
+    if (workersRunning == 0)
+        return errorCode;
+
+    writeInfo("Started %d workers", workersRunning);
+
+    return U_ERROR_COMMON_SUCCESS;
+}
+
+int32_t submitWorkerJob(const char *pName, workerJob_t job, void *pParams, workerPriority_t priority)
+{
+    if (poolMutex == NULL || poolExiting)
+        return U_ERROR_COMMON_NOT_INITIALISED;
+
+    int32_t errorCode = U_ERROR_COMMON_SUCCESS;
+
+    uPortMutexLock(poolMutex);
+    if (jobCount < WORKER_POOL_QUEUE_SIZE) {
+        workerJobEntry_t *entry = &jobQueue[jobCount++];
+        entry->pName = pName;
+        entry->job = job;
+        entry->pParams = pParams;
+        entry->priority = priority;
+        entry->sequence = jobSequence++;
+        entry->submitTimeMs = getMonotonicTimeMs();
+
+        if (jobCount > metrics.maxJobsWaiting)
+            metrics.maxJobsWaiting = jobCount;
+    } else {
+        metrics.jobsRejected++;
+        errorCode = U_ERROR_COMMON_BUSY;
+    }
+    uPortMutexUnlock(poolMutex);
+
+    if (errorCode == U_ERROR_COMMON_SUCCESS)
+        uPortSemaphoreGive(jobSemaphore);
+    else
+        writeWarnLimited("Worker job queue is full, not running %s job", pName);
+
+    return errorCode;
+}
+
+void getWorkerPoolMetrics(workerPoolMetrics_t *pMetrics)
+{
+    memset(pMetrics, 0, sizeof(workerPoolMetrics_t));
+    if (poolMutex == NULL)
+        return;
+
+    uPortMutexLock(poolMutex);
+    int64_t now = getMonotonicTimeMs();
+    int64_t busyMs = busyTimeMs;
+    for(size_t i=0; i<WORKER_POOL_SIZE; i++) {
+        if (jobStartTimeMs[i] > 0)
+            busyMs += now - jobStartTimeMs[i];
+    }
+
+    *pMetrics = metrics;
+    pMetrics->jobsWaiting = jobCount;
+    uPortMutexUnlock(poolMutex);
+
+    int64_t workerTimeMs = (now - poolStartTimeMs) * WORKER_POOL_SIZE;
+    if (workerTimeMs > 0)
+        pMetrics->utilisationPercent = (int32_t)(busyMs * 100 / workerTimeMs);
+}
+
+int32_t closeWorkerPool(int32_t timeoutMs)
+{
+    if (poolMutex == NULL)
+        return U_ERROR_COMMON_SUCCESS;
+
+    uPortMutexLock(poolMutex);
+    poolExiting = true;
+    int32_t running = workersRunning;
+    uPortMutexUnlock(poolMutex);
+
+    for(size_t i=0; i<WORKER_POOL_SIZE; i++)
+        uPortSemaphoreGive(jobSemaphore);
+
+    int64_t endTimeMs = getMonotonicTimeMs() + timeoutMs;
+    for(; running > 0; running--) {
+        int64_t remainingMs = endTimeMs - getMonotonicTimeMs();
+        if (remainingMs <= 0 || uPortSemaphoreTryTake(workerStoppedSemaphore, (int32_t)remainingMs) != 0) {
+            // the workers still running use the pool, so it is left open
+            writeWarn("%d workers didn't finish their jobs in time", running);
+            return U_ERROR_COMMON_TIMEOUT;
+        }
+    }
+
+    uPortSemaphoreDelete(workerStoppedSemaphore);
+    workerStoppedSemaphore = NULL;
+    uPortSemaphoreDelete(jobSemaphore);
+    jobSemaphore = NULL;
+    uPortMutexDelete(poolMutex);
+    poolMutex = NULL;
+    jobCount = 0;
+
+    return U_ERROR_COMMON_SUCCESS;
+}
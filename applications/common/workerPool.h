@@ -0,0 +1,105 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *
+ * Worker pool header
+ *
+ */
+
+#ifndef _WORKER_POOL_H_
+#define _WORKER_POOL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ----------------------------------------------------------------
+ * DEFINITIONS
+ * -------------------------------------------------------------- */
+/// The number of worker threads which run the one-shot jobs, such as a
+/// cell scan or getting the location. Each worker has the stack size of
+/// the largest job.
+#ifndef WORKER_POOL_SIZE
+#define WORKER_POOL_SIZE            3
+#endif
+
+#ifndef WORKER_POOL_STACK_SIZE
+#define WORKER_POOL_STACK_SIZE      (3 * 1024)
+#endif
+
+#define WORKER_POOL_THREAD_PRIORITY 5
+
+/// The number of jobs which can be waiting for a worker
+#define WORKER_POOL_QUEUE_SIZE      8
+
+/* ----------------------------------------------------------------
+ * PUBLIC TYPE DEFINITIONS
+ * -------------------------------------------------------------- */
+/// @brief The priority of a job. Waiting jobs are run highest priority
+///        first, and in the order they were submitted for the same priority
+typedef enum {
+    WORKER_PRIORITY_LOW,
+    WORKER_PRIORITY_NORMAL,
+    WORKER_PRIORITY_HIGH
+} workerPriority_t;
+
+typedef void (*workerJob_t)(void *pParams);
+
+/// @brief The worker pool metrics, since the pool was started
+typedef struct {
+    uint32_t jobsRun;
+    uint32_t jobsRejected;
+    uint32_t jobsWaiting;
+    uint32_t maxJobsWaiting;
+    uint32_t workersBusy;
+
+    /// @brief Time between a job being submitted and a worker starting it
+    int64_t totalStartLatencyMs;
+    int64_t maxStartLatencyMs;
+
+    /// @brief Percentage of the worker time spent running jobs
+    int32_t utilisationPercent;
+} workerPoolMetrics_t;
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+/// @brief Creates the worker threads and the job queue
+/// @return 0 on success, negative on failure
+int32_t initWorkerPool(void);
+
+/// @brief Queues a job to be run by the next free worker
+/// @param pName The name of the job, for logging
+/// @param job The function to run
+/// @param pParams The parameter passed to the job function
+/// @param priority The priority of the job
+/// @return 0 on success, U_ERROR_COMMON_BUSY if the job queue is full,
+///         or negative on another failure
+int32_t submitWorkerJob(const char *pName, workerJob_t job, void *pParams, workerPriority_t priority);
+
+/// @brief Gets the worker pool metrics
+/// @param pMetrics The metrics structure to fill in
+void getWorkerPoolMetrics(workerPoolMetrics_t *pMetrics);
+
+/// @brief Stops the workers once they have finished their current jobs.
+///        Jobs still waiting in the queue are not run.
+/// @param timeoutMs The time to wait for the workers to finish their jobs
+/// @return 0 on success, U_ERROR_COMMON_TIMEOUT if a worker is still
+///         running a job, in which case the pool is left open
+int32_t closeWorkerPool(int32_t timeoutMs);
+
+#endif
@@ -20,6 +20,8 @@
  *
  */
 
+#define LOG_MODULE LED_TASK
+
 #include "common.h"
 #include "taskControl.h"
 #include "LEDTask.h"
@@ -101,6 +103,7 @@ static void taskLoop(void *pParameters)
     U_PORT_MUTEX_LOCK(TASK_MUTEX);
     while(!gExitApp && !exitTask) {
         int priorityLED = -1;
+        taskHeartbeat(taskConfig);
 
         // grab the leds for this app status
         ledCfg_t *leds = getAppStatusLEDs();
@@ -132,6 +135,8 @@ static void taskLoop(void *pParameters)
                     ledSet(led->n, false);
         }
 
+        // the LED loop doesn't dwell, so handle any messages every tick
+        handleTaskMessages(taskConfig);
         uPortTaskBlock(ledTick_ms);
     }
 
@@ -142,20 +147,9 @@ static void taskLoop(void *pParameters)
 
 static int32_t initQueue()
 {
-    int32_t eventQueueHandle = uPortEventQueueOpen(&queueHandler,
-                    TASK_NAME,
-                    sizeof(LEDConfigMsg_t),
-                    LED_TASK_STACK_SIZE,
-                    1,
-                    1);
-
-    if (eventQueueHandle < 0) {
-        writeLog("Failed to create %s event queue %d", TASK_NAME, eventQueueHandle);
-    }
-
-    TASK_QUEUE = eventQueueHandle;
-
-    return eventQueueHandle;
+    return openTaskQueue(taskConfig, queueHandler, sizeof(LEDConfigMsg_t),
+                         LED_TASK_STACK_SIZE, LED_TASK_STACK_SIZE,
+                         1, 1);
 }
 
 static int32_t initMutex()
@@ -187,14 +181,14 @@ int32_t initLEDTask(taskConfig_t *config)
 
 /// @brief Starts the LED Task loop
 /// @return zero if successful, a negative number otherwise
-int32_t startLEDTaskLoop(commandParamsList_t *params)
+int32_t startLEDTaskLoop(commandParams_t *params)
 {
     EXIT_IF_CANT_RUN_TASK;
     START_TASK_LOOP(LED_TASK_STACK_SIZE, LED_TASK_PRIORITY);
 }
 
 /// @brief Stop the network manager and deregister from the cellular network
-int32_t stopLEDTaskLoop(commandParamsList_t *params)
+int32_t stopLEDTaskLoop(commandParams_t *params)
 {
     STOP_TASK;
 }
@@ -202,4 +196,16 @@ int32_t stopLEDTaskLoop(commandParamsList_t *params)
 int32_t finalizeLEDTask(void)
 {
     return U_ERROR_COMMON_SUCCESS;
-}
\ No newline at end of file
+}
+
+/* ----------------------------------------------------------------
+ * TASK RUNNER
+ * -------------------------------------------------------------- */
+static void setRedLED(void *param)
+{
+    SET_RED_LED;
+}
+
+/// @brief Handles the flashing of the LEDS depending on the AppStatus global variable
+taskRunner_t ledTaskRunner = {initLEDTask, startLEDTaskLoop, stopLEDTaskLoop, finalizeLEDTask, false,
+        {LED_TASK, "LED", -1, false, BLANK_TASK_HANDLES, setRedLED}};
\ No newline at end of file
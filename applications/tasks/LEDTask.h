@@ -83,9 +83,11 @@ typedef struct {
 /* ----------------------------------------------------------------
  * COMMON TASK FUNCTIONS
  * -------------------------------------------------------------- */
+extern taskRunner_t ledTaskRunner;
+
 int32_t initLEDTask(taskConfig_t *config);
-int32_t startLEDTaskLoop(commandParamsList_t *params);
-int32_t stopLEDTaskLoop(commandParamsList_t *params);
+int32_t startLEDTaskLoop(commandParams_t *params);
+int32_t stopLEDTaskLoop(commandParams_t *params);
 int32_t finalizeLEDTask(void);
 
 /* ----------------------------------------------------------------
@@ -20,6 +20,8 @@
  *
  */
 
+#define LOG_MODULE CELL_SCAN_TASK
+
 #include "common.h"
 #include "taskControl.h"
 #include "cellScanTask.h"
@@ -30,9 +32,6 @@
  * -------------------------------------------------------------- */
 #define NETWORK_SCAN_TOPIC "NetworkScan"
 
-#define CELL_SCAN_TASK_STACK_SIZE (3*1024)
-#define CELL_SCAN_TASK_PRIORITY 5
-
 #define CELL_SCAN_QUEUE_STACK_SIZE QUEUE_STACK_SIZE_DEFAULT
 #define CELL_SCAN_QUEUE_PRIORITY 5
 #define CELL_SCAN_QUEUE_SIZE 2
@@ -48,7 +47,7 @@ static taskConfig_t *taskConfig = NULL;
  * -------------------------------------------------------------- */
 static bool stopCellScan = false;
 
-static char topicName[MAX_TOPIC_NAME_SIZE];
+static mqttTopicHandle_t taskTopic = U_ERROR_COMMON_NOT_INITIALISED;
 
 /// callback commands for incoming MQTT control messages
 static callbackCommand_t callbacks[] = {
@@ -92,7 +91,8 @@ static void doCellScan(void *pParams)
     char mccMnc[U_CELL_NET_MCC_MNC_LENGTH_BYTES];
     uCellNetRat_t rat = U_CELL_NET_RAT_UNKNOWN_OR_NOT_USED;
 
-    U_PORT_MUTEX_LOCK(TASK_MUTEX);
+    TRY_LOCK_TASK_JOB;
+    setTaskState(taskConfig, TASK_STATE_RUNNING);
     applicationStates_t tempStatus = gAppStatus;
     gAppStatus = COPS_QUERY;
     
@@ -119,7 +119,7 @@ static void doCellScan(void *pParams)
         found++;
         snprintf(payload, sizeof(payload), format, timestamp, internalBuffer, rat, mccMnc);
         writeAlways(payload);
-        sendMQTTMessage(topicName, payload, U_MQTT_QOS_AT_MOST_ONCE, false);
+        sendMQTTMessage(taskTopic, payload, U_MQTT_QOS_AT_MOST_ONCE, false);
     }
 
     if (!gExitApp) {
@@ -143,12 +143,13 @@ static void doCellScan(void *pParams)
     gAppStatus = tempStatus;
     pauseMainLoop(false);
 
+    setTaskState(taskConfig, TASK_STATE_STOPPED);
     U_PORT_MUTEX_UNLOCK(TASK_MUTEX);
 }
 
-static void startCellScan(void)
+static int32_t startCellScan(void)
 {
-    RUN_FUNC(doCellScan, CELL_SCAN_TASK_STACK_SIZE, CELL_SCAN_TASK_PRIORITY);
+    RUN_FUNC(doCellScan, WORKER_PRIORITY_LOW);
 }
 
 static void queueHandler(void *pParam, size_t paramLengthBytes)
@@ -181,20 +182,9 @@ static int32_t initMutex()
 
 static int32_t initQueue()
 {
-    int32_t eventQueueHandle = uPortEventQueueOpen(&queueHandler,
-                    TASK_NAME,
-                    sizeof(cellScanMsg_t),
-                    CELL_SCAN_QUEUE_STACK_SIZE,
-                    CELL_SCAN_QUEUE_PRIORITY,
-                    CELL_SCAN_QUEUE_SIZE);
-
-    if (eventQueueHandle < 0) {
-        writeFatal("Failed to create %s event queue %d", TASK_NAME, eventQueueHandle);
-    }
-
-    TASK_QUEUE = eventQueueHandle;
-
-    return eventQueueHandle;
+    return openTaskQueue(taskConfig, queueHandler, sizeof(cellScanMsg_t),
+                         CELL_SCAN_QUEUE_STACK_SIZE, TASK_NO_LOOP,
+                         CELL_SCAN_QUEUE_PRIORITY, CELL_SCAN_QUEUE_SIZE);
 }
 
 /* ----------------------------------------------------------------
@@ -203,7 +193,7 @@ static int32_t initQueue()
 /// @brief Places a Start Network Scan message on the queue
 /// @param params The parameters for this command
 /// @return zero if successful, a negative value otherwise
-int32_t queueNetworkScan(commandParamsList_t *params)
+int32_t queueNetworkScan(commandParams_t *params)
 {
     cellScanMsg_t qMsg;
     if (TASK_IS_RUNNING) {
@@ -228,27 +218,23 @@ int32_t initCellScanTask(taskConfig_t *config)
 
     int32_t result = U_ERROR_COMMON_SUCCESS;
 
-    CREATE_TOPIC_NAME;
+    REGISTER_TASK_TOPIC;
 
     writeLog("Initializing the %s task...", TASK_NAME);
     EXIT_ON_FAILURE(initMutex);
     EXIT_ON_FAILURE(initQueue);
 
-    char tp[MAX_TOPIC_NAME_SIZE];
-    snprintf(tp, MAX_TOPIC_NAME_SIZE, "%sControl", TASK_NAME);
-    subscribeToTopicAsync(tp, U_MQTT_QOS_AT_MOST_ONCE, callbacks, NUM_ELEMENTS(callbacks));
-
     return result;
 }
 
 /// @brief Starts the Signal Quality task loop
 /// @return zero if successful, a negative number otherwise
-int32_t startCellScanTaskLoop(commandParamsList_t *params)
+int32_t startCellScanTaskLoop(commandParams_t *params)
 {
     return U_ERROR_COMMON_NOT_IMPLEMENTED;
 }
 
-int32_t stopCellScanTask(commandParamsList_t *params)
+int32_t stopCellScanTask(commandParams_t *params)
 {
     STOP_TASK;
 }
@@ -256,4 +242,12 @@ int32_t stopCellScanTask(commandParamsList_t *params)
 int32_t finalizeCellScanTask(void)
 {
     return U_ERROR_COMMON_SUCCESS;
-}
\ No newline at end of file
+}
+
+/* ----------------------------------------------------------------
+ * TASK RUNNER
+ * -------------------------------------------------------------- */
+/// @brief Performs the +COPS=? Query for seeing what cells are available and publishes the results
+taskRunner_t cellScanTaskRunner = {initCellScanTask, startCellScanTaskLoop, stopCellScanTask, finalizeCellScanTask, false,
+        {CELL_SCAN_TASK, "CellScan", -1, false, BLANK_TASK_HANDLES, NULL},
+        callbacks, NUM_ELEMENTS(callbacks)};
\ No newline at end of file
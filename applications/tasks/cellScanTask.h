@@ -26,15 +26,17 @@
 /* ----------------------------------------------------------------
  * COMMON TASK FUNCTIONS
  * -------------------------------------------------------------- */
+extern taskRunner_t cellScanTaskRunner;
+
 int32_t initCellScanTask(taskConfig_t *config);
-int32_t startCellScanTaskLoop(commandParamsList_t *params);
-int32_t stopCellScanTask(commandParamsList_t *params);
+int32_t startCellScanTaskLoop(commandParams_t *params);
+int32_t stopCellScanTask(commandParams_t *params);
 int32_t finalizeCellScanTask(void);
 
 /* ----------------------------------------------------------------
  * PUBLIC TASK FUNCTIONS
  * -------------------------------------------------------------- */
-int32_t queueNetworkScan(commandParamsList_t *params);
+int32_t queueNetworkScan(commandParams_t *params);
 
 /* ----------------------------------------------------------------
  * QUEUE MESSAGE TYPE DEFINITIONS
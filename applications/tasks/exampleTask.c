@@ -21,6 +21,8 @@
  *
  */
 
+#define LOG_MODULE EXAMPLE_TASK
+
 #include "common.h"
 #include "taskControl.h"
 #include "exampleTask.h"
@@ -47,7 +49,7 @@ static taskConfig_t *taskConfig = NULL;
 /* ----------------------------------------------------------------
  * STATIC VARIABLES
  * -------------------------------------------------------------- */
-static char topicName[MAX_TOPIC_NAME_SIZE];
+static mqttTopicHandle_t taskTopic = U_ERROR_COMMON_NOT_INITIALISED;
 
 /// callback commands for incoming MQTT control messages
 static callbackCommand_t callbacks[] = {
@@ -71,9 +73,9 @@ static void doExampleThing(void *pParams)
     printLog("Example Function !");
 }
 
-static void startExampleThing(void)
+static int32_t startExampleThing(void)
 {
-    RUN_FUNC(doExampleThing, EXAMPLE_TASK_STACK_SIZE, EXAMPLE_TASK_PRIORITY);
+    RUN_FUNC(doExampleThing, WORKER_PRIORITY_NORMAL);
 }
 
 static void queueHandler(void *pParam, size_t paramLengthBytes)
@@ -106,20 +108,9 @@ static void taskLoop(void *pParameters)
 
 static int32_t initQueue()
 {
-    int32_t eventQueueHandle = uPortEventQueueOpen(&queueHandler,
-                    TASK_NAME,
-                    sizeof(exampleMsg_t),
-                    EXAMPLE_QUEUE_STACK_SIZE,
-                    EXAMPLE_QUEUE_PRIORITY,
-                    EXAMPLE_QUEUE_SIZE);
-
-    if (eventQueueHandle < 0) {
-        writeFatal("Failed to create %s event queue %d", TASK_NAME, eventQueueHandle);
-    }
-
-    TASK_QUEUE = eventQueueHandle;
-
-    return eventQueueHandle;
+    return openTaskQueue(taskConfig, queueHandler, sizeof(exampleMsg_t),
+                         EXAMPLE_QUEUE_STACK_SIZE, EXAMPLE_TASK_STACK_SIZE,
+                         EXAMPLE_QUEUE_PRIORITY, EXAMPLE_QUEUE_SIZE);
 }
 
 static int32_t initMutex()
@@ -133,7 +124,7 @@ static int32_t initMutex()
 /// @brief Queue the getLocation operation
 /// @param params The parameters for this command
 /// @return returns the errorCode of sending the message on the eventQueue
-int32_t queueExampleCommand(commandParamsList_t *params)
+int32_t queueExampleCommand(commandParams_t *params)
 {
     exampleMsg_t qMsg;
     qMsg.msgType = RUN_EXAMPLE;
@@ -152,22 +143,18 @@ int32_t initExampleTask(taskConfig_t *config)
 
     int32_t result = U_ERROR_COMMON_SUCCESS;
 
-    CREATE_TOPIC_NAME;
+    REGISTER_TASK_TOPIC;
 
     writeLog("Initializing the %s task...", TASK_NAME);
     EXIT_ON_FAILURE(initMutex);
     EXIT_ON_FAILURE(initQueue);
 
-    char tp[MAX_TOPIC_NAME_SIZE];
-    snprintf(tp, MAX_TOPIC_NAME_SIZE, "%sControl", TASK_NAME);
-    subscribeToTopicAsync(tp, U_MQTT_QOS_AT_MOST_ONCE, callbacks, NUM_ELEMENTS(callbacks));
-
     return result;
 }
 
 /// @brief Starts the Signal Quality task loop
 /// @return zero if successful, a negative number otherwise
-int32_t startExampleTaskLoop(commandParamsList_t *params)
+int32_t startExampleTaskLoop(commandParams_t *params)
 {
     EXIT_IF_CANT_RUN_TASK;
 
@@ -177,7 +164,7 @@ int32_t startExampleTaskLoop(commandParamsList_t *params)
     START_TASK_LOOP(EXAMPLE_TASK_STACK_SIZE, EXAMPLE_TASK_PRIORITY);
 }
 
-int32_t stopExampleTaskLoop(commandParamsList_t *params)
+int32_t stopExampleTaskLoop(commandParams_t *params)
 {
     STOP_TASK;
 }
@@ -185,4 +172,12 @@ int32_t stopExampleTaskLoop(commandParamsList_t *params)
 int32_t finalizeExampleTask(void)
 {
     return U_ERROR_COMMON_SUCCESS;
-}
\ No newline at end of file
+}
+
+/* ----------------------------------------------------------------
+ * TASK RUNNER
+ * -------------------------------------------------------------- */
+/// @brief Simple example task that does "nothing"
+taskRunner_t exampleTaskRunner = {initExampleTask, startExampleTaskLoop, stopExampleTaskLoop, finalizeExampleTask, false,
+        {EXAMPLE_TASK, "Example", 30, false, BLANK_TASK_HANDLES, NULL},
+        callbacks, NUM_ELEMENTS(callbacks)};
\ No newline at end of file
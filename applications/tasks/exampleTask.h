@@ -26,15 +26,17 @@
 /* ----------------------------------------------------------------
  * COMMON TASK FUNCTIONS
  * -------------------------------------------------------------- */
+extern taskRunner_t exampleTaskRunner;
+
 int32_t initExampleTask(taskConfig_t *config);
-int32_t startExampleTaskLoop(commandParamsList_t *params);
-int32_t stopExampleTaskLoop(commandParamsList_t *params);
+int32_t startExampleTaskLoop(commandParams_t *params);
+int32_t stopExampleTaskLoop(commandParams_t *params);
 int32_t finalizeExampleTask(void);
 
 /* ----------------------------------------------------------------
  * PUBLIC TASK FUNCTIONS
  * -------------------------------------------------------------- */
-int32_t queueExampleCommand(commandParamsList_t *params);
+int32_t queueExampleCommand(commandParams_t *params);
 
 /* ----------------------------------------------------------------
  * QUEUE MESSAGE TYPE DEFINITIONS
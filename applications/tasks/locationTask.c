@@ -22,6 +22,8 @@
 
 #include <time.h>
 
+#define LOG_MODULE LOCATION_TASK
+
 #include "common.h"
 #include "taskControl.h"
 #include "locationTask.h"
@@ -65,7 +67,7 @@ static uDeviceHandle_t gnssHandle;
 static bool stopLocation = false;
 static bool gettingLocation = false;
 
-static char topicName[MAX_TOPIC_NAME_SIZE];
+static mqttTopicHandle_t taskTopic = U_ERROR_COMMON_NOT_INITIALISED;
 
 /// callback commands for incoming MQTT control messages
 static callbackCommand_t callbacks[] = {
@@ -153,19 +155,13 @@ static void publishLocation(uLocation_t location)
             location.speedMillimetresPerSecond,
             t->tm_year + 1900, t->tm_mon, t->tm_mday, t->tm_hour, t->tm_min, t->tm_sec);
 
-    sendMQTTMessage(topicName, jsonBuffer, U_MQTT_QOS_AT_MOST_ONCE, false);
+    sendMQTTMessage(taskTopic, jsonBuffer, U_MQTT_QOS_AT_MOST_ONCE, false);
     writeAlways(jsonBuffer);
 }
 
-static void getLocation(void *pParams)
+/// @brief Gets the location and publishes it, with the task mutex held
+static void requestLocation(void)
 {
-    if (gettingLocation) {
-        printDebug("getLocation(): Already trying to get location...");
-        return;
-    }
-
-    U_PORT_MUTEX_LOCK(TASK_MUTEX);
-
     uLocation_t location;   
     gettingLocation = true;
 
@@ -185,13 +181,32 @@ static void getLocation(void *pParams)
 
     // reset the stop location indicator
     stopLocation = false;
+}
+
+static void getLocation(void *pParams)
+{
+    if (gettingLocation) {
+        printDebug("getLocation(): Already trying to get location...");
+        return;
+    }
+
+    U_PORT_MUTEX_LOCK(TASK_MUTEX);
+    requestLocation();
+    U_PORT_MUTEX_UNLOCK(TASK_MUTEX);
+}
 
+/// @brief The worker job for a location request, which is dropped if the
+///        task loop or another request is already getting the location
+static void getLocationJob(void *pParams)
+{
+    TRY_LOCK_TASK_JOB;
+    requestLocation();
     U_PORT_MUTEX_UNLOCK(TASK_MUTEX);
 }
 
-static void startGetLocation(void)
+static int32_t startGetLocation(void)
 {
-    RUN_FUNC(getLocation, LOCATION_TASK_STACK_SIZE, LOCATION_TASK_PRIORITY);
+    RUN_FUNC(getLocationJob, WORKER_PRIORITY_HIGH);
 }
 
 static void queueHandler(void *pParam, size_t paramLengthBytes)
@@ -231,20 +246,9 @@ static void taskLoop(void *pParameters)
 
 static int32_t initQueue()
 {
-    int32_t eventQueueHandle = uPortEventQueueOpen(&queueHandler,
-                    TASK_NAME,
-                    sizeof(locationMsg_t),
-                    LOCATION_QUEUE_STACK_SIZE,
-                    LOCATION_QUEUE_PRIORITY,
-                    LOCATION_QUEUE_SIZE);
-
-    if (eventQueueHandle < 0) {
-        writeFatal("Failed to create %s event queue %d", TASK_NAME, eventQueueHandle);
-    }
-
-    TASK_QUEUE = eventQueueHandle;
-
-    return eventQueueHandle;
+    return openTaskQueue(taskConfig, queueHandler, sizeof(locationMsg_t),
+                         LOCATION_QUEUE_STACK_SIZE, LOCATION_TASK_STACK_SIZE,
+                         LOCATION_QUEUE_PRIORITY, LOCATION_QUEUE_SIZE);
 }
 
 static int32_t startGNSS(void)
@@ -279,7 +283,7 @@ static int32_t initMutex()
 /// @brief Queue the getLocation operation
 /// @param params The parameters for this command
 /// @return returns the errorCode of sending the message on the eventQueue
-int32_t queueLocationNow(commandParamsList_t *params)
+int32_t queueLocationNow(commandParams_t *params)
 {
     locationMsg_t qMsg;
     qMsg.msgType = GET_LOCATION_NOW;
@@ -298,7 +302,7 @@ int32_t initLocationTask(taskConfig_t *config)
 
     int32_t result = U_ERROR_COMMON_SUCCESS;
 
-    CREATE_TOPIC_NAME;
+    REGISTER_TASK_TOPIC;
 
     writeLog("Initializing the %s task...", TASK_NAME);
     EXIT_ON_FAILURE(initMutex);
@@ -310,16 +314,12 @@ int32_t initLocationTask(taskConfig_t *config)
         return result;
     }
 
-    char tp[MAX_TOPIC_NAME_SIZE];
-    snprintf(tp, MAX_TOPIC_NAME_SIZE, "%sControl", TASK_NAME);
-    subscribeToTopicAsync(tp, U_MQTT_QOS_AT_MOST_ONCE, callbacks, NUM_ELEMENTS(callbacks));
-
     return result;
 }
 
 /// @brief Starts the Signal Quality task loop
 /// @return zero if successful, a negative number otherwise
-int32_t startLocationTaskLoop(commandParamsList_t *params)
+int32_t startLocationTaskLoop(commandParams_t *params)
 {
     EXIT_IF_CANT_RUN_TASK;
 
@@ -329,7 +329,7 @@ int32_t startLocationTaskLoop(commandParamsList_t *params)
     START_TASK_LOOP(LOCATION_TASK_STACK_SIZE, LOCATION_TASK_PRIORITY);
 }
 
-int32_t stopLocationTaskLoop(commandParamsList_t *params)
+int32_t stopLocationTaskLoop(commandParams_t *params)
 {
     STOP_TASK;
 }
@@ -343,4 +343,12 @@ int32_t finalizeLocationTask(void)
     }
 
     return U_ERROR_COMMON_SUCCESS;
-}
\ No newline at end of file
+}
+
+/* ----------------------------------------------------------------
+ * TASK RUNNER
+ * -------------------------------------------------------------- */
+/// @brief Periodically gets the GNSS location of the device and publishes the results
+taskRunner_t locationTaskRunner = {initLocationTask, startLocationTaskLoop, stopLocationTaskLoop, finalizeLocationTask, false,
+        {LOCATION_TASK, "Location", 30, false, BLANK_TASK_HANDLES, NULL},
+        callbacks, NUM_ELEMENTS(callbacks)};
\ No newline at end of file
@@ -26,15 +26,17 @@
 /* ----------------------------------------------------------------
  * COMMON TASK FUNCTIONS
  * -------------------------------------------------------------- */
+extern taskRunner_t locationTaskRunner;
+
 int32_t initLocationTask(taskConfig_t *config);
-int32_t startLocationTaskLoop(commandParamsList_t *params);
-int32_t stopLocationTaskLoop(commandParamsList_t *params);
+int32_t startLocationTaskLoop(commandParams_t *params);
+int32_t stopLocationTaskLoop(commandParams_t *params);
 int32_t finalizeLocationTask(void);
 
 /* ----------------------------------------------------------------
  * PUBLIC TASK FUNCTIONS
  * -------------------------------------------------------------- */
-int32_t queueLocationNow(commandParamsList_t *params);
+int32_t queueLocationNow(commandParams_t *params);
 
 /* ----------------------------------------------------------------
  * QUEUE MESSAGE TYPE DEFINITIONS
@@ -0,0 +1,439 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *
+ * Log Upload Task to upload the log file, or a time range of it, over MQTT.
+ *
+ * The log is sent in numbered chunks which are LZ4 compressed and base64
+ * encoded. The receiver acknowledges the chunks with the ACK_LOG command,
+ * which names the upload, and only a small window of chunks is sent ahead of the last acknowledged
+ * chunk. If the MQTT connection is lost, or the acknowledgements stop, the
+ * upload resumes from the chunk after the last acknowledged one.
+ *
+ */
+
+#define LOG_MODULE LOG_UPLOAD_TASK
+
+#include "common.h"
+#include "taskControl.h"
+#include "logUploadTask.h"
+#include "mqttTask.h"
+#include "compress.h"
+
+/* ----------------------------------------------------------------
+ * DEFINES
+ * -------------------------------------------------------------- */
+#define LOG_UPLOAD_QUEUE_STACK_SIZE QUEUE_STACK_SIZE_DEFAULT
+#define LOG_UPLOAD_QUEUE_PRIORITY 5
+#define LOG_UPLOAD_QUEUE_SIZE 5
+
+// Raw log bytes in each chunk
+#define LOG_UPLOAD_CHUNK_SIZE 2048
+
+// Number of chunks which can be sent ahead of the last acknowledged chunk
+#define LOG_UPLOAD_WINDOW 4
+
+// Time between publishing chunks, so other telemetry can still be published
+#define LOG_UPLOAD_CHUNK_PACE_MS 1000
+
+// If no acknowledgement is received in this time the window is resent
+#define LOG_UPLOAD_ACK_TIMEOUT_MS 30000
+#define LOG_UPLOAD_MAX_RETRIES 5
+
+#define LOG_UPLOAD_COMPRESSED_SIZE LZ4_COMPRESS_BOUND(LOG_UPLOAD_CHUNK_SIZE)
+#define LOG_UPLOAD_ENCODED_SIZE BASE64_ENCODED_SIZE(LOG_UPLOAD_COMPRESSED_SIZE)
+#define LOG_UPLOAD_MESSAGE_SIZE (LOG_UPLOAD_ENCODED_SIZE + 200)
+
+#if LOG_UPLOAD_MESSAGE_SIZE > MAX_MESSAGE_SIZE
+#error "LOG_UPLOAD_CHUNK_SIZE is too big for an MQTT message"
+#endif
+
+/* ----------------------------------------------------------------
+ * COMMON TASK VARIABLES
+ * -------------------------------------------------------------- */
+static taskConfig_t *taskConfig = NULL;
+
+/* ----------------------------------------------------------------
+ * STATIC VARIABLES
+ * -------------------------------------------------------------- */
+static mqttTopicHandle_t taskTopic = U_ERROR_COMMON_NOT_INITIALISED;
+
+/// callback commands for incoming MQTT control messages
+static callbackCommand_t callbacks[] = {
+    {"UPLOAD_LOG", queueLogUpload},
+    {"ACK_LOG", queueLogUploadAck},
+    {"CANCEL_LOG_UPLOAD", queueLogUploadCancel}
+};
+
+static int32_t uploadStartTime;
+static int32_t uploadEndTime;
+static int32_t uploadId = 0;
+
+static volatile int32_t lastAckedChunk = -1;
+static volatile bool cancelUpload = false;
+
+// set from when an upload is queued until its job has finished, so a
+// second upload can't be queued before the first job has started
+static volatile bool uploadPending = false;
+
+static uint8_t rawBuffer[LOG_UPLOAD_CHUNK_SIZE];
+static uint8_t compressedBuffer[LOG_UPLOAD_COMPRESSED_SIZE];
+static char encodedBuffer[LOG_UPLOAD_ENCODED_SIZE];
+static char messageBuffer[LOG_UPLOAD_MESSAGE_SIZE];
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+/// @brief check if the application is exiting, or upload cancelled
+static bool isNotExiting(void)
+{
+    return !gExitApp && !cancelUpload;
+}
+
+/// @brief Reads, compresses and publishes one chunk of the log
+/// @return the compressed size of the chunk, or negative on failure
+static int32_t publishChunk(int32_t chunk, int32_t totalChunks, size_t startOffset, size_t endOffset)
+{
+    size_t offset = startOffset + (chunk * LOG_UPLOAD_CHUNK_SIZE);
+    size_t size = MIN(LOG_UPLOAD_CHUNK_SIZE, endOffset - offset);
+
+    int32_t count = readLogFile(offset, rawBuffer, size);
+    if (count != size) {
+        writeError("Failed to read log chunk #%d: %d", chunk, count);
+        return count < 0 ? count : U_ERROR_COMMON_DEVICE_ERROR;
+    }
+
+    // send the raw log if it doesn't compress
+    const char *encoding = "lz4";
+    const uint8_t *data = compressedBuffer;
+    int32_t dataSize = lz4Compress(rawBuffer, size, compressedBuffer, sizeof(compressedBuffer));
+    if (dataSize < 0 || dataSize >= size) {
+        encoding = "raw";
+        data = rawBuffer;
+        dataSize = size;
+    }
+
+    base64Encode(data, dataSize, encodedBuffer, sizeof(encodedBuffer));
+
+    char timestamp[TIMESTAMP_MAX_LENTH_BYTES];
+    getTimeStamp(timestamp);
+
+    char format[] = "{"                     \
+        "\"Timestamp\":\"%s\", "            \
+        "\"LogUpload\":{"                   \
+            "\"Id\":%d, "                   \
+            "\"Chunk\":%d, "                \
+            "\"Total\":%d, "                \
+            "\"Size\":%d, "                 \
+            "\"Encoding\":\"%s\", "         \
+            "\"Data\":\"%s\"}"              \
+    "}";
+
+    snprintf(messageBuffer, LOG_UPLOAD_MESSAGE_SIZE, format, timestamp,
+                uploadId, chunk, totalChunks, size, encoding, encodedBuffer);
+
+    int32_t errorCode = sendMQTTMessage(taskTopic, messageBuffer, U_MQTT_QOS_AT_MOST_ONCE, false);
+    if (errorCode < 0)
+        return errorCode;
+
+    printDebug("Published log chunk #%d of %d (%d/%d bytes)", chunk, totalChunks, dataSize, size);
+
+    return dataSize;
+}
+
+static void publishUploadResult(const char *result, int32_t chunks, size_t rawBytes,
+                                size_t compressedBytes, int32_t timeMS)
+{
+    int32_t ratio = rawBytes > 0 ? (int32_t)((compressedBytes * 100) / rawBytes) : 0;
+    int32_t bytesPerSecond = timeMS > 0 ? (int32_t)(((int64_t)rawBytes * 1000) / timeMS) : 0;
+
+    char timestamp[TIMESTAMP_MAX_LENTH_BYTES];
+    getTimeStamp(timestamp);
+
+    char format[] = "{"                     \
+        "\"Timestamp\":\"%s\", "            \
+        "\"LogUpload\":{"                   \
+            "\"Id\":%d, "                   \
+            "\"Result\":\"%s\", "           \
+            "\"Chunks\":%d, "               \
+            "\"Bytes\":%d, "                \
+            "\"CompressedBytes\":%d, "      \
+            "\"CompressionPercent\":%d, "   \
+            "\"TimeMS\":%d, "               \
+            "\"BytesPerSecond\":%d}"        \
+    "}";
+
+    snprintf(messageBuffer, LOG_UPLOAD_MESSAGE_SIZE, format, timestamp, uploadId, result,
+                chunks, rawBytes, compressedBytes, ratio, timeMS, bytesPerSecond);
+
+    sendMQTTMessage(taskTopic, messageBuffer, U_MQTT_QOS_AT_MOST_ONCE, false);
+    writeAlways(messageBuffer);
+}
+
+static void doLogUpload(void *pParams)
+{
+    size_t startOffset, endOffset;
+    size_t compressedBytes = 0;
+    int32_t totalChunks = 0;
+    int32_t startTime = uPortGetTickTimeMs();
+    const char *result = "Cancelled";
+
+    TRY_LOCK_TASK_JOB;
+    setTaskState(taskConfig, TASK_STATE_RUNNING);
+
+    flushLogFile();
+
+    if (getLogFileRange(uploadStartTime, uploadEndTime, &startOffset, &endOffset) < 0 ||
+        startOffset == endOffset) {
+        writeWarn("No log entries to upload between %d and %d", uploadStartTime, uploadEndTime);
+        result = "Empty";
+        startOffset = endOffset = 0;
+        goto cleanUp;
+    }
+
+    totalChunks = (endOffset - startOffset + LOG_UPLOAD_CHUNK_SIZE - 1) / LOG_UPLOAD_CHUNK_SIZE;
+    int32_t nextChunk = 0;
+    int32_t highestSentChunk = -1;
+    int32_t ackedChunk = -1;
+    int32_t retries = 0;
+    int32_t lastProgressTime = startTime;
+
+    writeLog("Uploading log #%d, %d bytes in %d chunks...", uploadId, endOffset - startOffset, totalChunks);
+
+    while(isNotExiting() && lastAckedChunk < totalChunks - 1) {
+        // keep track of the acknowledgements, resetting the retry timer
+        if (lastAckedChunk != ackedChunk) {
+            ackedChunk = lastAckedChunk;
+            lastProgressTime = uPortGetTickTimeMs();
+            retries = 0;
+        }
+
+        // wait for the MQTT connection, and resume from the last acknowledged chunk
+        if (!isEventActive(EVENT_MQTT_CONNECTED)) {
+            if (nextChunk != ackedChunk + 1)
+                writeInfo("MQTT not connected, log upload will resume from chunk #%d", ackedChunk + 1);
+
+            nextChunk = ackedChunk + 1;
+            lastProgressTime = uPortGetTickTimeMs();
+            waitForEvent(EVENT_MQTT_CONNECTED, 1000);
+            continue;
+        }
+
+        if (nextChunk < totalChunks && nextChunk <= ackedChunk + LOG_UPLOAD_WINDOW) {
+            int32_t size = publishChunk(nextChunk, totalChunks, startOffset, endOffset);
+            if (size >= 0) {
+                if (nextChunk > highestSentChunk) {
+                    highestSentChunk = nextChunk;
+                    compressedBytes += size;
+                }
+
+                nextChunk++;
+            }
+
+            uPortTaskBlock(LOG_UPLOAD_CHUNK_PACE_MS);
+            continue;
+        }
+
+        // the window is full, so wait for the acknowledgements
+        if (uPortGetTickTimeMs() - lastProgressTime > LOG_UPLOAD_ACK_TIMEOUT_MS) {
+            retries++;
+            if (retries > LOG_UPLOAD_MAX_RETRIES) {
+                writeWarn("Log upload #%d failed, no acknowledgement after %d retries", uploadId, LOG_UPLOAD_MAX_RETRIES);
+                result = "Failed";
+                goto cleanUp;
+            }
+
+            writeInfo("No log upload acknowledgement, resending from chunk #%d", ackedChunk + 1);
+            nextChunk = ackedChunk + 1;
+            lastProgressTime = uPortGetTickTimeMs();
+        }
+
+        uPortTaskBlock(100);
+    }
+
+    if (lastAckedChunk >= totalChunks - 1)
+        result = "Complete";
+
+cleanUp:
+    // the requester is told how every upload ended, not only the complete ones
+    publishUploadResult(result, totalChunks, endOffset - startOffset, compressedBytes,
+                            uPortGetTickTimeMs() - startTime);
+    writeLog("Log upload #%d finished: %s", uploadId, result);
+
+    cancelUpload = false;
+    setTaskState(taskConfig, TASK_STATE_STOPPED);
+    U_PORT_MUTEX_UNLOCK(TASK_MUTEX);
+
+    uploadPending = false;
+}
+
+static int32_t startLogUpload(void)
+{
+    RUN_FUNC(doLogUpload, WORKER_PRIORITY_LOW);
+}
+
+static void queueHandler(void *pParam, size_t paramLengthBytes)
+{
+    logUploadMsg_t *qMsg = (logUploadMsg_t *) pParam;
+
+    switch(qMsg->msgType) {
+        case START_LOG_UPLOAD:
+            if (uploadPending || TASK_IS_RUNNING) {
+                writeWarn("Log upload is already in progress, not starting another");
+                break;
+            }
+
+            uploadStartTime = qMsg->msg.range.startTime;
+            uploadEndTime = qMsg->msg.range.endTime;
+            uploadId++;
+            lastAckedChunk = -1;
+            cancelUpload = false;
+            uploadPending = true;
+            if (startLogUpload() < 0)
+                uploadPending = false;
+            break;
+
+        case ACK_LOG_UPLOAD:
+            // an acknowledgement of an earlier upload is late, not progress
+            if (qMsg->msg.ack.id != uploadId) {
+                writeDebug("Ignoring the acknowledgement of log upload #%d", qMsg->msg.ack.id);
+                break;
+            }
+
+            if (qMsg->msg.ack.chunk > lastAckedChunk)
+                lastAckedChunk = qMsg->msg.ack.chunk;
+            break;
+
+        case CANCEL_LOG_UPLOAD:
+            cancelUpload = true;
+            break;
+
+        default:
+            writeWarn("Unknown message type: %d", qMsg->msgType);
+            break;
+    }
+}
+
+static int32_t initMutex()
+{
+    INIT_MUTEX;
+}
+
+static int32_t initQueue()
+{
+    return openTaskQueue(taskConfig, queueHandler, sizeof(logUploadMsg_t),
+                         LOG_UPLOAD_QUEUE_STACK_SIZE, TASK_NO_LOOP,
+                         LOG_UPLOAD_QUEUE_PRIORITY, LOG_UPLOAD_QUEUE_SIZE);
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+/// @brief Queues the upload of the log file
+/// @param params The optional start and end unix times of the log to upload
+/// @return zero if successful, a negative value otherwise
+int32_t queueLogUpload(commandParams_t *params)
+{
+    logUploadMsg_t qMsg;
+    qMsg.msgType = START_LOG_UPLOAD;
+    qMsg.msg.range.startTime = getParamValue(params, 1, 0, INT32_MAX, 0);
+    qMsg.msg.range.endTime = getParamValue(params, 2, 0, INT32_MAX, INT32_MAX);
+
+    return sendAppTaskMessage(TASK_ID, &qMsg, sizeof(logUploadMsg_t));
+}
+
+/// @brief Queues the acknowledgement of the log chunks received
+/// @param params The upload Id, and the chunk number which has been
+///               received, and all before it
+/// @return zero if successful, a negative value otherwise
+int32_t queueLogUploadAck(commandParams_t *params)
+{
+    logUploadMsg_t qMsg;
+    qMsg.msgType = ACK_LOG_UPLOAD;
+    qMsg.msg.ack.id = getParamValue(params, 1, 0, INT32_MAX, 0);
+    qMsg.msg.ack.chunk = getParamValue(params, 2, -1, INT32_MAX, -1);
+
+    return sendAppTaskMessage(TASK_ID, &qMsg, sizeof(logUploadMsg_t));
+}
+
+/// @brief Queues the cancelling of the current log upload
+/// @param params The parameters for this command
+/// @return zero if successful, a negative value otherwise
+int32_t queueLogUploadCancel(commandParams_t *params)
+{
+    logUploadMsg_t qMsg;
+    qMsg.msgType = CANCEL_LOG_UPLOAD;
+
+    return sendAppTaskMessage(TASK_ID, &qMsg, sizeof(logUploadMsg_t));
+}
+
+/// @brief Initialises the log upload task
+/// @param config The task configuration structure
+/// @return zero if successful, a negative number otherwise
+int32_t initLogUploadTask(taskConfig_t *config)
+{
+    EXIT_IF_CONFIG_NULL;
+
+    taskConfig = config;
+
+    int32_t result = U_ERROR_COMMON_SUCCESS;
+
+    REGISTER_TASK_TOPIC;
+
+    writeLog("Initializing the %s task...", TASK_NAME);
+    EXIT_ON_FAILURE(initMutex);
+    EXIT_ON_FAILURE(initQueue);
+
+    return result;
+}
+
+/// @brief The log upload task has no task loop, uploads are run on request
+/// @return U_ERROR_COMMON_NOT_IMPLEMENTED
+int32_t startLogUploadTaskLoop(commandParams_t *params)
+{
+    return U_ERROR_COMMON_NOT_IMPLEMENTED;
+}
+
+/// @brief Stops the log upload which is running, by cancelling it, so the
+///        task still runs the uploads which are requested afterwards
+/// @return zero if successful, a negative value otherwise
+int32_t stopLogUploadTask(commandParams_t *params)
+{
+    if (taskConfig == NULL) {
+        writeDebug("Stop %s task requested, but it is not initialised", TASK_NAME);
+        return U_ERROR_COMMON_NOT_INITIALISED;
+    }
+
+    cancelUpload = true;
+    requestTaskStop(taskConfig);
+    writeLog("Stop %s task requested...", TASK_NAME);
+    return U_ERROR_COMMON_SUCCESS;
+}
+
+int32_t finalizeLogUploadTask(void)
+{
+    return U_ERROR_COMMON_SUCCESS;
+}
+
+/* ----------------------------------------------------------------
+ * TASK RUNNER
+ * -------------------------------------------------------------- */
+/// @brief Uploads the log file, or a time range of it, in compressed chunks over MQTT
+taskRunner_t logUploadTaskRunner = {initLogUploadTask, startLogUploadTaskLoop, stopLogUploadTask, finalizeLogUploadTask, false,
+        {LOG_UPLOAD_TASK, "LogUpload", -1, false, BLANK_TASK_HANDLES, NULL},
+        callbacks, NUM_ELEMENTS(callbacks)};
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *
+ * Log Upload Task header
+ *
+ */
+
+#ifndef _LOG_UPLOAD_TASK_H_
+#define _LOG_UPLOAD_TASK_H_
+
+/* ----------------------------------------------------------------
+ * COMMON TASK FUNCTIONS
+ * -------------------------------------------------------------- */
+extern taskRunner_t logUploadTaskRunner;
+
+int32_t initLogUploadTask(taskConfig_t *config);
+int32_t startLogUploadTaskLoop(commandParams_t *params);
+int32_t stopLogUploadTask(commandParams_t *params);
+int32_t finalizeLogUploadTask(void);
+
+/* ----------------------------------------------------------------
+ * PUBLIC TASK FUNCTIONS
+ * -------------------------------------------------------------- */
+int32_t queueLogUpload(commandParams_t *params);
+int32_t queueLogUploadAck(commandParams_t *params);
+int32_t queueLogUploadCancel(commandParams_t *params);
+
+/* ----------------------------------------------------------------
+ * QUEUE MESSAGE TYPE DEFINITIONS
+ * -------------------------------------------------------------- */
+typedef enum {
+    START_LOG_UPLOAD,           // starts uploading the log file, or a time range of it
+    ACK_LOG_UPLOAD,             // acknowledges the chunks of an upload up to the chunk number
+    CANCEL_LOG_UPLOAD,          // cancels the current log upload
+} logUploadMsgType_t;
+
+typedef struct {
+    logUploadMsgType_t msgType;
+
+    union {
+        struct {
+            int32_t startTime;  // unix time of the start of the log range
+            int32_t endTime;    // unix time of the end of the log range
+        } range;
+
+        struct {
+            int32_t id;         // Id of the upload which is acknowledged
+            int32_t chunk;      // chunk number which is acknowledged
+        } ack;
+    } msg;
+} logUploadMsg_t;
+
+#endif
@@ -0,0 +1,370 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ *
+ * Monitor Task to report the stack high-water mark and the CPU share of
+ * every thread, so the stack sizes can be set from what is really used.
+ * The task threads, event queue threads and worker threads are all
+ * reported, as are the ubxlib and Zephyr threads.
+ *
+ */
+
+#define LOG_MODULE MONITOR_TASK
+
+#include "common.h"
+#include "taskControl.h"
+#include "monitorTask.h"
+#include "mqttTask.h"
+#include "taskSupervisor.h"
+
+/* ----------------------------------------------------------------
+ * DEFINES
+ * -------------------------------------------------------------- */
+#define MONITOR_TASK_STACK_SIZE (2 * 1024)
+#define MONITOR_TASK_PRIORITY 5
+
+#define MONITOR_QUEUE_STACK_SIZE QUEUE_STACK_SIZE_DEFAULT
+#define MONITOR_QUEUE_PRIORITY 5
+#define MONITOR_QUEUE_SIZE 1
+
+#define MONITOR_MAX_THREADS 40
+#define MONITOR_THREAD_NAME_SIZE 16
+
+// a thread which has used more of its stack than this is warned about
+#define MONITOR_STACK_WARN_PERCENT 90
+
+#define MONITOR_MESSAGE_SIZE 1536
+
+/* ----------------------------------------------------------------
+ * TYPE DEFINITIONS
+ * -------------------------------------------------------------- */
+typedef struct {
+    const struct k_thread *thread;
+    char name[MONITOR_THREAD_NAME_SIZE];
+    size_t stackSize;
+    size_t stackUsed;
+
+    // execution cycles at the last report, for the CPU share since then
+    uint64_t cycles;
+    int32_t cpuPercent;
+
+    bool seen;
+} threadStats_t;
+
+/* ----------------------------------------------------------------
+ * TASK COMMON VARIABLES
+ * -------------------------------------------------------------- */
+static bool exitTask = false;
+static taskConfig_t *taskConfig = NULL;
+
+/* ----------------------------------------------------------------
+ * STATIC VARIABLES
+ * -------------------------------------------------------------- */
+static mqttTopicHandle_t taskTopic = U_ERROR_COMMON_NOT_INITIALISED;
+
+static threadStats_t threads[MONITOR_MAX_THREADS];
+static size_t threadCount = 0;
+static size_t threadsNotTracked = 0;
+
+static uint64_t totalCycles = 0;
+static uint64_t cyclesSinceReport = 0;
+
+static char jsonBuffer[MONITOR_MESSAGE_SIZE];
+
+/// callback commands for incoming MQTT control messages
+static callbackCommand_t callbacks[] = {
+    {"REPORT_NOW", queueMonitorReport},
+    {"START_TASK", startMonitorTaskLoop},
+    {"STOP_TASK", stopMonitorTaskLoop}
+};
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+/// @brief check if the application is exiting, or task stopping
+static bool isNotExiting(void)
+{
+    return !gExitApp && !exitTask;
+}
+
+static threadStats_t *findThreadStats(const struct k_thread *thread)
+{
+    for(size_t i=0; i<threadCount; i++) {
+        if (threads[i].thread == thread)
+            return &threads[i];
+    }
+
+    if (threadCount == MONITOR_MAX_THREADS)
+        return NULL;
+
+    threadStats_t *stats = &threads[threadCount++];
+    memset(stats, 0, sizeof(threadStats_t));
+    stats->thread = thread;
+
+    return stats;
+}
+
+/// @brief Records the stack and CPU usage of one thread. This is called
+///        without the thread list locked, so it can take its time.
+static void recordThread(const struct k_thread *thread, void *pUserData)
+{
+    threadStats_t *stats = findThreadStats(thread);
+    if (stats == NULL) {
+        threadsNotTracked++;
+        return;
+    }
+
+    k_tid_t tid = (k_tid_t)thread;
+    char name[MONITOR_THREAD_NAME_SIZE];
+    const char *threadName = k_thread_name_get(tid);
+    if (threadName != NULL && threadName[0] != 0)
+        snprintf(name, MONITOR_THREAD_NAME_SIZE, "%s", threadName);
+    else
+        snprintf(name, MONITOR_THREAD_NAME_SIZE, "%p", (void *)thread);
+
+    // a thread which has ended can be followed by a new thread at the same
+    // address, which is then counted as a new thread
+    bool newThread = strcmp(stats->name, name) != 0;
+    memcpy(stats->name, name, MONITOR_THREAD_NAME_SIZE);
+
+    size_t unused = 0;
+    stats->stackSize = thread->stack_info.size;
+    if (k_thread_stack_space_get(thread, &unused) == 0)
+        stats->stackUsed = stats->stackSize - unused;
+
+    stats->cpuPercent = -1;
+#ifdef CONFIG_THREAD_RUNTIME_STATS
+    k_thread_runtime_stats_t runtime;
+    if (k_thread_runtime_stats_get(tid, &runtime) == 0) {
+        // a new thread's cycles are all since the last report
+        if (newThread || runtime.execution_cycles < stats->cycles)
+            stats->cycles = 0;
+
+        uint64_t cycles = runtime.execution_cycles - stats->cycles;
+        if (cyclesSinceReport > 0)
+            stats->cpuPercent = (int32_t)((cycles * 100) / cyclesSinceReport);
+
+        stats->cycles = runtime.execution_cycles;
+    }
+#endif
+
+    stats->seen = true;
+}
+
+/// @brief Records all the threads, and forgets the threads which have ended
+static void recordThreads(void)
+{
+#ifdef CONFIG_THREAD_RUNTIME_STATS
+    k_thread_runtime_stats_t runtime;
+    if (k_thread_runtime_stats_all_get(&runtime) == 0) {
+        cyclesSinceReport = runtime.execution_cycles - totalCycles;
+        totalCycles = runtime.execution_cycles;
+    }
+#endif
+
+    for(size_t i=0; i<threadCount; i++)
+        threads[i].seen = false;
+
+    threadsNotTracked = 0;
+    k_thread_foreach_unlocked(recordThread, NULL);
+
+    for(size_t i=0; i<threadCount; ) {
+        if (threads[i].seen)
+            i++;
+        else
+            threads[i] = threads[--threadCount];
+    }
+}
+
+static int32_t stackUsedPercent(const threadStats_t *stats)
+{
+    if (stats->stackSize == 0)
+        return 0;
+
+    return (int32_t)((stats->stackUsed * 100) / stats->stackSize);
+}
+
+static void logThreads(void)
+{
+    writeInfo("%-16s %6s %6s %4s %4s", "Thread", "Stack", "Used", "%", "CPU%");
+    for(size_t i=0; i<threadCount; i++) {
+        threadStats_t *stats = &threads[i];
+        int32_t usedPercent = stackUsedPercent(stats);
+
+        writeInfo("%-16s %6d %6d %4d %4d", stats->name, (int)stats->stackSize,
+                    (int)stats->stackUsed, usedPercent, stats->cpuPercent);
+
+        if (usedPercent > MONITOR_STACK_WARN_PERCENT)
+            writeWarn("Thread %s has used %d%% of its stack", stats->name, usedPercent);
+    }
+
+    if (threadsNotTracked > 0)
+        writeWarn("%d threads were not monitored, only %d can be", (int)threadsNotTracked, MONITOR_MAX_THREADS);
+}
+
+/// @brief Publishes the report as compact JSON, with each thread as
+///        [name, stack size, stack used, CPU %]
+static void publishThreads(void)
+{
+    char timestamp[TIMESTAMP_MAX_LENTH_BYTES];
+    getTimeStamp(timestamp);
+
+    workerPoolMetrics_t workers;
+    getWorkerPoolMetrics(&workers);
+
+    supervisorMetrics_t supervisor;
+    getSupervisorMetrics(&supervisor);
+
+    size_t length = snprintf(jsonBuffer, MONITOR_MESSAGE_SIZE,
+                                "{\"Timestamp\":\"%s\", \"Monitor\":{\"Threads\":[", timestamp);
+
+    // leave room for the worker and supervisor metrics after the threads
+    size_t threadsEnd = MONITOR_MESSAGE_SIZE - 240;
+    for(size_t i=0; i<threadCount && length < threadsEnd; i++) {
+        threadStats_t *stats = &threads[i];
+        int n = snprintf(jsonBuffer + length, threadsEnd - length, "%s[\"%s\",%d,%d,%d]",
+                            i == 0 ? "" : ",", stats->name, (int)stats->stackSize,
+                            (int)stats->stackUsed, stats->cpuPercent);
+        if (n < 0 || length + n >= threadsEnd) {
+            writeWarn("Monitor report is too big, only %d of %d threads published", (int)i, (int)threadCount);
+            break;
+        }
+
+        length += n;
+    }
+
+    snprintf(jsonBuffer + length, MONITOR_MESSAGE_SIZE - length,
+                "], \"Workers\":{\"Run\":%u, \"Rejected\":%u, \"MaxWaiting\":%u, \"Utilisation\":%d}, "
+                "\"Supervisor\":{\"Missed\":%u, \"Restarts\":%u, \"PowerCycles\":%u, \"Resets\":%u, "
+                "\"Recoveries\":%u, \"MeanRecoveryMs\":%d}}}",
+                workers.jobsRun, workers.jobsRejected, workers.maxJobsWaiting, workers.utilisationPercent,
+                supervisor.missedHeartbeats, supervisor.taskRestarts, supervisor.modulePowerCycles,
+                supervisor.systemResets, supervisor.recoveries, supervisor.meanRecoveryMs);
+
+    sendMQTTMessage(taskTopic, jsonBuffer, U_MQTT_QOS_AT_MOST_ONCE, false);
+}
+
+static void reportThreads(void)
+{
+    U_PORT_MUTEX_LOCK(TASK_MUTEX);
+    recordThreads();
+    logThreads();
+    publishThreads();
+    U_PORT_MUTEX_UNLOCK(TASK_MUTEX);
+}
+
+static void queueHandler(void *pParam, size_t paramLengthBytes)
+{
+    monitorMsg_t *qMsg = (monitorMsg_t *) pParam;
+
+    switch(qMsg->msgType) {
+        case REPORT_NOW:
+            reportThreads();
+            break;
+
+        default:
+            writeWarn("Unknown message type: %d", qMsg->msgType);
+            break;
+    }
+}
+
+// Task loop which reports the threads every dwell time
+static void taskLoop(void *pParameters)
+{
+    while(isNotExiting()) {
+        reportThreads();
+        dwellTask(taskConfig, isNotExiting);
+    }
+
+    FINALIZE_TASK;
+}
+
+static int32_t initQueue()
+{
+    return openTaskQueue(taskConfig, queueHandler, sizeof(monitorMsg_t),
+                         MONITOR_QUEUE_STACK_SIZE, MONITOR_TASK_STACK_SIZE,
+                         MONITOR_QUEUE_PRIORITY, MONITOR_QUEUE_SIZE);
+}
+
+static int32_t initMutex()
+{
+    INIT_MUTEX;
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+/// @brief Queue the thread report
+/// @param params The parameters for this command
+/// @return returns the errorCode of sending the message on the eventQueue
+int32_t queueMonitorReport(commandParams_t *params)
+{
+    monitorMsg_t qMsg;
+    qMsg.msgType = REPORT_NOW;
+
+    return sendAppTaskMessage(TASK_ID, &qMsg, sizeof(monitorMsg_t));
+}
+
+/// @brief Initialises the Monitor task
+/// @param config The task configuration structure
+/// @return zero if successful, a negative number otherwise
+int32_t initMonitorTask(taskConfig_t *config)
+{
+    EXIT_IF_CONFIG_NULL;
+
+    taskConfig = config;
+
+    int32_t result = U_ERROR_COMMON_SUCCESS;
+
+    REGISTER_TASK_TOPIC;
+
+    writeLog("Initializing the %s task...", TASK_NAME);
+    EXIT_ON_FAILURE(initMutex);
+    EXIT_ON_FAILURE(initQueue);
+
+    return result;
+}
+
+/// @brief Starts the Monitor task loop
+/// @return zero if successful, a negative number otherwise
+int32_t startMonitorTaskLoop(commandParams_t *params)
+{
+    EXIT_IF_CANT_RUN_TASK;
+
+    if (params != NULL)
+        taskConfig->taskLoopDwellTime = getParamValue(params, 1, 10, 3600, 60);
+
+    START_TASK_LOOP(MONITOR_TASK_STACK_SIZE, MONITOR_TASK_PRIORITY);
+}
+
+int32_t stopMonitorTaskLoop(commandParams_t *params)
+{
+    STOP_TASK;
+}
+
+int32_t finalizeMonitorTask(void)
+{
+    return U_ERROR_COMMON_SUCCESS;
+}
+
+/* ----------------------------------------------------------------
+ * TASK RUNNER
+ * -------------------------------------------------------------- */
+/// @brief Reports the stack high-water mark and CPU share of every thread
+taskRunner_t monitorTaskRunner = {initMonitorTask, startMonitorTaskLoop, stopMonitorTaskLoop, finalizeMonitorTask, false,
+        {MONITOR_TASK, "Monitor", 60, false, BLANK_TASK_HANDLES, NULL},
+        callbacks, NUM_ELEMENTS(callbacks)};
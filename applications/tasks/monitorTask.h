@@ -0,0 +1,52 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ *
+ * Monitor Task header
+ *
+ */
+
+#ifndef _MONITOR_TASK_H_
+#define _MONITOR_TASK_H_
+
+/* ----------------------------------------------------------------
+ * COMMON TASK FUNCTIONS
+ * -------------------------------------------------------------- */
+extern taskRunner_t monitorTaskRunner;
+
+int32_t initMonitorTask(taskConfig_t *config);
+int32_t startMonitorTaskLoop(commandParams_t *params);
+int32_t stopMonitorTaskLoop(commandParams_t *params);
+int32_t finalizeMonitorTask(void);
+
+/* ----------------------------------------------------------------
+ * PUBLIC TASK FUNCTIONS
+ * -------------------------------------------------------------- */
+int32_t queueMonitorReport(commandParams_t *params);
+
+/* ----------------------------------------------------------------
+ * QUEUE MESSAGE TYPE DEFINITIONS
+ * -------------------------------------------------------------- */
+typedef enum {
+    REPORT_NOW,                 // publishes the thread report now
+} monitorMsgType_t;
+
+typedef struct {
+    monitorMsgType_t msgType;
+} monitorMsg_t;
+
+#endif
@@ -20,6 +20,8 @@
  *
  */
 
+#define LOG_MODULE MQTT_TASK
+
 #include "common.h"
 #include "taskControl.h"
 #include "mqttTask.h"
@@ -34,20 +36,19 @@
 #define MQTT_QUEUE_PRIORITY 5
 #define MQTT_QUEUE_SIZE 10
 
-#define STRCOPYTO(x, y)         (failed ? true : ((x = uStrDup(y))==NULL) ? true : false)
-#define MEMCOPYTO(x, y, len)    (failed ? true : ((x = uMemDup(y, len))==NULL) ? true : false)
-
 #define MAX_TOPIC_SIZE 100
-#define MAX_MESSAGE_SIZE (12 * 1024 + 1)    // set this to 12KB as this
-                                            // is the same buffer size
-                                            // in the modules plus 1
-                                            // for the null
-
 #define MAX_TOPIC_CALLBACKS 50
+#define MAX_PUBLISH_TOPICS 16
 
 #define TEMP_TOPIC_NAME_SIZE 150
 
-#define MQTT_TYPE_NAME (mqttSN ? "MQTT-SN Gateway" : "MQTT Broker")
+#define MQTT_TYPE_NAME (mqttConfig.mqttSN ? "MQTT-SN Gateway" : "MQTT Broker")
+
+// number of connection attempts with a new configuration before it fails
+#define MQTT_TRIAL_CONNECT_ATTEMPTS 3
+
+// how long to wait for the network before checking the connection again
+#define MQTT_NETWORK_WAIT_MS 10000
 
 /* ----------------------------------------------------------------
  * COMMON TASK VARIABLES
@@ -65,13 +66,38 @@ typedef struct TOPIC_CALLBACK {
 
     int32_t numCallbacks;
     callbackCommand_t *callbacks;
+    topicRawCallback_t rawCallback;
+
+    /// @brief The task this is the control topic of, which is initialised
+    ///        by its first command, or negative if it isn't a control topic
+    int32_t controlTaskId;
 } topicCallback_t;
 
-typedef struct MQTTSN_TOPIC_NAME_NODE {
-    char *topicName;
-    uMqttSnTopicName_t *snShortName;
-    struct MQTTSN_TOPIC_NAME_NODE *next;
-} mqttSNTopicNameNode_t;
+/// @brief A registered topic to publish to, which is referred to by its handle
+typedef struct {
+    char topicName[MAX_TOPIC_SIZE];
+    uMqttSnTopicName_t snShortName;
+    bool snRegistered;          // registered with the current MQTT-SN gateway
+} publishTopic_t;
+
+/// @brief The MQTT configuration, parsed from the MQTT credentials file
+typedef struct {
+    const char *brokerName;
+    const char *userName;
+    const char *password;
+    const char *clientId;
+    bool mqttSN;
+    int32_t inactivityTimeout;
+    bool keepAlive;
+
+    bool security;
+    int32_t certValidLevel;
+    int32_t tlsVersion;
+    int32_t cipherSuite;
+    const char *clientName;
+    const char *clientKey;
+    const char *serverNameInd;
+} mqttConfig_t;
 
 /* ----------------------------------------------------------------
  * STATIC VARIABLES
@@ -89,15 +115,41 @@ static topicCallback_t *topicCallbackRegister[MAX_TOPIC_CALLBACKS];
 
 static char tempTopicName[TEMP_TOPIC_NAME_SIZE];
 
-static bool mqttSN = false;
-static mqttSNTopicNameNode_t *mqttSNTopicNameList = NULL;
+static mqttConfig_t mqttConfig;
+
+/// the MQTT configuration keys, which are parsed in to mqttConfig
+static const configSchema_t mqttConfigSchema[] = {
+    CONFIG_STRING("MQTT_BROKER_NAME", &mqttConfig.brokerName),
+    CONFIG_STRING("MQTT_USERNAME", &mqttConfig.userName),
+    CONFIG_STRING("MQTT_PASSWORD", &mqttConfig.password),
+    CONFIG_STRING("MQTT_CLIENTID", &mqttConfig.clientId),
+    CONFIG_BOOL("MQTT_TYPE", false, "MQTT-SN", &mqttConfig.mqttSN),
+    CONFIG_INT("MQTT_TIMEOUT", -1, -1, 65535, &mqttConfig.inactivityTimeout),
+    CONFIG_BOOL("MQTT_KEEPALIVE", false, "TRUE", &mqttConfig.keepAlive),
+    CONFIG_BOOL("MQTT_SECURITY", false, "TRUE", &mqttConfig.security),
+    CONFIG_INT("SECURITY_CERT_VALID_LEVEL", 0, 0, 7, &mqttConfig.certValidLevel),
+    CONFIG_INT("SECURITY_TLS_VERSION", 0, 0, 13, &mqttConfig.tlsVersion),
+    CONFIG_INT("SECURITY_CIPHER_SUITE", 0, 0, 0xFFFF, &mqttConfig.cipherSuite),
+    CONFIG_STRING("SECURITY_CLIENT_NAME", &mqttConfig.clientName),
+    CONFIG_STRING("SECURITY_CLIENT_KEY", &mqttConfig.clientKey),
+    CONFIG_STRING("SECURITY_SERVER_NAME_IND", &mqttConfig.serverNameInd)
+};
+
+// The publish topics are only appended to, so a handle stays valid
+static publishTopic_t publishTopics[MAX_PUBLISH_TOPICS];
+static volatile int32_t publishTopicCount = 0;
+static struct k_spinlock publishTopicLock;
 
 static int32_t lastMQTTError = 0;
 
 /// @brief Simple flag to exit any dwelling to connect to the broker
 static bool tryToConnectMQTT = false;
 
-bool gIsMQTTConnected = false;
+/// @brief Reconnection with a new configuration
+static volatile bool reconnectRequested = false;
+static void (*trialFailedCallback)(void) = NULL;
+static int32_t trialConnectAttempts = 0;
+static bool resubscribeTopics = false;
 
 /* ----------------------------------------------------------------
  * STATIC FUNCTION DEFINES
@@ -106,6 +158,12 @@ bool gIsMQTTConnected = false;
 /// @brief Disconnects from the MQTT broker or SN gateway
 static int32_t disconnectBroker(void);
 
+static int32_t openMQTTClient(void);
+static void reopenMQTTClient(void);
+static void checkTrialConnection(bool connected);
+static void resubscribeAllTopics(void);
+static int32_t registerSNTopicName(publishTopic_t *topic);
+
 /* ----------------------------------------------------------------
  * STATIC FUNCTIONS
  * -------------------------------------------------------------- */
@@ -135,15 +193,19 @@ static void mqttSendMessage(sendMQTTMsg_t msg)
 
     int32_t errorCode = U_ERROR_COMMON_NOT_INITIALISED;
 
+    publishTopic_t *topic = &publishTopics[msg.topic];
+
     bool mqttConnected = uMqttClientIsConnected(pContext);
     if (pContext != NULL && mqttConnected && IS_NETWORK_AVAILABLE) {
-        if (mqttSN) {
-            errorCode = uMqttClientSnPublish(pContext, msg.topic.pShortName, msg.pMessage,
+        if (mqttConfig.mqttSN) {
+            errorCode = registerSNTopicName(topic);
+            if (errorCode == 0)
+                errorCode = uMqttClientSnPublish(pContext, &topic->snShortName, msg.pMessage,
                                                     strlen(msg.pMessage),
                                                     msg.QoS,
                                                     msg.retain);
         } else {
-            errorCode = uMqttClientPublish(pContext, msg.topic.pTopicName, msg.pMessage,
+            errorCode = uMqttClientPublish(pContext, topic->topicName, msg.pMessage,
                                                     strlen(msg.pMessage),
                                                     msg.QoS,
                                                     msg.retain);
@@ -155,25 +217,21 @@ static void mqttSendMessage(sendMQTTMsg_t msg)
         } else {
             int32_t errValue = uMqttClientGetLastErrorCode(pContext);
             if (errValue < 0)
-                writeWarn("Failed to publish MQTT message, but can't get error code");
+                writeWarnLimited("Failed to publish MQTT message, but can't get error code");
             else {
                 lastMQTTError = errValue;
-                writeWarn("Failed to publish MQTT message, MQTT Error: %d", lastMQTTError);
+                writeWarnLimited("Failed to publish MQTT message, MQTT Error: %d", lastMQTTError);
                 handlePublishError();
             }
         }
 
     } else {
-        writeWarn("Network or MQTT connection not available, not publishing message");
+        writeWarnLimited("Network or MQTT connection not available, not publishing message");
     }
 
     gAppStatus = mqttConnected ? MQTT_CONNECTED : MQTT_DISCONNECTED;
 
     uPortFree(msg.pMessage);
-    if (mqttSN)
-        uPortFree(msg.topic.pShortName);
-    else
-        uPortFree(msg.topic.pTopicName);
 }
 
 static void queueHandler(void *pParam, size_t paramLengthBytes)
@@ -196,7 +254,8 @@ static void queueHandler(void *pParam, size_t paramLengthBytes)
 static void disconnectCallback(int32_t lastMqttError, void *param)
 {
     gAppStatus = MQTT_DISCONNECTED;
-    gIsMQTTConnected = false;
+    publishEvent(EVENT_MQTT_DISCONNECTED);
+    wakeTask(taskConfig);
 
     // don't bother worrying about the last mqtt error - we're disconnected now!
 }
@@ -205,6 +264,7 @@ static void downlinkMessageCallback(int32_t msgCount, void *param)
 {
     printDebug("Got a downlink MQTT message notification: %d", msgCount);
     messagesToRead = msgCount;
+    wakeTask(taskConfig);
 }
 
 static int32_t connectBroker(void)
@@ -212,16 +272,19 @@ static int32_t connectBroker(void)
     gAppStatus = MQTT_CONNECTING;
     
     uMqttClientConnection_t connection = U_MQTT_CLIENT_CONNECTION_DEFAULT;
-    connection.pBrokerNameStr = getConfig("MQTT_BROKER_NAME");
-    connection.pUserNameStr = getConfig("MQTT_USERNAME");
-    connection.pPasswordStr = getConfig("MQTT_PASSWORD");
-    connection.pClientIdStr = getConfig("MQTT_CLIENTID");
-
-    setBoolParamFromConfig("MQTT_TYPE", "MQTT-SN", &mqttSN);
-    connection.mqttSn = mqttSN;
-
-    setIntParamFromConfig("MQTT_TIMEOUT", &(connection.inactivityTimeoutSeconds));
-    setBoolParamFromConfig("MQTT_KEEPALIVE", "TRUE", &(connection.keepAlive));
+    connection.pBrokerNameStr = mqttConfig.brokerName;
+    connection.pUserNameStr = mqttConfig.userName;
+    connection.pPasswordStr = mqttConfig.password;
+    connection.pClientIdStr = mqttConfig.clientId;
+    connection.mqttSn = mqttConfig.mqttSN;
+    connection.inactivityTimeoutSeconds = mqttConfig.inactivityTimeout;
+    connection.keepAlive = mqttConfig.keepAlive;
+
+    // stop trying to connect as soon as the application is exiting
+    connection.pKeepGoingCallback = isNotExiting;
+
+    if (pContext == NULL && openMQTTClient() < 0)
+        return U_ERROR_COMMON_NOT_INITIALISED;
 
     writeLog("Connecting to %s on %s...", MQTT_TYPE_NAME, connection.pBrokerNameStr);
 
@@ -244,8 +307,8 @@ static int32_t connectBroker(void)
     }
 
     writeLog("Connected to %s", MQTT_TYPE_NAME);
-    gIsMQTTConnected = true;
     gAppStatus = MQTT_CONNECTED;
+    publishEvent(EVENT_MQTT_CONNECTED);
 
     return 0;
 }
@@ -270,7 +333,7 @@ static int32_t disconnectBroker(void)
 /// @return True if we can keep dwelling, false otherwise
 static bool continueToDwell(void)
 {
-    return isNotExiting() && (messagesToRead == 0) && (!tryToConnectMQTT);
+    return isNotExiting() && (messagesToRead == 0) && (!tryToConnectMQTT) && (!reconnectRequested);
 }
 
 static void freeCallbacks(void)
@@ -316,7 +379,7 @@ static int32_t readMessage(void)
     size_t msgSize = MAX_MESSAGE_SIZE;
     uMqttQos_t QoS;
     printDebug("Reading MQTT Message...");
-    if (mqttSN) {
+    if (mqttConfig.mqttSN) {
         uMqttSnTopicName_t snTopicName;
         errorCode = uMqttClientSnMessageRead(pContext, &snTopicName, downlinkMessage, &msgSize, &QoS);
         if (!getTopicNameFromSnTopicId(snTopicName.name.id, topicString)) {
@@ -340,33 +403,37 @@ static int32_t readMessage(void)
 
 static int32_t runCommandCallback(callbackCommand_t *callbacks, int32_t numCallbacks, char *message, size_t msgSize)
 {
-    int32_t errorCode = U_ERROR_COMMON_INVALID_PARAMETER;
-    commandParamsList_t *params = NULL;
-    size_t count = getParams(message, &params);
-    if (count == 0) {
+    commandParams_t params;
+    if (getParams(message, &params) < 0) {
         writeError("No command/param found in message: '%s'", message);
-        goto cleanUp;
-    }
-
-    char *command = params->parameter;
-    if (command == NULL) {
-        writeError("Parsed MQTT command, but no command was set.");
-        goto cleanUp;
+        return U_ERROR_COMMON_INVALID_PARAMETER;
     }
 
+    const char *command = getParamCommand(&params);
     for(int i=0; i<numCallbacks; i++) {
-        if(strncmp(command, callbacks[i].command, msgSize) == 0) {
-            errorCode = callbacks[i].callback(params);
-            goto cleanUp;
+        if(strcmp(command, callbacks[i].command) == 0) {
+            return callbacks[i].callback(&params);
         }
     }
 
     writeWarn("Didn't find command '%s' in callbacks", command);
-    errorCode = U_ERROR_COMMON_NOT_FOUND;
+    return U_ERROR_COMMON_NOT_FOUND;
+}
 
-cleanUp:
-    freeParams(params);
-    return errorCode;
+/// @brief Initialises the task of a control topic, if its command is the
+///        first use of the task
+/// @param topicCallback The topic the command was received on
+/// @return 0 on success, negative on failure
+static int32_t initControlledTask(topicCallback_t *topicCallback)
+{
+    if (topicCallback->controlTaskId < 0)
+        return U_ERROR_COMMON_SUCCESS;
+
+    taskRunner_t *runner = getTaskRunner((taskTypeId_t)topicCallback->controlTaskId);
+    if (runner == NULL || runner->config.initialised)
+        return U_ERROR_COMMON_SUCCESS;
+
+    return initSingleTask(runner->config.id);
 }
 
 /// @brief Find the callback for the topic we have just received, and call it
@@ -376,10 +443,17 @@ static void callbackTopic(size_t msgSize)
     int32_t errorCode = U_ERROR_COMMON_NOT_FOUND;
     for(int i=0; i<topicCallbackCount; i++) {
         if (strcmp(topicCallbackRegister[i]->topicName, topicString) == 0) {
-            errorCode = runCommandCallback(topicCallbackRegister[i]->callbacks,
-                                                topicCallbackRegister[i]->numCallbacks,
-                                                downlinkMessage,
-                                                msgSize);
+            errorCode = initControlledTask(topicCallbackRegister[i]);
+            if (errorCode < 0)
+                break;
+
+            if (topicCallbackRegister[i]->rawCallback != NULL)
+                errorCode = topicCallbackRegister[i]->rawCallback(downlinkMessage, msgSize);
+            else
+                errorCode = runCommandCallback(topicCallbackRegister[i]->callbacks,
+                                                    topicCallbackRegister[i]->numCallbacks,
+                                                    downlinkMessage,
+                                                    msgSize);
         }
     }
 
@@ -416,12 +490,24 @@ static void taskLoop(void *pParameters)
     U_PORT_MUTEX_LOCK(TASK_MUTEX);
     while(isNotExiting())
     {
-        if (!uMqttClientIsConnected(pContext)) {
+        taskHeartbeat(taskConfig);
+
+        if (reconnectRequested) {
+            reconnectRequested = false;
+            reopenMQTTClient();
+        }
+
+        if (pContext == NULL || !uMqttClientIsConnected(pContext)) {
             gAppStatus = MQTT_DISCONNECTED;
-            if (gIsNetworkUp) {
+            if (isEventActive(EVENT_NETWORK_UP)) {
                 writeLog("MQTT client disconnected, trying to connect...");
                 if (connectBroker() != U_ERROR_COMMON_SUCCESS) {
+                    checkTrialConnection(false);
                     uPortTaskBlock(5000);
+                } else {
+                    checkTrialConnection(true);
+                    if (resubscribeTopics)
+                        resubscribeAllTopics();
                 }
 
                 // while trying to connect this flag may have been set
@@ -430,8 +516,8 @@ static void taskLoop(void *pParameters)
                 // before trying to force a connect again.
                 tryToConnectMQTT = false;
             } else {
-                writeDebug("Can't connect to %s, network is still not available...", MQTT_TYPE_NAME);
-                uPortTaskBlock(2000);
+                writeDebug("Can't connect to %s, waiting for the network...", MQTT_TYPE_NAME);
+                waitForEvent(EVENT_NETWORK_UP, MQTT_NETWORK_WAIT_MS);
             }
         } else {
             if (messagesToRead > 0)
@@ -455,20 +541,9 @@ static void taskLoop(void *pParameters)
 
 static int32_t initQueue()
 {
-    int32_t eventQueueHandle = uPortEventQueueOpen(&queueHandler,
-                    TASK_NAME,
-                    sizeof(mqttMsg_t),
-                    MQTT_QUEUE_STACK_SIZE,
-                    MQTT_QUEUE_PRIORITY,
-                    MQTT_QUEUE_SIZE);
-
-    if (eventQueueHandle < 0) {
-        writeFatal("Failed to create MQTT event queue %d.", eventQueueHandle);
-    }
-
-    TASK_QUEUE = eventQueueHandle;
-
-    return eventQueueHandle;
+    return openTaskQueue(taskConfig, queueHandler, sizeof(mqttMsg_t),
+                         MQTT_QUEUE_STACK_SIZE, MQTT_TASK_STACK_SIZE,
+                         MQTT_QUEUE_PRIORITY, MQTT_QUEUE_SIZE);
 }
 
 static int32_t initMutex()
@@ -493,7 +568,7 @@ static int32_t registerTopicCallBack(topicCallback_t *topicCallback)
 
     int32_t errorCode;
 
-    if (mqttSN) {
+    if (mqttConfig.mqttSN) {
         topicCallback->snShortName = (uMqttSnTopicName_t *)malloc(sizeof(uMqttSnTopicName_t));
         if (topicCallback->snShortName == NULL) {
             writeError("registerTopicCallBack(): snShortName memory allocation");
@@ -519,6 +594,37 @@ static int32_t registerTopicCallBack(topicCallback_t *topicCallback)
     return U_ERROR_COMMON_SUCCESS;
 }
 
+/// @brief Subscribes to all the registered topics again, after the MQTT client
+///        has been opened again with a new configuration
+static void resubscribeAllTopics(void)
+{
+    resubscribeTopics = false;
+
+    for(int i=0; i<topicCallbackCount; i++) {
+        topicCallback_t *topicCallback = topicCallbackRegister[i];
+        int32_t errorCode;
+
+        if (mqttConfig.mqttSN) {
+            if (topicCallback->snShortName == NULL)
+                topicCallback->snShortName = (uMqttSnTopicName_t *)pUPortMalloc(sizeof(uMqttSnTopicName_t));
+
+            if (topicCallback->snShortName == NULL)
+                errorCode = U_ERROR_COMMON_NO_MEMORY;
+            else
+                errorCode = uMqttClientSnSubscribeNormalTopic(pContext, topicCallback->topicName,
+                                                                        topicCallback->qos,
+                                                                        topicCallback->snShortName);
+        } else {
+            errorCode = uMqttClientSubscribe(pContext, topicCallback->topicName, topicCallback->qos);
+        }
+
+        if (errorCode < 0)
+            writeError("Failed to subscribe again to topic %s: %d", topicCallback->topicName, errorCode);
+        else
+            writeLog("Subscribed again to callback topic: %s", topicCallback->topicName);
+    }
+}
+
 static void subscribeToTopic(void *pParam)
 {
     topicCallback_t *topicCallback = (topicCallback_t *)pParam;
@@ -532,10 +638,8 @@ static void subscribeToTopic(void *pParam)
     }
 
     // wait until the MQTT Task is up and running...
-    while(!TASK_IS_RUNNING && !gExitApp) {
+    while(!gExitApp && waitForTaskState(TASK_ID, TASK_STATE_RUNNING, 500) < 0)
         printDebug("Waiting for MQTT Task to start...");
-        uPortTaskBlock(500);
-    }
 
     printDebug("Finished waiting for MQTT task to start...");
 
@@ -558,7 +662,9 @@ static void subscribeToTopic(void *pParam)
     }
 
     writeLog("Subscribed to callback topic: %s", topicCallback->topicName);
-    if (topicCallback->numCallbacks > 0) {
+    if (topicCallback->rawCallback != NULL) {
+        printLog("With a message callback");
+    } else if (topicCallback->numCallbacks > 0) {
         printLog("With these commands:");
         for(int i=0; i<topicCallback->numCallbacks; i++)
             printLog("    %d: %s", i+1, topicCallback->callbacks[i].command);
@@ -571,111 +677,109 @@ cleanUp:
     uPortTaskDelete(NULL);
 }
 
-static int32_t registerSNShortName(const char *topicName, uMqttSnTopicName_t **snShortName)
+/// @brief Registers a publish topic with the MQTT-SN gateway for its topic ID,
+///        once for each connection
+static int32_t registerSNTopicName(publishTopic_t *topic)
 {
-    int32_t errorCode = U_ERROR_COMMON_NO_MEMORY;
-
-    // allocate the memory for the sn Topic Name structure
-    *snShortName = (uMqttSnTopicName_t *)malloc(sizeof(uMqttSnTopicName_t));
-    if (*snShortName == NULL) {
-        writeError("registerSNShortName(): snShortName memory allocation");
-        goto cleanUp;
-    }
+    if (topic->snRegistered)
+        return U_ERROR_COMMON_SUCCESS;
 
-    // register the topic name with the MQTT-SN gateway
-    errorCode = uMqttClientSnRegisterNormalTopic(pContext, topicName, *snShortName);
+    int32_t errorCode = uMqttClientSnRegisterNormalTopic(pContext, topic->topicName, &topic->snShortName);
     if (errorCode != 0) {
-        writeError("registerSNShortName(): Register Normal Topic '%s': %d", topicName, errorCode);
-        goto cleanUp;
+        writeError("Failed to register MQTT-SN topic '%s': %d", topic->topicName, errorCode);
+        return errorCode;
     }
 
-    errorCode = U_ERROR_COMMON_SUCCESS;
-
-cleanUp:
-    if (errorCode != 0) {
-        uPortFree(*snShortName);
-        *snShortName = NULL;
-    }
+    topic->snRegistered = true;
 
-    return errorCode;
+    return U_ERROR_COMMON_SUCCESS;
 }
 
-static int32_t getMqttSNTopicName(const char *topicName, uMqttSnTopicName_t **snShortName)
+static void setSecuritySettings(void)
 {
-    mqttSNTopicNameNode_t *currentNode = mqttSNTopicNameList;
-
-    // check if the short name has already been registered?
-    while(currentNode != NULL) {
-        if(strcmp(currentNode->topicName, topicName) == 0) {
-            *snShortName = currentNode->snShortName;
-            return U_ERROR_COMMON_SUCCESS;
-        }
+    tlsSettings.certificateCheck = mqttConfig.certValidLevel;
+    tlsSettings.tlsVersionMin = mqttConfig.tlsVersion;
 
-        currentNode = currentNode->next;
+    if (mqttConfig.cipherSuite == 0) {
+        cipherSuites.num = 0;
+    } else {
+        cipherSuites.num = 1;
+        cipherSuites.suite[0] = mqttConfig.cipherSuite;
     }
+    tlsSettings.cipherSuites = cipherSuites;
 
-    // Create a new topicName/shortName node and register the topic with the MQTT-SN gateway
-    int32_t errorCode = U_ERROR_COMMON_NO_MEMORY;
-    mqttSNTopicNameNode_t *newNode = (mqttSNTopicNameNode_t *)malloc(sizeof(mqttSNTopicNameNode_t));
-    if (newNode == NULL) {
-        writeError("getMqttSNTopicName(): newNode memory allocation");
-        goto cleanUp;
-    }
+    tlsSettings.pClientCertificateName = mqttConfig.clientName;
+    tlsSettings.pClientPrivateKeyName = mqttConfig.clientKey;
+    tlsSettings.pSni = mqttConfig.serverNameInd;
+}
 
-    newNode->topicName = uStrDup(topicName);
-    if (newNode->topicName == NULL) {
-        writeError("getMqttSNTopicName(): topicName memory allocation");
-        goto cleanUp;
+static int32_t openMQTTClient(void)
+{
+    if (mqttConfig.security) {
+        setSecuritySettings();
+        pContext = pUMqttClientOpen(gDeviceHandle, &tlsSettings);
     }
+    else
+        pContext = pUMqttClientOpen(gDeviceHandle, NULL);
 
-    errorCode = registerSNShortName(topicName, snShortName);
-    if (errorCode < 0)
-        goto cleanUp;
+    return pContext == NULL ? U_ERROR_COMMON_NOT_RESPONDING : U_ERROR_COMMON_SUCCESS;
+}
 
-    // add it to the linked list
-    newNode->snShortName = *snShortName;
-    newNode->next = mqttSNTopicNameList;
-    mqttSNTopicNameList = newNode;
+static void clearSNTopicNames(void)
+{
+    for(int32_t i=0; i<publishTopicCount; i++)
+        publishTopics[i].snRegistered = false;
+}
 
-    errorCode = U_ERROR_COMMON_SUCCESS;
+/// @brief Closes and opens the MQTT client again so that the connection and
+///        security settings of a new configuration are used.
+static void reopenMQTTClient(void)
+{
+    writeLog("Reconnecting to the %s with the new configuration...", MQTT_TYPE_NAME);
 
-cleanUp:
-    if (errorCode != 0) {
-        uPortFree(newNode->topicName);
-        uPortFree(newNode);
+    if (pContext != NULL) {
+        if (uMqttClientIsConnected(pContext))
+            disconnectBroker();
+
+        publishEvent(EVENT_MQTT_DISCONNECTED);
+        uMqttClientClose(pContext);
+        pContext = NULL;
     }
 
-    return errorCode;
+    // the topic IDs from an MQTT-SN gateway are not valid with the new connection
+    clearSNTopicNames();
+
+    uSecurityTlsSettings_t defaultTlsSettings = U_SECURITY_TLS_SETTINGS_DEFAULT;
+    tlsSettings = defaultTlsSettings;
+
+    if (openMQTTClient() < 0)
+        writeError("Failed to open the MQTT client with the new configuration");
+
+    resubscribeTopics = topicCallbackCount > 0;
 }
 
-static void setSecuritySettings(void)
+/// @brief Checks the connection result of a trial reconnection, calling the
+///        trial failed callback if it has not connected after a few attempts
+static void checkTrialConnection(bool connected)
 {
-    int32_t cert_value_level;
-    setIntParamFromConfig("SECURITY_CERT_VALID_LEVEL", &cert_value_level);
-    tlsSettings.certificateCheck = cert_value_level;
-
-    int32_t tls_version;
-    setIntParamFromConfig("SECURITY_TLS_VERSION", &tls_version);
-    tlsSettings.tlsVersionMin = tls_version;
+    if (trialFailedCallback == NULL)
+        return;
 
-    int32_t cipher;
-    setIntParamFromConfig("SECURITY_CIPHER_SUITE", &cipher);
-    if (cipher == 0) {
-        cipherSuites.num = 0;
-    } else {
-        cipherSuites.num = 1;
-        cipherSuites.suite[0] = cipher;
+    if (connected) {
+        writeLog("Connected to the %s with the new configuration", MQTT_TYPE_NAME);
+        trialFailedCallback = NULL;
+        return;
     }
-    tlsSettings.cipherSuites = cipherSuites;
-    
-    const char *client_name = getConfig("SECURITY_CLIENT_NAME");
-    tlsSettings.pClientCertificateName = client_name;
 
-    const char *client_key = getConfig("SECURITY_CLIENT_KEY");
-    tlsSettings.pClientPrivateKeyName = client_key;
-    
-    const char *server_name_ind = getConfig("SECURITY_SERVER_NAME_IND");
-    tlsSettings.pSni = server_name_ind;
+    trialConnectAttempts--;
+    if (trialConnectAttempts > 0)
+        return;
+
+    writeWarn("Failed to connect with the new configuration after %d attempts", MQTT_TRIAL_CONNECT_ATTEMPTS);
+
+    void (*callback)(void) = trialFailedCallback;
+    trialFailedCallback = NULL;
+    callback();
 }
 
 static int32_t initMQTTClient(void)
@@ -689,18 +793,9 @@ static int32_t initMQTTClient(void)
         goto cleanUp;
     }
 
-    bool security = false;
-    setBoolParamFromConfig("MQTT_SECURITY", "TRUE", &security);
-    if (security) {
-        setSecuritySettings();
-        pContext = pUMqttClientOpen(gDeviceHandle, &tlsSettings);
-    }
-    else
-        pContext = pUMqttClientOpen(gDeviceHandle, NULL);
-    
-    if (pContext == NULL) {
+    errorCode = openMQTTClient();
+    if (errorCode < 0) {
         writeFatal("Failed to open the MQTT client");
-        errorCode = U_ERROR_COMMON_NOT_RESPONDING;
         goto cleanUp;
     }
 
@@ -713,15 +808,9 @@ cleanUp:
     return errorCode;
 }
 
-/* ----------------------------------------------------------------
- * PUBLIC FUNCTIONS
- * -------------------------------------------------------------- */
-
-/// @brief Subscribes a callback function to a topic, waiting for the MQTT task to be online first
-/// @param taskTopicName The topic name to subscribe to. Appends the serial number
-/// @param qos The Quality of Service to use for the subscription
-/// @param callbacks The callbacks this topic is going to be used for
-int32_t subscribeToTopicAsync(const char *taskTopicName, uMqttQos_t qos, callbackCommand_t *callbacks, int32_t numCallbacks)
+static int32_t subscribeTopicAsync(const char *taskTopicName, uMqttQos_t qos, callbackCommand_t *callbacks,
+                                        int32_t numCallbacks, topicRawCallback_t rawCallback,
+                                        int32_t controlTaskId)
 {
     int32_t errorCode = U_ERROR_COMMON_SUCCESS;
     uPortTaskHandle_t handle;
@@ -747,6 +836,9 @@ int32_t subscribeToTopicAsync(const char *taskTopicName, uMqttQos_t qos, callbac
     topicCallbackInfo->qos = qos;
     topicCallbackInfo->numCallbacks = numCallbacks;
     topicCallbackInfo->callbacks = callbacks;
+    topicCallbackInfo->rawCallback = rawCallback;
+    topicCallbackInfo->snShortName = NULL;
+    topicCallbackInfo->controlTaskId = controlTaskId;
 
     errorCode = uPortTaskCreate(subscribeToTopic, NULL, 2048, (void *)topicCallbackInfo, 5, &handle);
     if (errorCode != 0) {
@@ -766,84 +858,154 @@ cleanUp:
     return errorCode;
 }
 
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+/// @brief Subscribes a callback function to a topic, waiting for the MQTT task to be online first
+/// @param taskTopicName The topic name to subscribe to. Appends the serial number
+/// @param qos The Quality of Service to use for the subscription
+/// @param callbacks The callbacks this topic is going to be used for
+int32_t subscribeToTopicAsync(const char *taskTopicName, uMqttQos_t qos, callbackCommand_t *callbacks, int32_t numCallbacks)
+{
+    return subscribeTopicAsync(taskTopicName, qos, callbacks, numCallbacks, NULL, -1);
+}
+
+/// @brief Subscribes a callback function to a topic, which is given the whole message
+///        instead of the message being parsed as a command and parameters.
+/// @param taskTopicName The topic name to subscribe to. Appends the serial number
+/// @param qos The Quality of Service to use for the subscription
+/// @param callback The callback for the messages on this topic
+int32_t subscribeToTopicRawAsync(const char *taskTopicName, uMqttQos_t qos, topicRawCallback_t callback)
+{
+    return subscribeTopicAsync(taskTopicName, qos, NULL, 0, callback, -1);
+}
+
+/// @brief Subscribes a task's "<name>Control" topic to its commands. This is
+///        done when the task is registered, so the task is initialised by
+///        its first command if it hasn't been used yet.
+/// @param runner The task runner of the task, with its control commands
+/// @return 0 on success, negative on failure
+int32_t subscribeToTaskControlAsync(taskRunner_t *runner)
+{
+    char taskTopicName[MAX_TOPIC_NAME_SIZE];
+    snprintf(taskTopicName, MAX_TOPIC_NAME_SIZE, "%sControl", runner->config.name);
+
+    return subscribeTopicAsync(taskTopicName, U_MQTT_QOS_AT_MOST_ONCE, runner->controlCommands,
+                                runner->numControlCommands, NULL, runner->config.id);
+}
+
+/// @brief Reconnects to the MQTT broker or MQTT-SN gateway using the current
+///        configuration. The reconnection is done by the MQTT task.
+/// @param callback If not NULL the reconnection is a trial, and this is called
+///        from the MQTT task if it can't connect after a few attempts
+/// @return 0 on success, negative on failure
+int32_t reconnectMQTTClient(void (*callback)(void))
+{
+    if (!TASK_INITIALISED)
+        return U_ERROR_COMMON_NOT_INITIALISED;
+
+    trialFailedCallback = callback;
+    trialConnectAttempts = MQTT_TRIAL_CONNECT_ATTEMPTS;
+    reconnectRequested = true;
+    wakeTask(taskConfig);
+
+    return U_ERROR_COMMON_SUCCESS;
+}
+
+/// @brief Registers a topic to publish to, "<IMEI>/<taskTopicName>". The
+///        topic name is built once and publishes refer to it by its handle.
+///        Registering the same topic again returns the same handle.
+/// @param taskTopicName The topic name after the IMEI, usually the task name
+/// @return The topic handle, or negative on failure
+mqttTopicHandle_t registerPublishTopic(const char *taskTopicName)
+{
+    char topicName[MAX_TOPIC_SIZE];
+    int32_t length = snprintf(topicName, MAX_TOPIC_SIZE, "%s/%s", (const char *)gSerialNumber, taskTopicName);
+    if (length < 0 || length >= MAX_TOPIC_SIZE) {
+        writeError("Topic name for '%s' is longer than %d characters", taskTopicName, MAX_TOPIC_SIZE - 1);
+        return U_ERROR_COMMON_INVALID_PARAMETER;
+    }
+
+    mqttTopicHandle_t handle = U_ERROR_COMMON_NO_MEMORY;
+    k_spinlock_key_t key = k_spin_lock(&publishTopicLock);
+
+    for(int32_t i=0; i<publishTopicCount; i++) {
+        if (strcmp(publishTopics[i].topicName, topicName) == 0) {
+            handle = i;
+            break;
+        }
+    }
+
+    if (handle < 0 && publishTopicCount < MAX_PUBLISH_TOPICS) {
+        handle = publishTopicCount;
+        memcpy(publishTopics[handle].topicName, topicName, length + 1);
+        publishTopics[handle].snRegistered = false;
+        publishTopicCount++;
+    }
+
+    k_spin_unlock(&publishTopicLock, key);
+
+    if (handle < 0)
+        writeError("Failed to register topic '%s', maximum is %d topics", topicName, MAX_PUBLISH_TOPICS);
+
+    return handle;
+}
+
 /// @brief Puts a message on to the MQTT publish queue
-/// @param pTopicName a pointer to the topic name which is copied
+/// @param topic The handle of the topic from registerPublishTopic()
 /// @param pMessage a pointer to the message text which is copied
 /// @param QoS the Quality of Service value for this message
 /// @param retain If the message should be retained
 /// @return 0 if successfully queued on the event queue
-int32_t sendMQTTMessage(const char *pTopicName, const char *pMessage, uMqttQos_t QoS, bool retain)
+int32_t sendMQTTMessage(mqttTopicHandle_t topic, const char *pMessage, uMqttQos_t QoS, bool retain)
 {
-    // if the event queue handle is not valid, don't send the message
-    if (TASK_QUEUE < 0) {
+    if (topic < 0 || topic >= publishTopicCount) {
+        writeWarn("Not publishing MQTT message, invalid topic handle: %d", topic);
+        return U_ERROR_COMMON_INVALID_PARAMETER;
+    }
+
+    // if the task's queue hasn't been opened, don't send the message
+    if (!TASK_INITIALISED) {
         writeWarn("Not publishing MQTT message, MQTT Event Queue handle is not valid");
         return U_ERROR_COMMON_NOT_INITIALISED;
     }
 
     if (!TASK_IS_RUNNING) {
-        writeWarn("Not publishing MQTT message, MQTT Task not running yet");
+        writeWarnLimited("Not publishing MQTT message, MQTT Task not running yet");
         return U_ERROR_COMMON_NOT_INITIALISED;
     }
 
     if (!IS_NETWORK_AVAILABLE) {
-        writeWarn("Not publishing MQTT message, Network is not available at the moment");
+        writeWarnLimited("Not publishing MQTT message, Network is not available at the moment");
         return U_ERROR_COMMON_TEMPORARY_FAILURE;
     }
 
     if (pContext == NULL || !uMqttClientIsConnected(pContext)) {
-        writeWarn("Not publishing MQTT message, not connected to %s", MQTT_TYPE_NAME);
+        writeWarnLimited("Not publishing MQTT message, not connected to %s", MQTT_TYPE_NAME);
         tryToConnectMQTT = true;
+        wakeTask(taskConfig);
         return U_ERROR_COMMON_NOT_INITIALISED;
     }
 
     if (!isNotExiting()) return U_ERROR_COMMON_BUSY;
 
-    int32_t errorCode = U_ERROR_COMMON_SUCCESS;
-
     mqttMsg_t qMsg;
     qMsg.msgType = SEND_MQTT_MESSAGE;
-
-    bool failed = false;
-    failed = STRCOPYTO(qMsg.msg.message.pMessage, pMessage);
-    if (!failed && mqttSN) {
-        uMqttSnTopicName_t *snShortName;
-        if (getMqttSNTopicName(pTopicName, &snShortName) < 0) {
-            writeError("Not publishing MQTT-SN message, failed to get/register MQTT-SN Topic Name.");
-            goto cleanUp;
-        }
-
-        failed = MEMCOPYTO(qMsg.msg.message.topic.pShortName, snShortName, sizeof(uMqttSnTopicName_t));
-    } else {
-        failed = STRCOPYTO(qMsg.msg.message.topic.pTopicName, pTopicName);
-    }
-
-    if (failed) {
-        errorCode = U_ERROR_COMMON_NO_MEMORY;
-        writeLog("Not publishing MQTT message, failed to allocate memory for message.");
-        goto cleanUp;
-    }
-
+    qMsg.msg.message.topic = topic;
     qMsg.msg.message.QoS = QoS;
     qMsg.msg.message.retain = retain;
 
-    errorCode = uPortEventQueueSendIrq(TASK_QUEUE, &qMsg, sizeof(mqttMsg_t));
-    if (errorCode != 0) {
-        writeLog("Not publishing MQTT message, Event Queue Full");
-        goto cleanUp;
+    qMsg.msg.message.pMessage = uStrDup(pMessage);
+    if (qMsg.msg.message.pMessage == NULL) {
+        writeLog("Not publishing MQTT message, failed to allocate memory for message.");
+        return U_ERROR_COMMON_NO_MEMORY;
     }
 
-cleanUp:
+    int32_t errorCode = sendAppTaskMessage(TASK_ID, &qMsg, sizeof(mqttMsg_t));
     if (errorCode != 0) {
-        if (mqttSN) {
-            uPortFree(qMsg.msg.message.topic.pShortName);
-            qMsg.msg.message.topic.pShortName = NULL;
-        } else {
-            uPortFree(qMsg.msg.message.topic.pTopicName);
-            qMsg.msg.message.topic.pTopicName = NULL;
-        }
-
+        writeWarnLimited("Not publishing MQTT message, Event Queue Full");
         uPortFree(qMsg.msg.message.pMessage);
-        qMsg.msg.message.pMessage = NULL;
     }
 
     return errorCode;
@@ -863,6 +1025,11 @@ int32_t initMQTTTask(taskConfig_t *config)
     writeLog("Initializing the %s task...", TASK_NAME);
     EXIT_ON_FAILURE(initMutex);
     EXIT_ON_FAILURE(initQueue);
+
+    result = registerConfigSchema(mqttConfigSchema, NUM_ELEMENTS(mqttConfigSchema));
+    if (result < 0)
+        return result;
+
     EXIT_ON_FAILURE(initMQTTClient);
 
     return result;
@@ -870,26 +1037,14 @@ int32_t initMQTTTask(taskConfig_t *config)
 
 /// @brief Starts the Signal Quality task loop
 /// @return zero if successful, a negative number otherwise
-int32_t startMQTTTaskLoop(commandParamsList_t *params)
+int32_t startMQTTTaskLoop(commandParams_t *params)
 {
     EXIT_IF_CANT_RUN_TASK;
 
-    int32_t errorCode = U_ERROR_COMMON_SUCCESS;
-
-    errorCode = uPortTaskCreate(runTaskAndDelete,
-                                TASK_NAME,
-                                MQTT_TASK_STACK_SIZE,
-                                taskLoop,
-                                MQTT_TASK_PRIORITY,
-                                &TASK_HANDLE);
-    if (errorCode != 0) {
-        writeError("Failed to start the %s Task (%d).", TASK_NAME, errorCode);
-    }
-
-    return errorCode;
+    START_TASK_LOOP(MQTT_TASK_STACK_SIZE, MQTT_TASK_PRIORITY);
 }
 
-int32_t stopMQTTTaskLoop(commandParamsList_t *params)
+int32_t stopMQTTTaskLoop(commandParams_t *params)
 {
     STOP_TASK;
 }
@@ -897,4 +1052,11 @@ int32_t stopMQTTTaskLoop(commandParamsList_t *params)
 int32_t finalizeMQTTTask(void)
 {
     return U_ERROR_COMMON_SUCCESS;
-}
\ No newline at end of file
+}
+
+/* ----------------------------------------------------------------
+ * TASK RUNNER
+ * -------------------------------------------------------------- */
+/// @brief Handles the MQTT broker connection, publishing messages and handling downlink messages
+taskRunner_t mqttTaskRunner = {initMQTTTask, startMQTTTaskLoop, stopMQTTTaskLoop, finalizeMQTTTask, false,
+        {MQTT_TASK, "MQTT", 30, false, BLANK_TASK_HANDLES, NULL}};
\ No newline at end of file
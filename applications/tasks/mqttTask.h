@@ -22,22 +22,55 @@
 #ifndef _MQTT_TASK_H_
 #define _MQTT_TASK_H_
 
+/* ----------------------------------------------------------------
+ * DEFINES
+ * -------------------------------------------------------------- */
+#define MAX_MESSAGE_SIZE (12 * 1024 + 1)    // set this to 12KB as this
+                                            // is the same buffer size
+                                            // in the modules plus 1
+                                            // for the null
+
+/// @brief Handle of a topic to publish to, from registerPublishTopic()
+typedef int32_t mqttTopicHandle_t;
+
+/// @brief Callback for a topic which is given the whole message, instead of
+///        the message being parsed as a command and parameters
+typedef int32_t (*topicRawCallback_t)(const char *pMessage, size_t msgSize);
+
 /* ----------------------------------------------------------------
  * COMMON TASK FUNCTIONS
  * -------------------------------------------------------------- */
+extern taskRunner_t mqttTaskRunner;
+
 int32_t initMQTTTask(taskConfig_t *config);
-int32_t startMQTTTaskLoop(commandParamsList_t *params);
-int32_t stopMQTTTaskLoop(commandParamsList_t *params);
+int32_t startMQTTTaskLoop(commandParams_t *params);
+int32_t stopMQTTTaskLoop(commandParams_t *params);
 int32_t finalizeMQTTTask(void);
 
 /* ----------------------------------------------------------------
  * TASK FUNCTIONS
  * -------------------------------------------------------------- */
-int32_t sendMQTTMessage(const char *pTopicName, const char *pMessage, uMqttQos_t QoS, bool retain);
+// register a topic to publish to, "<IMEI>/<taskTopicName>", for its handle
+mqttTopicHandle_t registerPublishTopic(const char *taskTopicName);
+
+int32_t sendMQTTMessage(mqttTopicHandle_t topic, const char *pMessage, uMqttQos_t QoS, bool retain);
 
 // subscribe a callback function to a topic
 int32_t subscribeToTopicAsync(const char *taskTopicName, uMqttQos_t qos, callbackCommand_t *callbacks, int32_t numCallbacks);
 
+// subscribe a callback function to a topic, which is given the whole message
+int32_t subscribeToTopicRawAsync(const char *taskTopicName, uMqttQos_t qos, topicRawCallback_t callback);
+
+// subscribe a task's "<name>Control" topic to its control commands
+int32_t subscribeToTaskControlAsync(taskRunner_t *runner);
+
+/// @brief Reconnects to the MQTT broker or MQTT-SN gateway using the current
+///        configuration, which is used after the configuration has changed.
+/// @param trialFailedCallback If not NULL the reconnection is a trial, and this
+///        is called from the MQTT task if it can't connect after a few attempts
+/// @return 0 on success, negative on failure
+int32_t reconnectMQTTClient(void (*trialFailedCallback)(void));
+
 /* ----------------------------------------------------------------
  * QUEUE MESSAGE TYPE DEFINITIONS
  * -------------------------------------------------------------- */
@@ -45,12 +78,10 @@ typedef enum {
     SEND_MQTT_MESSAGE,          // Sends a MQTT message
 } mqttMsgType_t;
 
-/// @brief MQTT message to send. Handles both MQTT and MQTT-SN topic name types
+/// @brief MQTT message to send. The topic handle is mapped to the topic
+///        name, or the MQTT-SN topic ID, by the MQTT task
 typedef struct SEND_MQTT_MESSAGE {
-    union {
-        char *pTopicName;
-        uMqttSnTopicName_t *pShortName;
-    } topic;
+    mqttTopicHandle_t topic;
 
     char *pMessage;
     uMqttQos_t QoS;
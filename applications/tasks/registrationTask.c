@@ -20,9 +20,12 @@
  *
 */
 
+#define LOG_MODULE NETWORK_REG_TASK
+
 #include "common.h"
 #include "taskControl.h"
 #include "config.h"
+#include "leds.h"
 #include "registrationTask.h"
 #include "NTPClient.h"
 
@@ -31,6 +34,9 @@
  * -------------------------------------------------------------- */
 #define BEGINNING_2023 1672531200
 
+// how often the time is requested again once the network is up
+#define TIME_SYNC_INTERVAL_MS (6LL * 60 * 60 * 1000)
+
 #define REG_TASK_STACK_SIZE 1024
 #define REG_TASK_PRIORITY 5
 
@@ -52,7 +58,15 @@ static bool keepGoing(void *pParam);
 /* ----------------------------------------------------------------
  * STATIC VARIABLES
  * -------------------------------------------------------------- */
-static const uNetworkCfgCell_t gNetworkCfg = {
+static const char *apn = APN;
+
+/// the APN configuration key, which defaults to the config.h APN
+static const configSchema_t registrationConfigSchema[] = {
+    CONFIG_STRING_DEFAULT("APN", APN, &apn)
+};
+
+// the APN is set from the configuration each time the network is brought up
+static uNetworkCfgCell_t gNetworkCfg = {
     .type = U_NETWORK_TYPE_CELL,
     .pApn = APN,
     .pKeepGoingCallback = keepGoing,
@@ -67,6 +81,9 @@ static const uNetworkType_t gNetworkType = U_NETWORK_TYPE_CELL;
 // the UBXLIB uNetworkInterfaceUp() function
 static volatile int32_t networkUpCounter = 0;
 
+// The monotonic time the network or NTP time was last requested
+static int64_t lastTimeSyncMs = 0;
+
 // This is the list of 'internet restricted' APNs. Normal internet
 // communication on these APNs is not exercised, like requesting
 // the date/time from a NTP service.
@@ -78,13 +95,6 @@ static const char *restrictredAPNs[] = {
 /* ----------------------------------------------------------------
  * PUBLIC VARIABLES
  * -------------------------------------------------------------- */
-
-// This flag represents the network's registration is either HOME or ROAMING (connected!)
-bool gIsNetworkUp = false;
-
-/// The unix network time, which is retrieved after first registration
-extern int64_t unixNetworkTime;
-
 char pOperatorName[OPERATOR_NAME_SIZE] = "Unknown";
 int32_t operatorMcc = 0;
 int32_t operatorMnc = 0;
@@ -103,7 +113,7 @@ static void clearOperatorInfo(void)
 /// @brief check if the application is exiting, or task stopping
 static bool isNotExiting(void)
 {
-    if (!gIsNetworkUp) {
+    if (!isEventActive(EVENT_NETWORK_UP)) {
         clearOperatorInfo();
     }
 
@@ -118,6 +128,9 @@ static bool keepGoing(void *pParam)
         return false;
     }
 
+    // ubxlib is still calling back while registering, so it hasn't hung
+    taskHeartbeat(taskConfig);
+
     bool keepGoing = isNotExiting();
     if (keepGoing) {
         gAppStatus = REGISTRATION_UNKNOWN;
@@ -156,11 +169,11 @@ static void networkStatusCallback(uDeviceHandle_t devHandle,
         return;
 
     // count the number of times the network 'goes up'
-    if (!gIsNetworkUp && isUp) {
+    if (!isEventActive(EVENT_NETWORK_UP) && isUp) {
         networkUpCounter++;
     }
 
-    gIsNetworkUp = isUp;
+    publishEvent(isUp ? EVENT_NETWORK_UP : EVENT_NETWORK_DOWN);
 
     uCellNetStatus_t cellStatus = (uCellNetStatus_t) pStatus->cell.status;
     if (isUp) {
@@ -183,7 +196,7 @@ static void networkStatusCallback(uDeviceHandle_t devHandle,
 static bool usingRestrictedAPN(void)
 {
     for(int i=0; i<NUM_ELEMENTS(restrictredAPNs); i++) {
-        if (strncmp(APN, restrictredAPNs[i], strlen(APN)) == 0)
+        if (apn != NULL && strcmp(apn, restrictredAPNs[i]) == 0)
             return true;
     }
 
@@ -192,7 +205,10 @@ static bool usingRestrictedAPN(void)
 
 static void getNetworkOrNTPTime(void)
 {
+    lastTimeSyncMs = getMonotonicTimeMs();
+
     // try and get the network time from the cellular network
+    timeSource_t source = TIME_SOURCE_CELLULAR;
     int64_t time = uCellInfoGetTimeUtc(gDeviceHandle);
 
     // if the network time is less than 2023, assume it is wrong
@@ -203,16 +219,14 @@ static void getNetworkOrNTPTime(void)
             return;
         } else {
             printInfo("Requesting time from NTP Server...");
+            source = TIME_SOURCE_NTP;
             time = getNTPTime();
         }
     }
 
     // if time is positive, it should now be a valid time
-    if (time > 0) {
-        // remove the current local tick time from this
-        // to obtain a rough "boot" time value.
-        unixNetworkTime = time - (uPortGetTickTimeMs() / 1000);
-    }
+    if (time > 0)
+        setUnixTime(time * 1000, source);
 }
 
 static int32_t startNetworkRegistration(void)
@@ -224,6 +238,7 @@ static int32_t startNetworkRegistration(void)
 
     gAppStatus = REGISTERING;
     writeLog("Bringing up the cellular network...");
+    gNetworkCfg.pApn = apn;
     int32_t errorCode = uNetworkInterfaceUp(gDeviceHandle, gNetworkType, &gNetworkCfg);
     if (gExitApp) return U_ERROR_COMMON_SUCCESS;
 
@@ -238,9 +253,9 @@ static int32_t startNetworkRegistration(void)
         return errorCode;
     }
 
-    gIsNetworkUp = true;
     gAppStatus = REGISTERED;
     networkUpCounter=1;
+    publishEvent(EVENT_NETWORK_UP);
 
     getNetworkInfo();
     writeLog("Connected to Cellular Network: %s (%03d%02d)", pOperatorName, operatorMcc, operatorMnc);
@@ -259,7 +274,7 @@ static int32_t deRegisterFromNetwork(void)
         writeWarn("Failed to de-register from the cellular network: %d", errorCode);
     } else {
         writeLog("Deregistered from cellular network");
-        gIsNetworkUp = false;
+        publishEvent(EVENT_NETWORK_DOWN);
     }
 
     return errorCode;
@@ -279,6 +294,8 @@ static void taskLoop(void *pParameters)
     // as other tasks may need to close their cloud connections and when
     // this task finishes the device disconnects from the network.
     while(!exitTask) {
+        taskHeartbeat(taskConfig);
+
         // if the application is exiting, we don't need to try and
         // manage the network connection... just wait here until we are TOLD to exit
         if (!gExitApp) {
@@ -290,8 +307,12 @@ static void taskLoop(void *pParameters)
             }
 
             // logging tick about the network reg status
-            if (gIsNetworkUp) {
+            if (isEventActive(EVENT_NETWORK_UP)) {
                 writeDebug("Network is up and running");
+
+                // re-anchor the time, as the monotonic clock drifts
+                if (getMonotonicTimeMs() - lastTimeSyncMs > TIME_SYNC_INTERVAL_MS)
+                    getNetworkOrNTPTime();
             } else {
                 gAppStatus = REGISTRATION_UNKNOWN;
                 writeLog("Network connection is down...");
@@ -303,6 +324,7 @@ static void taskLoop(void *pParameters)
 
         // Just spin the task blocking here.
         // No need to use the dwellTask()
+        handleTaskMessages(taskConfig);
         uPortTaskBlock(50);
     }
 
@@ -316,20 +338,9 @@ static void taskLoop(void *pParameters)
 
 static int32_t initQueue()
 {
-    int32_t eventQueueHandle = uPortEventQueueOpen(&queueHandler,
-                    TASK_NAME,
-                    sizeof(registrationMsg_t),
-                    REG_QUEUE_STACK_SIZE,
-                    REG_QUEUE_PRIORITY,
-                    REG_QUEUE_SIZE);
-
-    if (eventQueueHandle < 0) {
-        writeFatal("Failed to create %s event queue %d", TASK_NAME, eventQueueHandle);
-    }
-
-    TASK_QUEUE = eventQueueHandle;
-
-    return eventQueueHandle;
+    return openTaskQueue(taskConfig, queueHandler, sizeof(registrationMsg_t),
+                         REG_QUEUE_STACK_SIZE, REG_TASK_STACK_SIZE,
+                         REG_QUEUE_PRIORITY, REG_QUEUE_SIZE);
 }
 
 
@@ -357,23 +368,49 @@ int32_t initNetworkRegistrationTask(taskConfig_t *config)
     EXIT_ON_FAILURE(initMutex);
     EXIT_ON_FAILURE(initQueue);
 
+    result = registerConfigSchema(registrationConfigSchema, NUM_ELEMENTS(registrationConfigSchema));
+
     return result;
 }
 
 /// @brief Starts the Signal Quality task loop
 /// @return zero if successful, a negative number otherwise
-int32_t startNetworkRegistrationTaskLoop(commandParamsList_t *params)
+int32_t startNetworkRegistrationTaskLoop(commandParams_t *params)
 {
     EXIT_IF_CANT_RUN_TASK;
     START_TASK_LOOP(REG_TASK_STACK_SIZE, REG_TASK_PRIORITY);
 }
 
-int32_t stopNetworkRegistrationTaskLoop(commandParamsList_t *params)
+int32_t stopNetworkRegistrationTaskLoop(commandParams_t *params)
 {
     STOP_TASK;
 }
 
+/// @brief Registers on the network again, such as after the cellular
+///        module has been power cycled
+void restartNetworkRegistration(void)
+{
+    networkUpCounter = 0;
+    clearOperatorInfo();
+    publishEvent(EVENT_NETWORK_DOWN);
+
+    if (taskConfig != NULL)
+        wakeTask(taskConfig);
+}
+
 int32_t finalizeNetworkRegistrationTask(void)
 {
     return U_ERROR_COMMON_SUCCESS;
-}
\ No newline at end of file
+}
+
+/* ----------------------------------------------------------------
+ * TASK RUNNER
+ * -------------------------------------------------------------- */
+static void setRedLED(void *param)
+{
+    SET_RED_LED;
+}
+
+/// @brief Looks after the cellular registration process
+taskRunner_t networkRegistrationTaskRunner = {initNetworkRegistrationTask, startNetworkRegistrationTaskLoop, stopNetworkRegistrationTaskLoop, finalizeNetworkRegistrationTask, true,
+        {NETWORK_REG_TASK, "Registration", 30, false, BLANK_TASK_HANDLES, setRedLED}};
\ No newline at end of file
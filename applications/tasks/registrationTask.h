@@ -25,18 +25,25 @@
 /* ----------------------------------------------------------------
  * COMMON TASK FUNCTIONS
  * -------------------------------------------------------------- */
+extern taskRunner_t networkRegistrationTaskRunner;
+
 int32_t initNetworkRegistrationTask(taskConfig_t *config);
 
 // Start the registration process and keep a track on the status
-int32_t startNetworkRegistrationTaskLoop(commandParamsList_t *params);
+int32_t startNetworkRegistrationTaskLoop(commandParams_t *params);
 
 // Stop the tracking of the registration process and disconnect from
 // the network. Warning - other communications tasks will not be able
 // to send their messages if the registration task is stopped.
-int32_t stopNetworkRegistrationTaskLoop(commandParamsList_t *params);
+int32_t stopNetworkRegistrationTaskLoop(commandParams_t *params);
 
 int32_t finalizeNetworkRegistrationTask(void);
 
+/* ----------------------------------------------------------------
+ * PUBLIC TASK FUNCTIONS
+ * -------------------------------------------------------------- */
+void restartNetworkRegistration(void);
+
 /* ----------------------------------------------------------------
  * QUEUE MESSAGE TYPE DEFINITIONS
  * -------------------------------------------------------------- */
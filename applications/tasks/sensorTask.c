@@ -21,6 +21,8 @@
  *
  */
 
+#define LOG_MODULE SENSOR_TASK
+
 #include "common.h"
 #include "taskControl.h"
 #include "sensorTask.h"
@@ -52,7 +54,7 @@ static taskConfig_t *taskConfig = NULL;
 /* ----------------------------------------------------------------
  * STATIC VARIABLES
  * -------------------------------------------------------------- */
-static char topicName[MAX_TOPIC_NAME_SIZE];
+static mqttTopicHandle_t taskTopic = U_ERROR_COMMON_NOT_INITIALISED;
 
 static char buffer[MQTT_MESSAGE_MAX_SIZE];
 
@@ -78,13 +80,13 @@ static void publishAccel(void)
     float x,y,z;
     getAccelerometer(&x, &y, &z);
     snprintf(buffer, MQTT_MESSAGE_MAX_SIZE, "{\"Accellerometer\": {\"X\":\"%.2f\", \"Y\":\"%.2f\", \"Z\":\"%.2f\"}}", x, y, z);
-    sendMQTTMessage(topicName, buffer, U_MQTT_QOS_AT_MOST_ONCE, false);
+    sendMQTTMessage(taskTopic, buffer, U_MQTT_QOS_AT_MOST_ONCE, false);
     writeAlways(buffer);
 
 //    float px, py, pz;
 //    getPosition(x, y, z, &px, &py, &pz);
 //    snprintf(buffer, MQTT_MESSAGE_MAX_SIZE, "{\"Position\": {\"X\":\"%.2f\", \"Y\":\"%.2f\", \"Z\":\"%.2f\"}}", px, py, pz);
-//    sendMQTTMessage(topicName, buffer, U_MQTT_QOS_AT_MOST_ONCE, false);
+//    sendMQTTMessage(taskTopic, buffer, U_MQTT_QOS_AT_MOST_ONCE, false);
 //    writeLog(buffer);
 }
 
@@ -96,7 +98,7 @@ static void publishTemp(void)
                 "{\"Temperature\": {\"Temperature\":\"%.2f\", \"Pressure\":\"%.2f\", \"Humidity\":\"%.2f\"}}",
                 temp, pressure, humidity);
 
-    sendMQTTMessage(topicName, buffer, U_MQTT_QOS_AT_MOST_ONCE, false);
+    sendMQTTMessage(taskTopic, buffer, U_MQTT_QOS_AT_MOST_ONCE, false);
     writeAlways(buffer);
 }
 
@@ -105,7 +107,7 @@ static void publishLight(void)
     int32_t lux = getLightSensor();
     snprintf(buffer, MQTT_MESSAGE_MAX_SIZE, "{\"Light\": {\"Lux\":\"%d\"}}", lux);
 
-    sendMQTTMessage(topicName, buffer, U_MQTT_QOS_AT_MOST_ONCE, false);
+    sendMQTTMessage(taskTopic, buffer, U_MQTT_QOS_AT_MOST_ONCE, false);
     writeAlways(buffer);
 }
 
@@ -151,20 +153,9 @@ static void taskLoop(void *pParameters)
 
 static int32_t initQueue()
 {
-    int32_t eventQueueHandle = uPortEventQueueOpen(&queueHandler,
-                    TASK_NAME,
-                    sizeof(sensorMsg_t),
-                    SENSOR_QUEUE_STACK_SIZE,
-                    SENSOR_QUEUE_PRIORITY,
-                    SENSOR_QUEUE_SIZE);
-
-    if (eventQueueHandle < 0) {
-        writeFatal("Failed to create %s event queue %d", TASK_NAME, eventQueueHandle);
-    }
-
-    TASK_QUEUE = eventQueueHandle;
-
-    return eventQueueHandle;
+    return openTaskQueue(taskConfig, queueHandler, sizeof(sensorMsg_t),
+                         SENSOR_QUEUE_STACK_SIZE, SENSOR_TASK_STACK_SIZE,
+                         SENSOR_QUEUE_PRIORITY, SENSOR_QUEUE_SIZE);
 }
 
 static int32_t initMutex()
@@ -178,7 +169,7 @@ static int32_t initMutex()
 /// @brief Queue the Get Sensors command
 /// @param params The parameters for this command
 /// @return returns the errorCode of sending the message on the eventQueue
-int32_t queueGetSensors(commandParamsList_t *params)
+int32_t queueGetSensors(commandParams_t *params)
 {
     sensorMsg_t qMsg;
     qMsg.msgType = GET_SENSORS_NOW;
@@ -198,22 +189,18 @@ int32_t initSensorTask(taskConfig_t *config)
 
     int32_t result = U_ERROR_COMMON_SUCCESS;
 
-    CREATE_TOPIC_NAME;
+    REGISTER_TASK_TOPIC;
 
     writeLog("Initializing the %s task...", TASK_NAME);
     EXIT_ON_FAILURE(initMutex);
     EXIT_ON_FAILURE(initQueue);
 
-    char tp[MAX_TOPIC_NAME_SIZE];
-    snprintf(tp, MAX_TOPIC_NAME_SIZE, "%sControl", TASK_NAME);
-    subscribeToTopicAsync(tp, U_MQTT_QOS_AT_MOST_ONCE, callbacks, NUM_ELEMENTS(callbacks));
-
     return result;
 }
 
 /// @brief Starts the Sensor task loop
 /// @return zero if successful, a negative number otherwise
-int32_t startSensorTaskLoop(commandParamsList_t *params)
+int32_t startSensorTaskLoop(commandParams_t *params)
 {
     EXIT_IF_CANT_RUN_TASK;
 
@@ -224,7 +211,7 @@ int32_t startSensorTaskLoop(commandParamsList_t *params)
     START_TASK_LOOP(SENSOR_TASK_STACK_SIZE, SENSOR_TASK_PRIORITY);
 }
 
-int32_t stopSensorTaskLoop(commandParamsList_t *params)
+int32_t stopSensorTaskLoop(commandParams_t *params)
 {
     STOP_TASK;
 }
@@ -232,4 +219,12 @@ int32_t stopSensorTaskLoop(commandParamsList_t *params)
 int32_t finalizeSensorTask(void)
 {
     return U_ERROR_COMMON_SUCCESS;
-}
\ No newline at end of file
+}
+
+/* ----------------------------------------------------------------
+ * TASK RUNNER
+ * -------------------------------------------------------------- */
+/// @brief Measures the sensor parameters and publishes the results
+taskRunner_t sensorTaskRunner = {initSensorTask, startSensorTaskLoop, stopSensorTaskLoop, finalizeSensorTask, false,
+        {SENSOR_TASK, "Sensor", 30, false, BLANK_TASK_HANDLES, NULL},
+        callbacks, NUM_ELEMENTS(callbacks)};
\ No newline at end of file
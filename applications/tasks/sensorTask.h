@@ -26,15 +26,17 @@
 /* ----------------------------------------------------------------
  * COMMON TASK FUNCTIONS
  * -------------------------------------------------------------- */
+extern taskRunner_t sensorTaskRunner;
+
 int32_t initSensorTask(taskConfig_t *config);
-int32_t startSensorTaskLoop(commandParamsList_t *params);
-int32_t stopSensorTaskLoop(commandParamsList_t *params);
+int32_t startSensorTaskLoop(commandParams_t *params);
+int32_t stopSensorTaskLoop(commandParams_t *params);
 int32_t finalizeSensorTask(void);
 
 /* ----------------------------------------------------------------
  * PUBLIC TASK FUNCTIONS
  * -------------------------------------------------------------- */
-int32_t queueGetSensors(commandParamsList_t *params);
+int32_t queueGetSensors(commandParams_t *params);
 
 /* ----------------------------------------------------------------
  * QUEUE MESSAGE TYPE DEFINITIONS
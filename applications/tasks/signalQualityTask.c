@@ -20,6 +20,8 @@
  *
  */
 
+#define LOG_MODULE SIGNAL_QUALITY_TASK
+
 #include "common.h"
 #include "taskControl.h"
 #include "signalQualityTask.h"
@@ -56,7 +58,7 @@ static taskConfig_t *taskConfig = NULL;
 /* ----------------------------------------------------------------
  * STATIC VARIABLES
  * -------------------------------------------------------------- */
-static char topicName[MAX_TOPIC_NAME_SIZE];
+static mqttTopicHandle_t taskTopic = U_ERROR_COMMON_NOT_INITIALISED;
 
 /// callback commands for incoming MQTT control messages
 static callbackCommand_t callbacks[] = {
@@ -82,7 +84,7 @@ static void measureSignalQuality(void)
 {
     int32_t errorCode;
 
-    if (!gIsNetworkUp) {
+    if (!isEventActive(EVENT_NETWORK_UP)) {
         printDebug("measureSignalQuality(): Network is not attached.");
         return;
     }
@@ -131,7 +133,7 @@ static void measureSignalQuality(void)
         snprintf(jsonBuffer, JSON_STRING_LENGTH, format, timestamp, 
                                 rsrp, rsrq, rssi, snr, rxqual, 
                                 logicalCellId, physicalCellId, earfcn, operatorMcc, operatorMnc, pOperatorName);
-        sendMQTTMessage(topicName, jsonBuffer, U_MQTT_QOS_AT_MOST_ONCE, false);
+        sendMQTTMessage(taskTopic, jsonBuffer, U_MQTT_QOS_AT_MOST_ONCE, false);
         writeAlways(jsonBuffer);
     } else {
         if (errorCode == U_CELL_ERROR_NOT_REGISTERED) {
@@ -177,20 +179,9 @@ static void taskLoop(void *pParameters)
 
 static int32_t initQueue()
 {
-    int32_t eventQueueHandle = uPortEventQueueOpen(&queueHandler,
-                    TASK_NAME,
-                    sizeof(signalQualityMsg_t),
-                    SIGNAL_QUALITY_QUEUE_STACK_SIZE,
-                    SIGNAL_QUALITY_QUEUE_PRIORITY,
-                    SIGNAL_QUALITY_QUEUE_SIZE);
-
-    if (eventQueueHandle < 0) {
-        writeFatal("Failed to create %s event queue %d", TASK_NAME, eventQueueHandle);
-    }
-
-    TASK_QUEUE = eventQueueHandle;
-
-    return eventQueueHandle;
+    return openTaskQueue(taskConfig, queueHandler, sizeof(signalQualityMsg_t),
+                         SIGNAL_QUALITY_QUEUE_STACK_SIZE, SIGNAL_QUALITY_TASK_STACK_SIZE,
+                         SIGNAL_QUALITY_QUEUE_PRIORITY, SIGNAL_QUALITY_QUEUE_SIZE);
 }
 
 static int32_t initMutex()
@@ -204,7 +195,7 @@ static int32_t initMutex()
 /// @brief Queue the get cell quality measurements command
 /// @param params The parameters for this command
 /// @return returns the errorCode of sending the message on the eventQueue
-int32_t queueMeasureNow(commandParamsList_t *params)
+int32_t queueMeasureNow(commandParams_t *params)
 {
     signalQualityMsg_t qMsg;
     qMsg.msgType = MEASURE_SIGNAL_QUALTY_NOW;
@@ -223,22 +214,18 @@ int32_t initSignalQualityTask(taskConfig_t *config)
 
     int32_t result = U_ERROR_COMMON_SUCCESS;
 
-    CREATE_TOPIC_NAME;
+    REGISTER_TASK_TOPIC;
 
     writeLog("Initializing the %s task...", TASK_NAME);
     EXIT_ON_FAILURE(initMutex);
     EXIT_ON_FAILURE(initQueue);
 
-    char tp[MAX_TOPIC_NAME_SIZE];
-    snprintf(tp, MAX_TOPIC_NAME_SIZE, "%sControl", TASK_NAME);
-    subscribeToTopicAsync(tp, U_MQTT_QOS_AT_MOST_ONCE, callbacks, NUM_ELEMENTS(callbacks));
-
     return result;
 }
 
 /// @brief Starts the Signal Quality task loop
 /// @return zero if successful, a negative number otherwise
-int32_t startSignalQualityTaskLoop(commandParamsList_t *params)
+int32_t startSignalQualityTaskLoop(commandParams_t *params)
 {
     EXIT_IF_CANT_RUN_TASK;
 
@@ -248,7 +235,7 @@ int32_t startSignalQualityTaskLoop(commandParamsList_t *params)
     START_TASK_LOOP(SIGNAL_QUALITY_TASK_STACK_SIZE, SIGNAL_QUALITY_TASK_PRIORITY);
 }
 
-int32_t stopSignalQualityTaskLoop(commandParamsList_t *params)
+int32_t stopSignalQualityTaskLoop(commandParams_t *params)
 {
     STOP_TASK;
 }
@@ -256,4 +243,12 @@ int32_t stopSignalQualityTaskLoop(commandParamsList_t *params)
 int32_t finalizeSignalQualityTask(void)
 {
     return U_ERROR_COMMON_SUCCESS;
-}
\ No newline at end of file
+}
+
+/* ----------------------------------------------------------------
+ * TASK RUNNER
+ * -------------------------------------------------------------- */
+/// @brief Measures the Signal Quality and other network parameters and publishes the results
+taskRunner_t signalQualityTaskRunner = {initSignalQualityTask, startSignalQualityTaskLoop, stopSignalQualityTaskLoop, finalizeSignalQualityTask, false,
+        {SIGNAL_QUALITY_TASK, "SignalQuality", 30, false, BLANK_TASK_HANDLES, NULL},
+        callbacks, NUM_ELEMENTS(callbacks)};
\ No newline at end of file
@@ -26,15 +26,17 @@
 /* ----------------------------------------------------------------
  * COMMON TASK FUNCTIONS
  * -------------------------------------------------------------- */
+extern taskRunner_t signalQualityTaskRunner;
+
 int32_t initSignalQualityTask(taskConfig_t *config);
-int32_t startSignalQualityTaskLoop(commandParamsList_t *params);
-int32_t stopSignalQualityTaskLoop(commandParamsList_t *params);
+int32_t startSignalQualityTaskLoop(commandParams_t *params);
+int32_t stopSignalQualityTaskLoop(commandParams_t *params);
 int32_t finalizeSignalQualityTask(void);
 
 /* ----------------------------------------------------------------
  * PUBLIC TASK FUNCTIONS
  * -------------------------------------------------------------- */
-int32_t queueMeasureNow(commandParamsList_t *cmd);
+int32_t queueMeasureNow(commandParams_t *cmd);
 
 /* ----------------------------------------------------------------
  * QUEUE MESSAGE TYPE DEFINITIONS
@@ -18,76 +18,63 @@
  *  Task control functions - how the application initialises and runs the various tasks
  */
 
+#include <ctype.h>
+
 #include "common.h"
-#include "leds.h"
+#include "config.h"
 #include "taskControl.h"
-#include "LEDTask.h"
 #include "mqttTask.h"
-#include "registrationTask.h"
-#include "signalQualityTask.h"
-#include "cellScanTask.h"
-#include "locationTask.h"
-#include "sensorTask.h"
-#include "exampleTask.h"
 
-static void setRedLED(void *param);
+// configuration keys for the task dwell times, "<TASKNAME>_DWELL_TIME"
+#define DWELL_TIME_KEY_SIZE 32
+#define DWELL_TIME_MAX_SECONDS 3600
 
-/* ----------------------------------------------------------------
- * Task Runner Definitions for each appTask. These task runners 
- * define the application. Here we specify what tasks are to run, 
- * and what configuration they are to use
- * -------------------------------------------------------------- */
+// the dwell polling period, only used if a task has no dwell semaphore
+#define TASK_DWELL_POLL_MS 100
 
-taskRunner_t taskRunners[] = {
-    // Registration - Looks after the cellular registration process
-    {initNetworkRegistrationTask, startNetworkRegistrationTaskLoop, stopNetworkRegistrationTaskLoop, finalizeNetworkRegistrationTask, true,
-            {NETWORK_REG_TASK, "Registration", 30, false, BLANK_TASK_HANDLES, setRedLED}},
+// the least a dwell blocks for, so that a task loop which can't dwell
+// still gives the other tasks a run
+#define TASK_DWELL_MIN_MS 100
 
-    // CellScan - Performs the +COPS=? Query for seeing what cells are available and publishes the results
-    {initCellScanTask, startCellScanTaskLoop, stopCellScanTask, finalizeCellScanTask, false,
-            {CELL_SCAN_TASK, "CellScan", -1, false, BLANK_TASK_HANDLES, NULL}},
+// how often to log that a task still hasn't stopped
+#define TASK_STOP_LOG_INTERVAL_MS 5000
 
-    // MQTT - Handles the MQTT broker connection, publishing messages and handling downlink messages
-    {initMQTTTask, startMQTTTaskLoop, stopMQTTTaskLoop, finalizeMQTTTask, false,
-            {MQTT_TASK, "MQTT", 30, false, BLANK_TASK_HANDLES, NULL}},
+// how long finalizing waits for the thread of a single thread task to exit
+#define TASK_THREAD_EXIT_DEADLINE_MS 1000
 
-    // SignalQuality - Measures the Signal Quality and other network parameters and publishes the results
-    {initSignalQualityTask, startSignalQualityTaskLoop, stopSignalQualityTaskLoop, finalizeSignalQualityTask, false,
-            {SIGNAL_QUALITY_TASK, "SignalQuality", 30, false, BLANK_TASK_HANDLES, NULL}},
+// the task state changes are signalled with this condition variable
+K_MUTEX_DEFINE(taskStateMutex);
+K_CONDVAR_DEFINE(taskStateChanged);
 
-    // LED - Handles the flashing of the LEDS depending on the AppStatus global variable
-    {initLEDTask, startLEDTaskLoop, stopLEDTaskLoop, finalizeLEDTask, false,
-            {LED_TASK, "LED", -1, false, BLANK_TASK_HANDLES, setRedLED}},
+// the tasks are initialised on their first use, from any thread
+K_MUTEX_DEFINE(taskInitMutex);
 
-    // Example - Simple example task that does "nothing"
-    {initExampleTask, startExampleTaskLoop, stopExampleTaskLoop, finalizeExampleTask, false,
-            {EXAMPLE_TASK, "Example", 30, false, BLANK_TASK_HANDLES, NULL}},
+static char dwellTimeKeys[MAX_TASKS][DWELL_TIME_KEY_SIZE];
+static configSchema_t dwellTimeSchema[MAX_TASKS];
 
-    // Location - Periodically gets the GNSS location of the device and publishes the results
-    {initLocationTask, startLocationTaskLoop, stopLocationTaskLoop, finalizeLocationTask, false,
-            {LOCATION_TASK, "Location", 30, false, BLANK_TASK_HANDLES, NULL}},
+// each task uses its task ID as its logging module
+_Static_assert(MAX_TASKS <= LOG_MODULE_APP, "Too many tasks for the logging modules");
 
-    // Sensor - Measures the sensor parameters and publishes the results
-    {initSensorTask, startSensorTaskLoop, stopSensorTaskLoop, finalizeSensorTask, false,
-            {SENSOR_TASK, "Sensor", 30, false, BLANK_TASK_HANDLES, NULL}}
-};
+// the registered task runners, indexed by their task ID. Each task runner
+// is defined in its task's source file, so only the registered tasks are
+// linked into the application. The tasks are looked up from the
+// interrupts too, so they are guarded with a spinlock.
+static taskRunner_t *taskRunners[MAX_TASKS];
+static struct k_spinlock taskRunnersLock;
 
 /* ----------------------------------------------------------------
  * STATIC FUNCTIONS
  * -------------------------------------------------------------- */
-static void setRedLED(void *param)
+taskRunner_t *getTaskRunner(taskTypeId_t id)
 {
-    SET_RED_LED;
-}
+    if ((uint32_t)id >= NUM_ELEMENTS(taskRunners))
+        return NULL;
 
-static taskRunner_t *getTaskRunner(taskTypeId_t id)
-{
-    for(size_t i=0; i<NUM_ELEMENTS(taskRunners); i++) {
-        if (taskRunners[i].config.id == id)
-            return &taskRunners[i];
-    }
+    k_spinlock_key_t key = k_spin_lock(&taskRunnersLock);
+    taskRunner_t *runner = taskRunners[id];
+    k_spin_unlock(&taskRunnersLock, key);
 
-    return NULL;
+    return runner;
 }
 
 static taskConfig_t *getTaskConfig(taskTypeId_t id)
@@ -98,9 +85,27 @@ static taskConfig_t *getTaskConfig(taskTypeId_t id)
     return &(runner->config);
 }
 
+static bool isActiveTaskState(taskState_t state)
+{
+    return state == TASK_STATE_RUNNING || state == TASK_STATE_STOPPING;
+}
+
+static bool isTaskInState(taskConfig_t *taskConfig, taskState_t state)
+{
+    taskState_t current = (taskState_t)atomic_get(&taskConfig->state);
+
+    // a task which was never started is stopped too
+    if (state == TASK_STATE_STOPPED)
+        return !isActiveTaskState(current);
+
+    return current == state;
+}
+
 /// @brief Blocking function while waiting for the task to finish
-/// @param taskConfig The task Configuration to wait for
-static bool waitForTaskToStop(taskTypeId_t id)
+/// @param id The ID of the task to wait for
+/// @param endTimeMs The time to stop waiting at
+/// @return true if the task has stopped, false otherwise
+static bool waitForTaskToStop(taskTypeId_t id, int64_t endTimeMs)
 {
     taskRunner_t *taskRunner = getTaskRunner(id);
     if (taskRunner == NULL) {
@@ -108,13 +113,21 @@ static bool waitForTaskToStop(taskTypeId_t id)
         return false;
     }
 
-    while(isMutexLocked(taskRunner->config.handles.mutexHandle)) {
-        writeInfo("Waiting for %s task to stop...", taskRunner->config.name);
-        uPortTaskBlock(2000);
+    int64_t remainingMs;
+    while((remainingMs = endTimeMs - getMonotonicTimeMs()) > 0) {
+        int32_t waitMs = (int32_t)MIN(remainingMs, TASK_STOP_LOG_INTERVAL_MS);
+        if (waitForTaskState(id, TASK_STATE_STOPPED, waitMs) != U_ERROR_COMMON_TIMEOUT)
+            return true;
+
+        if (remainingMs > TASK_STOP_LOG_INTERVAL_MS)
+            writeInfo("Waiting for %s task to stop...", taskRunner->config.name);
     }
 
-    return true;
+    if (isTaskInState(&taskRunner->config, TASK_STATE_STOPPED))
+        return true;
 
+    writeWarn("%s task didn't stop in time, not waiting for it", taskRunner->config.name);
+    return false;
 }
 
 static bool stopTask(taskTypeId_t id)
@@ -130,6 +143,9 @@ static bool stopTask(taskTypeId_t id)
         return true;
     }
 
+    if (!runner->config.initialised)
+        return true;
+
     int32_t errorCode = runner->stopFunc(NULL);
     if (errorCode != 0) {
         writeFatal("Stopping task %s returned error: %d", runner->config.name, errorCode);
@@ -139,6 +155,30 @@ static bool stopTask(taskTypeId_t id)
     return true;
 }
 
+/// @brief Wakes up the thread of a single thread task, which exits as the
+///        application is exiting, and waits for it to exit
+/// @return true if the task has no thread of its own, or it has exited
+static bool waitForTaskThreadExit(taskConfig_t *taskConfig, int32_t timeoutMs)
+{
+    int64_t endTimeMs = getMonotonicTimeMs() + timeoutMs;
+    bool exited = true;
+
+    k_mutex_lock(&taskStateMutex, K_FOREVER);
+    while(taskConfig->handles.threadHandle != NULL) {
+        int64_t remainingMs = endTimeMs - getMonotonicTimeMs();
+        if (remainingMs <= 0) {
+            exited = false;
+            break;
+        }
+
+        wakeTask(taskConfig);
+        k_condvar_wait(&taskStateChanged, &taskStateMutex, K_MSEC(remainingMs));
+    }
+    k_mutex_unlock(&taskStateMutex);
+
+    return exited;
+}
+
 static int32_t finalizeTask(taskTypeId_t id)
 {
     taskRunner_t *runner = getTaskRunner(id);
@@ -147,12 +187,37 @@ static int32_t finalizeTask(taskTypeId_t id)
         return U_ERROR_COMMON_UNKNOWN;
     }
 
+    if (!runner->config.initialised)
+        return U_ERROR_COMMON_SUCCESS;
+
+    // a task which didn't stop in time may still be using its resources
+    if (isTaskRunning(&runner->config)) {
+        printWarn("Task %s is still running, not finalizing it", runner->config.name);
+        return U_ERROR_COMMON_SUCCESS;
+    }
+
+    // the thread of a single thread task uses the queue and semaphore
+    if (!waitForTaskThreadExit(&runner->config, TASK_THREAD_EXIT_DEADLINE_MS)) {
+        printWarn("Task %s thread is still running, not finalizing it", runner->config.name);
+        return U_ERROR_COMMON_SUCCESS;
+    }
+
     int32_t errorCode = runner->finalizeFunc();
     if (errorCode < 0) {
         printError("Failed to finalize task %s, error: %d", runner->config.name, errorCode);
         return errorCode;
     }
 
+    if (runner->config.handles.queueHandle != NULL) {
+        uPortQueueDelete(runner->config.handles.queueHandle);
+        runner->config.handles.queueHandle = NULL;
+    }
+
+    if (runner->config.handles.dwellSemaphoreHandle != NULL) {
+        uPortSemaphoreDelete(runner->config.handles.dwellSemaphoreHandle);
+        runner->config.handles.dwellSemaphoreHandle = NULL;
+    }
+
     return U_ERROR_COMMON_SUCCESS;
 }
 
@@ -160,80 +225,151 @@ static int32_t finalizeTask(taskTypeId_t id)
  * PUBLIC FUNCTIONS
  * -------------------------------------------------------------- */
 
-/// @brief Checks the "isTaskRunningxxxx()" functions and returns when the tasks have all stopped.
-void waitForAllTasksToStop()
+/// @brief Waits for all the tasks, except the ones which are stopped on their own, to stop.
+bool waitForAllTasksToStop(int32_t deadlineMs)
 {
-    bool stillWaiting;
-
-    writeLog("Waiting for app tasks to stop... This can take sometime if waiting for AT commands to timeout...");
-    do
-    {
-        stillWaiting = false;
-
-        for(int i=0; i<NUM_ELEMENTS(taskRunners); i++) {
-            taskRunner_t *taskRunner = &taskRunners[i];
-            
-            // some tasks need to stopped on their own
-            if (taskRunner->explicit_stop) 
-                continue;
-
-            if (isMutexLocked(taskRunner->config.handles.mutexHandle)) {
-                printDebug("...still waiting for %s task to finish", taskRunner->config.name);
-                stillWaiting = true;
-            }
+    writeLog("Waiting for app tasks to stop...");
+
+    // the tasks were all told to stop together, so they share the deadline
+    int64_t endTimeMs = getMonotonicTimeMs() + deadlineMs;
+    size_t notStopped = 0;
+    for(size_t i=0; i<NUM_ELEMENTS(taskRunners); i++) {
+        // some tasks need to stopped on their own
+        taskRunner_t *runner = getTaskRunner((taskTypeId_t)i);
+        if (runner != NULL && !runner->explicit_stop &&
+                !waitForTaskToStop(runner->config.id, endTimeMs)) {
+            writeWarn("%s task didn't stop", runner->config.name);
+            notStopped++;
         }
+    }
 
-        uPortTaskBlock(100);
-    } while (stillWaiting);
+    if (notStopped > 0) {
+        writeWarn("%d tasks didn't stop within %d ms", (int)notStopped, deadlineMs);
+        return false;
+    }
 
     writeLog("All tasks have now finished...");
+    return true;
 }
 
-void stopAndWait(taskTypeId_t id)
+bool stopAndWait(taskTypeId_t id, int32_t deadlineMs)
 {
-    if (stopTask(id))
-        waitForTaskToStop(id);
+    if (!stopTask(id))
+        return false;
+
+    return waitForTaskToStop(id, getMonotonicTimeMs() + deadlineMs);
+}
+
+int32_t getTaskIdByName(const char *pName)
+{
+    if (pName == NULL)
+        return U_ERROR_COMMON_INVALID_PARAMETER;
+
+    for(size_t i=0; i<NUM_ELEMENTS(taskRunners); i++) {
+        taskRunner_t *runner = getTaskRunner((taskTypeId_t)i);
+        if (runner != NULL && strcmp(runner->config.name, pName) == 0)
+            return runner->config.id;
+    }
+
+    return U_ERROR_COMMON_NOT_FOUND;
 }
 
 int32_t initSingleTask(taskTypeId_t id)
 {
     taskRunner_t *taskRunner = getTaskRunner(id);
     if (taskRunner == NULL) {
-        printError("Task Runner is NULL!");
+        printError("Task ID #%d is not registered, not initialising it", id);
         return U_ERROR_COMMON_INVALID_PARAMETER;
     }
 
     taskConfig_t *taskConfig = &taskRunner->config;
+    int32_t errorCode = U_ERROR_COMMON_SUCCESS;
 
+    // the first start and the first message can both initialise the task
+    k_mutex_lock(&taskInitMutex, K_FOREVER);
     if (!taskConfig->initialised) {
-        int32_t errorCode = taskRunner->initFunc(taskConfig);
+        taskConfig->scheduledJob = U_ERROR_COMMON_NOT_INITIALISED;
+
+        // the dwell semaphore and the scheduled job are only made once the
+        // task has initialised, so a task which fails to doesn't hold them
+        errorCode = taskRunner->initFunc(taskConfig);
         if (errorCode < 0) {
             writeFatal("* Failed to initialise the %s task (%d)", taskConfig->name, errorCode);
-            return errorCode;
-        }
+        } else {
+            // the task polls its dwell instead if it doesn't have the semaphore
+            if (uPortSemaphoreCreate(&taskConfig->handles.dwellSemaphoreHandle, 0, 1) != 0) {
+                writeWarn("Failed to create the %s task's dwell semaphore", taskConfig->name);
+                taskConfig->handles.dwellSemaphoreHandle = NULL;
+            }
+
+            // the dwells of the task loop are planned with the scheduler
+            if (taskConfig->taskLoopDwellTime > 0) {
+                int32_t periodMs = taskConfig->taskLoopDwellTime * 1000;
+                taskConfig->scheduledJob = addScheduledJob(taskConfig->name, periodMs,
+                                                           SCHEDULER_DEFAULT_WINDOW_MS(periodMs));
+                if (taskConfig->scheduledJob < 0)
+                    writeWarn("Failed to schedule the %s task loop: %d", taskConfig->name,
+                                taskConfig->scheduledJob);
+            }
 
-        taskConfig->initialised = true;
+            taskConfig->initialised = true;
+        }
     } else {
         printDebug("%s task has already been initialised", taskConfig->name);
     }
+    k_mutex_unlock(&taskInitMutex);
 
-    return U_ERROR_COMMON_SUCCESS;
+    return errorCode < 0 ? errorCode : U_ERROR_COMMON_SUCCESS;
 }
 
-int32_t initTasks()
+/// @brief Registers the task's dwell time as a configuration key, so that
+///        it is set from the configuration whenever it is loaded
+static void registerDwellTimeConfig(taskConfig_t *config)
 {
-    int32_t errorCode = U_ERROR_COMMON_SUCCESS;
-    taskRunner_t *runner = taskRunners;
+    if (config->taskLoopDwellTime <= 0)
+        return;
+
+    char *key = dwellTimeKeys[config->id];
+    snprintf(key, DWELL_TIME_KEY_SIZE, "%s_DWELL_TIME", config->name);
+    for(char *c = key; *c != 0; c++)
+        *c = toupper((unsigned char)*c);
+
+    configSchema_t entry = CONFIG_INT(key, config->taskLoopDwellTime, 1, DWELL_TIME_MAX_SECONDS,
+                                        &config->taskLoopDwellTime);
+    dwellTimeSchema[config->id] = entry;
+    registerConfigSchema(&dwellTimeSchema[config->id], 1);
+}
 
-    for(int i=0; i<NUM_ELEMENTS(taskRunners); i++) {
-        errorCode = initSingleTask(runner->config.id);
-        if (errorCode < 0)
-            break;
+int32_t registerTask(taskRunner_t *pRunner)
+{
+    if (pRunner == NULL || (uint32_t)pRunner->config.id >= MAX_TASKS)
+        return U_ERROR_COMMON_INVALID_PARAMETER;
+
+    taskTypeId_t id = pRunner->config.id;
+    k_spinlock_key_t key = k_spin_lock(&taskRunnersLock);
+    taskRunner_t *registered = taskRunners[id];
+    if (registered == NULL)
+        taskRunners[id] = pRunner;
+    k_spin_unlock(&taskRunnersLock, key);
+
+    if (registered != NULL) {
+        if (registered == pRunner)
+            return U_ERROR_COMMON_SUCCESS;
 
-        runner++;
+        writeError("Task ID #%d is already registered to the %s task, not registering %s",
+                    id, registered->config.name, pRunner->config.name);
+        return U_ERROR_COMMON_BUSY;
     }
 
-    return errorCode;
+    registerDwellTimeConfig(&pRunner->config);
+    writeDebug("Registered the %s task", pRunner->config.name);
+
+    // the control topic is subscribed now, so a remote command can start
+    // a task which hasn't been used yet
+    if (pRunner->controlCommands != NULL)
+        subscribeToTaskControlAsync(pRunner);
+
+    return U_ERROR_COMMON_SUCCESS;
 }
 
 int32_t runTask(taskTypeId_t id, bool (*waitForFunc)(void))
@@ -242,11 +378,18 @@ int32_t runTask(taskTypeId_t id, bool (*waitForFunc)(void))
 
     taskRunner_t *runner = getTaskRunner(id);
     if (runner == NULL) {
-        printError("Failed to get task runner for task ID #%d, not running task", id);
-        return U_ERROR_COMMON_UNKNOWN;
+        printError("Task ID #%d is not registered, not running task", id);
+        return U_ERROR_COMMON_NOT_FOUND;
     }
 
-    int32_t errorCode = runner->startFunc(NULL);
+    // the task is initialised when it is first started
+    int32_t errorCode = U_ERROR_COMMON_SUCCESS;
+    if (!runner->config.initialised)
+        errorCode = initSingleTask(id);
+
+    if (errorCode == 0)
+        errorCode = runner->startFunc(NULL);
+
     if (errorCode < 0) {
         printError("Failed to start task %s, error: %d", runner->config.name, errorCode);
         return errorCode;
@@ -264,37 +407,266 @@ int32_t runTask(taskTypeId_t id, bool (*waitForFunc)(void))
 int32_t finalizeAllTasks()
 {
     int32_t errorCode = U_ERROR_COMMON_SUCCESS;
-    taskRunner_t *runner = taskRunners;
 
     writeInfo("Finalizing all the tasks...");
     for(int i=0; i<NUM_ELEMENTS(taskRunners); i++) {
+        taskRunner_t *runner = getTaskRunner((taskTypeId_t)i);
+        if (runner == NULL)
+            continue;
+
         errorCode = finalizeTask(runner->config.id);
         if (errorCode < 0)
             break;
-
-        runner++;
     }
 
     return errorCode;
 }
 
-/// @brief Waits for a period of time and exits if the task is requested to exit/stop
-/// @param taskConfig The task configuration that holds the dwell time
-/// @param exitFunc The function that checks if the task should exit/stop
 void dwellTask(taskConfig_t *taskConfig, bool (*canDoDwell)(void))
 {
-    // Always do a task block to give other tasks a run
-    uPortTaskBlock(100);
-
     writeDebug("%s dwelling for %d seconds...", taskConfig->name, taskConfig->taskLoopDwellTime);
+    taskHeartbeat(taskConfig);
+
+    uPortSemaphoreHandle_t semaphore = taskConfig->handles.dwellSemaphoreHandle;
+    int32_t periodMs = taskConfig->taskLoopDwellTime * 1000;
+    int64_t startTimeMs = getSchedulerTimeMs();
+    int64_t endTimeMs = startTimeMs + periodMs;
+    int64_t remainingMs = periodMs;
+
+    // the loop has run, so the next job which is due can run
+    endScheduledRun(taskConfig->scheduledJob);
+
+    // a wake up given while the loop was busy would end this dwell at once,
+    // so they are dropped, after handling any messages they were given for
+    if (semaphore != NULL) {
+        while (uPortSemaphoreTryTake(semaphore, 0) == 0)
+            ;
+
+        handleTaskMessages(taskConfig);
+    }
+
+    // end the dwell with the other scheduled jobs due around the same time
+    if (setScheduledJobPeriod(taskConfig->scheduledJob, periodMs, SCHEDULER_DEFAULT_WINDOW_MS(periodMs)) == 0)
+        endTimeMs = getNextScheduledRun(taskConfig->scheduledJob);
+
+    while (canDoDwell() && (remainingMs = endTimeMs - getSchedulerTimeMs()) > 0) {
+        if (semaphore == NULL) {
+            uPortTaskBlock(remainingMs < TASK_DWELL_POLL_MS ? remainingMs : TASK_DWELL_POLL_MS);
+        } else if (uPortSemaphoreTryTake(semaphore, (int32_t)remainingMs) == 0) {
+            // woken up by wakeTask(), unless it was only to handle a message
+            if (handleTaskMessages(taskConfig) == 0)
+                break;
+        }
+    }
+
+    int64_t dwellMs = getSchedulerTimeMs() - startTimeMs;
+    if (dwellMs < TASK_DWELL_MIN_MS)
+        uPortTaskBlock(TASK_DWELL_MIN_MS - (int32_t)dwellMs);
+
+    // a planned run waits for the other jobs which are due at the same time
+    if (remainingMs <= 0 &&
+            beginScheduledRun(taskConfig->scheduledJob, SCHEDULER_RUN_TIMEOUT_MS) == U_ERROR_COMMON_TIMEOUT)
+        writeDebug("%s task loop is running with another scheduled job", taskConfig->name);
+
+    taskHeartbeat(taskConfig);
+}
+
+void wakeTask(taskConfig_t *taskConfig)
+{
+    if (taskConfig != NULL && taskConfig->handles.dwellSemaphoreHandle != NULL)
+        uPortSemaphoreGive(taskConfig->handles.dwellSemaphoreHandle);
+}
+
+void wakeAllTasks(void)
+{
+    for(size_t i=0; i<NUM_ELEMENTS(taskRunners); i++) {
+        taskRunner_t *runner = getTaskRunner((taskTypeId_t)i);
+        if (runner != NULL)
+            wakeTask(&runner->config);
+    }
+}
+
+void publishTaskJobFailure(taskConfig_t *taskConfig, int32_t topic, int32_t errorCode)
+{
+    if (topic < 0)
+        return;
+
+    char timestamp[TIMESTAMP_MAX_LENTH_BYTES];
+    getTimeStamp(timestamp);
+
+    char message[100];
+    snprintf(message, sizeof(message), "{\"Timestamp\":\"%s\", \"%s\":{\"Error\":%d}}",
+                timestamp, taskConfig->name, errorCode);
+
+    sendMQTTMessage(topic, message, U_MQTT_QOS_AT_MOST_ONCE, false);
+}
+
+void taskHeartbeat(taskConfig_t *taskConfig)
+{
+    // zero means no heartbeat, so the time wrapping to zero is skipped
+    uint32_t timeMs = (uint32_t)getMonotonicTimeMs();
+    atomic_set(&taskConfig->heartbeat, timeMs != 0 ? timeMs : 1);
+}
+
+#ifdef TASK_SINGLE_THREAD
+/// @brief The thread of a single thread task, which handles the event
+///        queue messages until the task loop is started in it
+static void taskThread(void *pParams)
+{
+    taskConfig_t *taskConfig = (taskConfig_t *)pParams;
+
+    while(!gExitApp || taskConfig->pendingLoop != NULL) {
+        void (*loop)(void *) = taskConfig->pendingLoop;
+        if (loop != NULL) {
+            taskConfig->pendingLoop = NULL;
+            loop(NULL);
+        } else if (uPortSemaphoreTake(taskConfig->handles.dwellSemaphoreHandle) == 0) {
+            handleTaskMessages(taskConfig);
+        }
+    }
+
+    // finalizing the task waits for this before deleting the queue and semaphore
+    k_mutex_lock(&taskStateMutex, K_FOREVER);
+    taskConfig->handles.threadHandle = NULL;
+    k_condvar_broadcast(&taskStateChanged);
+    k_mutex_unlock(&taskStateMutex);
+
+    uPortTaskDelete(NULL);
+}
+#endif
+
+int32_t openTaskQueue(taskConfig_t *taskConfig, taskQueueHandler_t handler, size_t msgSize,
+                      size_t queueStackSize, size_t loopStackSize, int32_t priority, size_t queueLength)
+{
+#ifdef TASK_SINGLE_THREAD
+    if (loopStackSize != TASK_NO_LOOP && msgSize <= TASK_QUEUE_MAX_MSG_SIZE &&
+            taskConfig->handles.dwellSemaphoreHandle != NULL) {
+        taskConfig->queueHandler = handler;
+        taskConfig->queueMsgSize = msgSize;
+
+        int32_t errorCode = uPortQueueCreate(queueLength, msgSize, &taskConfig->handles.queueHandle);
+        if (errorCode != 0) {
+            writeFatal("Failed to create the %s queue (%d).", taskConfig->name, errorCode);
+            taskConfig->handles.queueHandle = NULL;
+            return errorCode;
+        }
+
+        size_t stackSize = MAX(queueStackSize, loopStackSize);
+        errorCode = uPortTaskCreate(taskThread, taskConfig->name, stackSize, taskConfig,
+                                    priority, &taskConfig->handles.threadHandle);
+        if (errorCode != 0) {
+            writeFatal("Failed to start the %s thread (%d).", taskConfig->name, errorCode);
+            uPortQueueDelete(taskConfig->handles.queueHandle);
+            taskConfig->handles.queueHandle = NULL;
+            return errorCode;
+        }
+
+        writeInfo("%s task runs in one thread, saving %d bytes of stack",
+                    taskConfig->name, (int)(queueStackSize + loopStackSize - stackSize));
+        return U_ERROR_COMMON_SUCCESS;
+    }
+#endif
+
+    int32_t eventQueueHandle = uPortEventQueueOpen(handler, taskConfig->name, msgSize,
+                                                   queueStackSize, priority, queueLength);
+    if (eventQueueHandle < 0) {
+        writeFatal("Failed to create %s event queue %d", taskConfig->name, eventQueueHandle);
+        return eventQueueHandle;
+    }
+
+    taskConfig->handles.eventQueueHandle = eventQueueHandle;
+    return eventQueueHandle;
+}
+
+int32_t startTaskLoop(taskConfig_t *taskConfig, void (*loop)(void *), size_t stackSize, int32_t priority)
+{
+    setTaskState(taskConfig, TASK_STATE_RUNNING);
+
+    if (taskConfig->handles.threadHandle != NULL) {
+        taskConfig->pendingLoop = loop;
+        taskConfig->handles.taskHandle = taskConfig->handles.threadHandle;
+        wakeTask(taskConfig);
+        return U_ERROR_COMMON_SUCCESS;
+    }
+
+    int32_t errorCode = uPortTaskCreate(runTaskAndDelete, taskConfig->name, stackSize,
+                                        loop, priority, &taskConfig->handles.taskHandle);
+    if (errorCode != 0)
+        setTaskState(taskConfig, TASK_STATE_STOPPED);
+
+    return errorCode;
+}
+
+size_t handleTaskMessages(taskConfig_t *taskConfig)
+{
+    if (taskConfig->handles.queueHandle == NULL)
+        return 0;
+
+    // aligned for the message structures which are copied into it
+    uint64_t message[TASK_QUEUE_MAX_MSG_SIZE / sizeof(uint64_t)];
+    size_t count = 0;
+
+    while(uPortQueueTryReceive(taskConfig->handles.queueHandle, 0, message) == 0) {
+        taskConfig->queueHandler(message, taskConfig->queueMsgSize);
+        count++;
+    }
+
+    return count;
+}
+
+void setTaskState(taskConfig_t *taskConfig, taskState_t state)
+{
+    k_mutex_lock(&taskStateMutex, K_FOREVER);
+    atomic_set(&taskConfig->state, state);
+    k_condvar_broadcast(&taskStateChanged);
+    k_mutex_unlock(&taskStateMutex);
+}
+
+void requestTaskStop(taskConfig_t *taskConfig)
+{
+    k_mutex_lock(&taskStateMutex, K_FOREVER);
+    if (atomic_cas(&taskConfig->state, TASK_STATE_RUNNING, TASK_STATE_STOPPING))
+        k_condvar_broadcast(&taskStateChanged);
+    k_mutex_unlock(&taskStateMutex);
+
+    wakeTask(taskConfig);
+}
+
+bool isTaskRunning(taskConfig_t *taskConfig)
+{
+    if (taskConfig == NULL)
+        return false;
+
+    return isActiveTaskState((taskState_t)atomic_get(&taskConfig->state));
+}
+
+int32_t waitForTaskState(taskTypeId_t id, taskState_t state, int32_t timeoutMs)
+{
+    taskConfig_t *taskConfig = getTaskConfig(id);
+    if (taskConfig == NULL)
+        return U_ERROR_COMMON_INVALID_PARAMETER;
+
+    int32_t errorCode = U_ERROR_COMMON_SUCCESS;
+    int64_t endTimeMs = getMonotonicTimeMs() + timeoutMs;
+
+    k_mutex_lock(&taskStateMutex, K_FOREVER);
+    while(!isTaskInState(taskConfig, state)) {
+        k_timeout_t timeout = K_FOREVER;
+        if (timeoutMs >= 0) {
+            int64_t remainingMs = endTimeMs - getMonotonicTimeMs();
+            if (remainingMs <= 0) {
+                errorCode = U_ERROR_COMMON_TIMEOUT;
+                break;
+            }
+
+            timeout = K_MSEC(remainingMs);
+        }
 
-    // multiply by 10 as the TaskBlock is 100ms
-    int32_t count = taskConfig->taskLoopDwellTime * 10;
-    int i = 0;
-    do {
-        uPortTaskBlock(100);
-        i++;
-    } while (canDoDwell() && i < count);
+        k_condvar_wait(&taskStateChanged, &taskStateMutex, timeout);
+    }
+    k_mutex_unlock(&taskStateMutex);
+
+    return errorCode;
 }
 
 /// @brief Sends a task a message via its event queue
@@ -310,13 +682,29 @@ int32_t sendAppTaskMessage(int32_t taskId, void *pMessage, size_t msgSize)
         return U_ERROR_COMMON_NOT_FOUND;
     }
 
+    // a task is initialised by its first message if it hasn't been started,
+    // unless the message is from an interrupt
+    if (!taskConfig->initialised && !k_is_in_isr())
+        initSingleTask(taskId);
+
     // if the mutex or queue handle is not valid, don't queue a message
     if (!taskConfig->initialised) {
         printError("%s queue/task is not initialised, not queueing command", taskConfig->name);
         return U_ERROR_COMMON_NOT_INITIALISED;
     }
 
-    int32_t errorCode = uPortEventQueueSendIrq(taskConfig->handles.eventQueueHandle, pMessage, msgSize);
+    int32_t errorCode;
+    if (taskConfig->handles.queueHandle != NULL) {
+        if (msgSize != taskConfig->queueMsgSize)
+            return U_ERROR_COMMON_INVALID_PARAMETER;
+
+        errorCode = uPortQueueSendIrq(taskConfig->handles.queueHandle, pMessage);
+        if (errorCode == 0)
+            wakeTask(taskConfig);
+    } else {
+        errorCode = uPortEventQueueSendIrq(taskConfig->handles.eventQueueHandle, pMessage, msgSize);
+    }
+
     if (errorCode < 0) {
         // this is a debug message because this will only error if there is no room on the queue, but that
         // isn't an error, it's just what can happen.
@@ -26,7 +26,13 @@
 /* ----------------------------------------------------------------
  * DEFINITIONS
  * -------------------------------------------------------------- */
-#define BLANK_TASK_HANDLES {NULL, NULL, U_ERROR_COMMON_UNKNOWN}
+#define BLANK_TASK_HANDLES {NULL, NULL, U_ERROR_COMMON_UNKNOWN, NULL, NULL, NULL}
+
+/// The loop stack size for openTaskQueue() of a task which has no task loop
+#define TASK_NO_LOOP 0
+
+/// The largest event queue message which can be handled in the task thread
+#define TASK_QUEUE_MAX_MSG_SIZE 64
 
 #define EXIT_ON_FAILURE(x)      result = x(); if (result < 0) return result
 #define CLEANUP_ON_ERROR(x)     if (errorCode == 0)     \
@@ -42,9 +48,9 @@
 
 #define TASK_INITIALISED        ((taskConfig != NULL) && taskConfig->initialised)
 
-#define TASK_IS_RUNNING         isMutexLocked(TASK_MUTEX)
+#define TASK_IS_RUNNING         isTaskRunning(taskConfig)
 
-#define CREATE_TOPIC_NAME       snprintf(topicName, MAX_TOPIC_NAME_SIZE, "%s/%s", (const char *)gSerialNumber, TASK_NAME)
+#define REGISTER_TASK_TOPIC     taskTopic = registerPublishTopic(TASK_NAME)
 
 #define EXIT_IF_CANT_RUN_TASK   if (taskConfig == NULL || !TASK_INITIALISED) {                          \
                                     writeWarn("%s task is not initialised yet, not starting.",          \
@@ -73,6 +79,7 @@
                                     return U_ERROR_COMMON_NOT_INITIALISED;                              \
                                 }                                                                       \
                                 exitTask = true;                                                        \
+                                requestTaskStop(taskConfig);                                            \
                                 writeLog("Stop %s task requested...", taskConfig->name);                \
                                 return U_ERROR_COMMON_SUCCESS;
 
@@ -83,17 +90,32 @@
                                 }                                                                       \
                                 return errorCode;
 
-#define RUN_FUNC(func, stackSize, priority)                                                             \
-                                uPortTaskHandle_t taskHandle;                                           \
-                                int32_t errorCode = uPortTaskCreate(runTaskAndDelete, TASK_NAME,        \
-                                            stackSize, func, priority, &taskHandle);                    \
+#define RUN_FUNC(func, priority)                                                                        \
+                                int32_t errorCode = submitWorkerJob(TASK_NAME, func, NULL, priority);   \
                                 if (errorCode < 0) {                                                    \
-                                    writeError("Failed to start %s task function: %d",                  \
-                                            TASK_NAME, errorCode); }
+                                    writeError("Failed to queue %s task function: %d",                  \
+                                            TASK_NAME, errorCode);                                      \
+                                    publishTaskJobFailure(taskConfig, taskTopic, errorCode);            \
+                                }                                                                       \
+                                return errorCode;
+
+// A worker job leaves straight away if the task is already busy, instead
+// of keeping the worker waiting for the task's mutex. Like U_PORT_MUTEX_LOCK
+// this opens a block, which U_PORT_MUTEX_UNLOCK closes.
+#define TRY_LOCK_TASK_JOB       if (uPortMutexTryLock(TASK_MUTEX, 0) != 0) {                            \
+                                    writeWarn("%s task is busy, not running its job", TASK_NAME);       \
+                                    publishTaskJobFailure(taskConfig, taskTopic,                        \
+                                            U_ERROR_COMMON_BUSY);                                       \
+                                    return;                                                             \
+                                }                                                                       \
+                                {
 
+// A loop which was stopped with STOP_TASK can be started again, so the
+// task's exit flag is cleared first.
 #define START_TASK_LOOP(stackSize, priority)                                                            \
-                                int32_t errorCode = uPortTaskCreate(runTaskAndDelete, TASK_NAME,        \
-                                            stackSize, taskLoop, priority, &TASK_HANDLE);               \
+                                exitTask = false;                                                       \
+                                int32_t errorCode = startTaskLoop(taskConfig, taskLoop,                 \
+                                            stackSize, priority);                                       \
                                 if (errorCode != 0) {                                                   \
                                     writeError("Failed to start the %s Task (%d).",                     \
                                             TASK_NAME, errorCode);                                      \
@@ -105,21 +127,41 @@
                                         writeDebug("Running %s task stopped callback...", TASK_NAME);   \
                                         taskConfig->taskStoppedCallback(NULL);                          \
                                 }                                                                       \
-                                TASK_HANDLE = NULL;
+                                cancelScheduledRun(taskConfig->scheduledJob);                           \
+                                atomic_set(&taskConfig->heartbeat, 0);                                  \
+                                TASK_HANDLE = NULL;                                                     \
+                                setTaskState(taskConfig, TASK_STATE_STOPPED);
 
 /* ----------------------------------------------------------------
  * PUBLIC TYPE DEFINITIONS
  * -------------------------------------------------------------- */
+/// @brief The lifecycle state of a task's loop, or of its job for the
+///        tasks which only run a job when requested
+typedef enum {
+    TASK_STATE_INIT,        // not started yet
+    TASK_STATE_RUNNING,
+    TASK_STATE_STOPPING,    // asked to stop, but still running
+    TASK_STATE_STOPPED
+} taskState_t;
 
 typedef struct TaskHandles {
     uPortTaskHandle_t taskHandle;
     uPortMutexHandle_t mutexHandle;
     int32_t eventQueueHandle;
+    uPortSemaphoreHandle_t dwellSemaphoreHandle;
+
+    /// @brief The queue and thread for TASK_SINGLE_THREAD, where the event
+    ///        queue messages are handled in the task's thread
+    uPortQueueHandle_t queueHandle;
+    uPortTaskHandle_t threadHandle;
 } taskHandles_t;
 
 /// Callback for setting what happens after the task has stopped
 typedef void (*taskStoppedCallback_t)(void *);
 
+/// Handler of the task's event queue messages
+typedef void (*taskQueueHandler_t)(void *pParam, size_t paramLengthBytes);
+
 typedef struct TaskConfig {
     /// @brief The task ID which is taken from the task list enum
     taskTypeId_t id;
@@ -138,11 +180,29 @@ typedef struct TaskConfig {
 
     /// @brief callback function for when the appTask's loop has stopped.
     taskStoppedCallback_t taskStoppedCallback;
+
+    /// @brief The taskState_t of the appTask, only set through setTaskState()
+    atomic_t state;
+
+    /// @brief The event queue message handler and message size, when the
+    ///        messages are handled in the task's thread
+    taskQueueHandler_t queueHandler;
+    size_t queueMsgSize;
+
+    /// @brief The task loop for the task's thread to run next
+    void (*pendingLoop)(void *);
+
+    /// @brief The scheduler job which plans the dwells of the task loop
+    int32_t scheduledJob;
+
+    /// @brief The time of the task loop's last heartbeat, or zero if the
+    ///        loop isn't supervised, only set through taskHeartbeat()
+    atomic_t heartbeat;
 } taskConfig_t;
 
 typedef int32_t (*taskInit_t)(taskConfig_t *taskConfig);
-typedef int32_t (*taskStart_t)(commandParamsList_t *params);
-typedef int32_t (*taskStop_t)(commandParamsList_t *params);
+typedef int32_t (*taskStart_t)(commandParams_t *params);
+typedef int32_t (*taskStop_t)(commandParams_t *params);
 typedef int32_t (*taskFinialize_t)(void);
 
 typedef struct TaskRunner {
@@ -163,12 +223,28 @@ typedef struct TaskRunner {
 
     /// @brief Contains the configuration for the appTask (see above)
     taskConfig_t config;
+
+    /// @brief The commands of the appTask's "<name>Control" topic, which
+    ///        is subscribed to when the appTask is registered, or NULL
+    callbackCommand_t *controlCommands;
+    int32_t numControlCommands;
 } taskRunner_t;
 
 /* ----------------------------------------------------------------
  * PUBLIC FUNCTIONS
  * -------------------------------------------------------------- */
-int32_t initTasks();
+/// @brief Adds a task to the application, and subscribes its control
+///        topic. The task isn't initialised until it is first started, or
+///        first sent a message or command, so a task which is never used
+///        has no threads or queues.
+/// @param pRunner The task runner of the task, which must stay in scope
+/// @return 0 on success, U_ERROR_COMMON_BUSY if another task has the same
+///         ID, or negative on another failure
+int32_t registerTask(taskRunner_t *pRunner);
+
+/// @brief Initialises a registered task, if it hasn't been already
+/// @param id The ID of the task to initialise
+/// @return 0 on success, negative on failure
 int32_t initSingleTask(taskTypeId_t id);
 
 /// @brief Runs a appTask from it's start function in its taskConfig
@@ -177,10 +253,106 @@ int32_t initSingleTask(taskTypeId_t id);
 /// @return 0 if successful, or negative for failure.
 int32_t runTask(taskTypeId_t id, bool (*waitForFunc)(void));
 
-void dwellTask(taskConfig_t *taskConfig, bool (*exitFunc)(void));
-
-void stopAndWait(taskTypeId_t id);
-void waitForAllTasksToStop(void);
+/// @brief Opens the event queue of a task. With TASK_SINGLE_THREAD defined
+///        a task with a loop gets one thread, which handles the queue
+///        messages and runs the loop, instead of a thread for each.
+/// @param taskConfig The task configuration of the task
+/// @param handler The handler of the event queue messages
+/// @param msgSize The size of the event queue messages
+/// @param queueStackSize The stack size of the event queue thread
+/// @param loopStackSize The stack size of the task loop, or TASK_NO_LOOP
+/// @param priority The priority of the event queue thread
+/// @param queueLength The number of messages the queue can hold
+/// @return The event queue handle, zero for the queue of a single thread
+///         task, or negative on failure
+int32_t openTaskQueue(taskConfig_t *taskConfig, taskQueueHandler_t handler, size_t msgSize,
+                      size_t queueStackSize, size_t loopStackSize, int32_t priority, size_t queueLength);
+
+/// @brief Starts the task loop, in a new thread or in the task's own thread
+/// @param taskConfig The task configuration of the task
+/// @param loop The task loop function
+/// @param stackSize The stack size of a new thread for the loop
+/// @param priority The priority of a new thread for the loop
+/// @return 0 on success, negative on failure
+int32_t startTaskLoop(taskConfig_t *taskConfig, void (*loop)(void *), size_t stackSize, int32_t priority);
+
+/// @brief Handles the event queue messages waiting for a single thread task.
+///        Task loops which don't use dwellTask() need to call this.
+/// @param taskConfig The task configuration of the task
+/// @return The number of messages handled
+size_t handleTaskMessages(taskConfig_t *taskConfig);
+
+/// @brief Waits for the task's dwell time, or until the task is woken up
+///        while it dwells. It always blocks for a short time, even if
+///        canDoDwell() returns false, so a task loop can't spin.
+/// @param taskConfig The task configuration that holds the dwell time
+/// @param canDoDwell Returns false when the task should stop dwelling
+void dwellTask(taskConfig_t *taskConfig, bool (*canDoDwell)(void));
+
+/// @brief Wakes up a task which is dwelling, so it runs its loop straight away
+/// @param taskConfig The task configuration of the task to wake up
+void wakeTask(taskConfig_t *taskConfig);
+
+/// @brief Wakes up all the dwelling tasks, such as when the application is exiting
+void wakeAllTasks(void);
+
+/// @brief Checks in with the supervisor, to show the task loop is still
+///        running. dwellTask() does this, so only a loop which blocks
+///        outside of it needs to call this.
+/// @param taskConfig The task configuration of the task
+void taskHeartbeat(taskConfig_t *taskConfig);
+
+/// @brief Publishes that a job of a task couldn't be run, as the
+///        request to run it has already been acknowledged
+/// @param taskConfig The task configuration of the task
+/// @param topic The task's topic handle, from registerPublishTopic()
+/// @param errorCode The reason the job couldn't be run
+void publishTaskJobFailure(taskConfig_t *taskConfig, int32_t topic, int32_t errorCode);
+
+/// @brief Gets the task runner of a task
+/// @param id The ID of the task
+/// @return The task runner, or NULL if there is no task with the ID
+taskRunner_t *getTaskRunner(taskTypeId_t id);
+
+/// @brief Sets the lifecycle state of a task, waking up anything waiting for it
+/// @param taskConfig The task configuration of the task
+/// @param state The new state of the task
+void setTaskState(taskConfig_t *taskConfig, taskState_t state);
+
+/// @brief Moves a running task to the stopping state and wakes it up
+/// @param taskConfig The task configuration of the task
+void requestTaskStop(taskConfig_t *taskConfig);
+
+/// @brief Checks if a task is running, including if it is stopping
+/// @param taskConfig The task configuration of the task
+/// @return true if the task is running
+bool isTaskRunning(taskConfig_t *taskConfig);
+
+/// @brief Waits for a task to reach a state. Waiting for TASK_STATE_STOPPED
+///        also returns if the task has never been started.
+/// @param id The ID of the task
+/// @param state The state to wait for
+/// @param timeoutMs The time to wait for, or negative to wait forever
+/// @return 0 if the task is in the state, U_ERROR_COMMON_TIMEOUT if it
+///         didn't reach it in time, or negative on another failure
+int32_t waitForTaskState(taskTypeId_t id, taskState_t state, int32_t timeoutMs);
+
+/// @brief Stops a task and waits for it to stop
+/// @param id The ID of the task
+/// @param deadlineMs The time to wait for the task to stop
+/// @return true if the task has stopped, false otherwise
+bool stopAndWait(taskTypeId_t id, int32_t deadlineMs);
+
+/// @brief Gets the ID of a task from its name
+/// @param pName The name of the task
+/// @return The task ID, or negative if there is no task with that name
+int32_t getTaskIdByName(const char *pName);
+/// @brief Waits for the tasks, which aren't stopped on their own, to stop
+///        after the application has been told to exit
+/// @param deadlineMs The time to wait for the tasks to stop. Tasks still
+///                   running after this are left, and not finalized.
+/// @return true if all the tasks have stopped, false otherwise
+bool waitForAllTasksToStop(int32_t deadlineMs);
 
 /// @brief Finalize all the tasks, called at the end of the application 
 int32_t finalizeAllTasks(void);
@@ -0,0 +1,262 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *
+ * Task supervisor. Watches the heartbeats of the task loops, and recovers
+ * a task which has stopped checking in: first by restarting the task, then
+ * by power cycling the cellular module, and finally by resetting the system.
+ *
+ */
+
+#include <sys/reboot.h>
+
+#include "common.h"
+#include "taskControl.h"
+#include "taskSupervisor.h"
+#include "registrationTask.h"
+#include "cellInit.h"
+
+/* ----------------------------------------------------------------
+ * DEFINITIONS
+ * -------------------------------------------------------------- */
+#define SUPERVISOR_STACK_SIZE       (2 * 1024)
+#define SUPERVISOR_PRIORITY         4
+
+// how long a task is given to stop before its module is power cycled
+#define SUPERVISOR_HOLD_DEADLINE_MS (5 * 1000)
+
+// marks the reset counter as valid after a warm reset
+#define SUPERVISOR_RESET_MAGIC      0x53555056
+
+/* ----------------------------------------------------------------
+ * TYPE DEFINITIONS
+ * -------------------------------------------------------------- */
+typedef struct {
+    recoveryStep_t step;
+
+    /// @brief The heartbeat which was missed, so a new one shows recovery
+    uint32_t missedHeartbeat;
+    int64_t missedTimeMs;
+    int64_t stepTimeMs;
+
+    /// @brief The task has been asked to stop, and is started again once
+    ///        it has stopped
+    bool restartPending;
+} taskRecovery_t;
+
+/* ----------------------------------------------------------------
+ * STATIC VARIABLES
+ * -------------------------------------------------------------- */
+static taskRecovery_t recovery[MAX_TASKS];
+
+// the metrics are read by the Monitor task
+K_MUTEX_DEFINE(metricsMutex);
+static supervisorMetrics_t metrics;
+
+// kept over a warm reset, so the resets by the supervisor can be counted
+static __noinit uint32_t resetMagic;
+static __noinit uint32_t resetCount;
+
+static const char *stepNames[] = {"None", "Restart task", "Power cycle module", "System reset"};
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+static void countMetric(uint32_t *pCount)
+{
+    k_mutex_lock(&metricsMutex, K_FOREVER);
+    (*pCount)++;
+    k_mutex_unlock(&metricsMutex);
+}
+
+/// @brief Checks if a task can be stopped and started again. The MQTT task
+///        closes its client and frees its subscriptions when its loop
+///        exits, so it is recovered by power cycling the module instead.
+static bool canRestartTask(taskRunner_t *runner)
+{
+    return runner->stopFunc != NULL && runner->startFunc != NULL &&
+            runner->config.id != MQTT_TASK;
+}
+
+static int32_t getHeartbeatDeadlineMs(taskConfig_t *taskConfig)
+{
+    int32_t deadlineMs = SUPERVISOR_HEARTBEAT_DEADLINE_MS;
+    if (taskConfig->taskLoopDwellTime > 0)
+        deadlineMs += taskConfig->taskLoopDwellTime * 1000;
+
+    return deadlineMs;
+}
+
+static void takeRecoveryStep(taskRunner_t *runner, taskRecovery_t *pRecovery, recoveryStep_t step)
+{
+    taskConfig_t *taskConfig = &runner->config;
+
+    pRecovery->step = step;
+    pRecovery->stepTimeMs = getMonotonicTimeMs();
+    writeWarn("Supervisor recovering %s task: %s", taskConfig->name, stepNames[step]);
+
+    switch(step) {
+        case RECOVERY_RESTART_TASK:
+            if (!canRestartTask(runner)) {
+                writeWarn("%s task can't be restarted", taskConfig->name);
+                takeRecoveryStep(runner, pRecovery, RECOVERY_POWER_CYCLE_MODULE);
+                break;
+            }
+
+            countMetric(&metrics.taskRestarts);
+            pRecovery->restartPending = true;
+            runner->stopFunc(NULL);
+            break;
+
+        case RECOVERY_POWER_CYCLE_MODULE:
+            // a loop is most likely stuck waiting on the module. It is held
+            // stopped first, so the call the power cycle frees ends its loop
+            // instead of carrying on with the old module state, and it is
+            // started again once the module is back
+            countMetric(&metrics.modulePowerCycles);
+            if (canRestartTask(runner)) {
+                pRecovery->restartPending = true;
+                if (!stopAndWait(taskConfig->id, SUPERVISOR_HOLD_DEADLINE_MS))
+                    writeWarn("%s task has not stopped, power cycling the module under it", taskConfig->name);
+            }
+
+            if (powerCycleCellularModule() == 0)
+                restartNetworkRegistration();
+            break;
+
+        case RECOVERY_SYSTEM_RESET:
+            resetCount++;
+            writeFatal("%s task has not recovered, resetting the system (reset #%d)",
+                    taskConfig->name, resetCount);
+            uPortTaskBlock(1000);
+            sys_reboot(SYS_REBOOT_COLD);
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void recoveredTask(taskConfig_t *taskConfig, taskRecovery_t *pRecovery)
+{
+    int64_t recoveryMs = getMonotonicTimeMs() - pRecovery->missedTimeMs;
+
+    k_mutex_lock(&metricsMutex, K_FOREVER);
+    metrics.recoveries++;
+    metrics.totalRecoveryMs += recoveryMs;
+    metrics.meanRecoveryMs = (int32_t)(metrics.totalRecoveryMs / metrics.recoveries);
+    int32_t meanRecoveryMs = metrics.meanRecoveryMs;
+    k_mutex_unlock(&metricsMutex);
+
+    writeInfo("%s task recovered after %d ms (%s), mean time to recover is %d ms",
+            taskConfig->name, (int32_t)recoveryMs, stepNames[pRecovery->step],
+            meanRecoveryMs);
+
+    memset(pRecovery, 0, sizeof(taskRecovery_t));
+}
+
+static void superviseTask(taskRunner_t *runner, taskRecovery_t *pRecovery)
+{
+    taskConfig_t *taskConfig = &runner->config;
+    uint32_t heartbeat = (uint32_t)atomic_get(&taskConfig->heartbeat);
+
+    if (pRecovery->step == RECOVERY_NONE) {
+        if (!isTaskRunning(taskConfig) || heartbeat == 0)
+            return;
+
+        int32_t ageMs = (int32_t)((uint32_t)getMonotonicTimeMs() - heartbeat);
+        if (ageMs <= getHeartbeatDeadlineMs(taskConfig))
+            return;
+
+        countMetric(&metrics.missedHeartbeats);
+        writeError("%s task missed its heartbeat, last seen %d ms ago", taskConfig->name, ageMs);
+
+        pRecovery->missedHeartbeat = heartbeat;
+        pRecovery->missedTimeMs = getMonotonicTimeMs();
+        takeRecoveryStep(runner, pRecovery, RECOVERY_RESTART_TASK);
+        return;
+    }
+
+    // a stuck task may only stop once a later step has freed it
+    if (pRecovery->restartPending && !isTaskRunning(taskConfig)) {
+        pRecovery->restartPending = false;
+        writeInfo("Supervisor starting %s task again", taskConfig->name);
+        runner->startFunc(NULL);
+    }
+
+    if (heartbeat != 0 && heartbeat != pRecovery->missedHeartbeat) {
+        recoveredTask(taskConfig, pRecovery);
+        return;
+    }
+
+    if (getMonotonicTimeMs() - pRecovery->stepTimeMs > SUPERVISOR_ESCALATION_MS &&
+            pRecovery->step < RECOVERY_SYSTEM_RESET)
+        takeRecoveryStep(runner, pRecovery, pRecovery->step + 1);
+}
+
+static void supervisorLoop(void *pParameters)
+{
+    while(!gExitApp) {
+        waitForEvent(EVENT_EXIT_REQUESTED, SUPERVISOR_CHECK_INTERVAL_MS);
+        if (gExitApp) break;
+
+        for(int32_t id=0; id<MAX_TASKS; id++) {
+            taskRunner_t *runner = getTaskRunner((taskTypeId_t)id);
+            if (runner != NULL && runner->config.initialised)
+                superviseTask(runner, &recovery[id]);
+        }
+    }
+
+    writeDebug("Task supervisor has stopped");
+    uPortTaskDelete(NULL);
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+int32_t startTaskSupervisor(void)
+{
+    if (resetMagic != SUPERVISOR_RESET_MAGIC) {
+        resetMagic = SUPERVISOR_RESET_MAGIC;
+        resetCount = 0;
+    }
+
+    k_mutex_lock(&metricsMutex, K_FOREVER);
+    metrics.systemResets = resetCount;
+    k_mutex_unlock(&metricsMutex);
+
+    if (resetCount > 0)
+        writeWarn("The task supervisor has reset the system %d times", resetCount);
+
+    uPortTaskHandle_t taskHandle;
+    int32_t errorCode = uPortTaskCreate(supervisorLoop, "Supervisor", SUPERVISOR_STACK_SIZE,
+                                        NULL, SUPERVISOR_PRIORITY, &taskHandle);
+    if (errorCode != 0) {
+        writeError("Failed to start the task supervisor: %d", errorCode);
+        return errorCode;
+    }
+
+    return U_ERROR_COMMON_SUCCESS;
+}
+
+void getSupervisorMetrics(supervisorMetrics_t *pMetrics)
+{
+    k_mutex_lock(&metricsMutex, K_FOREVER);
+    *pMetrics = metrics;
+    k_mutex_unlock(&metricsMutex);
+}
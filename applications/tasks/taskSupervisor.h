@@ -0,0 +1,79 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ *
+ * Task supervisor header
+ *
+ */
+
+#ifndef _TASK_SUPERVISOR_H_
+#define _TASK_SUPERVISOR_H_
+
+#include <stdint.h>
+
+/* ----------------------------------------------------------------
+ * DEFINITIONS
+ * -------------------------------------------------------------- */
+/// How often the task heartbeats are checked
+#define SUPERVISOR_CHECK_INTERVAL_MS    (10 * 1000)
+
+/// How long a task loop can run between heartbeats, not counting its
+/// dwell time. This is longer than the longest ubxlib operation.
+#define SUPERVISOR_HEARTBEAT_DEADLINE_MS (5 * 60 * 1000)
+
+/// How long a recovery step has for the task to heartbeat again, before
+/// the next step is taken
+#define SUPERVISOR_ESCALATION_MS        (2 * 60 * 1000)
+
+/* ----------------------------------------------------------------
+ * PUBLIC TYPE DEFINITIONS
+ * -------------------------------------------------------------- */
+/// @brief The recovery steps for a task which has missed its heartbeat
+typedef enum {
+    RECOVERY_NONE,
+    RECOVERY_RESTART_TASK,
+    RECOVERY_POWER_CYCLE_MODULE,
+    RECOVERY_SYSTEM_RESET
+} recoveryStep_t;
+
+/// @brief The supervisor metrics
+typedef struct {
+    uint32_t missedHeartbeats;
+    uint32_t taskRestarts;
+    uint32_t modulePowerCycles;
+
+    /// @brief The system resets by the supervisor, kept over the resets
+    uint32_t systemResets;
+
+    uint32_t recoveries;
+    int64_t totalRecoveryMs;
+    int32_t meanRecoveryMs;
+} supervisorMetrics_t;
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+/// @brief Starts the supervisor thread, which checks the heartbeats of the
+///        task loops and recovers the tasks which miss them
+/// @return 0 on success, negative on failure
+int32_t startTaskSupervisor(void);
+
+/// @brief Gets the supervisor metrics
+/// @param pMetrics The metrics structure to fill in
+void getSupervisorMetrics(supervisorMetrics_t *pMetrics);
+
+#endif
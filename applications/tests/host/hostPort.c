@@ -0,0 +1,328 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *
+ * The Zephyr kernel and ubxlib port functions for the host tests, on
+ * POSIX threads. Only what the application modules under test use is
+ * here, the queues aren't supported.
+ *
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+
+#include "kernel.h"
+#include "ubxlib.h"
+
+/* ----------------------------------------------------------------
+ * TYPE DEFINITIONS
+ * -------------------------------------------------------------- */
+typedef struct {
+    void (*pFunction)(void *);
+    void *pParameter;
+} hostTask_t;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t given;
+    uint32_t count;
+    uint32_t limit;
+} hostSemaphore_t;
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+static struct timespec getEndTime(int64_t timeoutMs)
+{
+    struct timespec endTime;
+    clock_gettime(CLOCK_REALTIME, &endTime);
+
+    endTime.tv_sec += timeoutMs / 1000;
+    endTime.tv_nsec += (timeoutMs % 1000) * 1000000;
+    if (endTime.tv_nsec >= 1000000000) {
+        endTime.tv_sec++;
+        endTime.tv_nsec -= 1000000000;
+    }
+
+    return endTime;
+}
+
+static void *runHostTask(void *pParam)
+{
+    hostTask_t task = *(hostTask_t *)pParam;
+    free(pParam);
+
+    task.pFunction(task.pParameter);
+    return NULL;
+}
+
+/* ----------------------------------------------------------------
+ * KERNEL FUNCTIONS
+ * -------------------------------------------------------------- */
+k_spinlock_key_t k_spin_lock(struct k_spinlock *l)
+{
+    while (__atomic_test_and_set(&l->locked, __ATOMIC_ACQUIRE))
+        sched_yield();
+
+    return (k_spinlock_key_t){0};
+}
+
+void k_spin_unlock(struct k_spinlock *l, k_spinlock_key_t key)
+{
+    ARG_UNUSED(key);
+    __atomic_clear(&l->locked, __ATOMIC_RELEASE);
+}
+
+int k_mutex_lock(struct k_mutex *mutex, k_timeout_t timeout)
+{
+    if (timeout.ms < 0)
+        return pthread_mutex_lock(&mutex->mutex) == 0 ? 0 : -EINVAL;
+
+    struct timespec endTime = getEndTime(timeout.ms);
+    return pthread_mutex_timedlock(&mutex->mutex, &endTime) == 0 ? 0 : -EAGAIN;
+}
+
+int k_mutex_unlock(struct k_mutex *mutex)
+{
+    return pthread_mutex_unlock(&mutex->mutex) == 0 ? 0 : -EPERM;
+}
+
+int k_condvar_wait(struct k_condvar *condvar, struct k_mutex *mutex, k_timeout_t timeout)
+{
+    if (timeout.ms < 0)
+        return pthread_cond_wait(&condvar->cond, &mutex->mutex) == 0 ? 0 : -EINVAL;
+
+    struct timespec endTime = getEndTime(timeout.ms);
+    return pthread_cond_timedwait(&condvar->cond, &mutex->mutex, &endTime) == 0 ? 0 : -EAGAIN;
+}
+
+int k_condvar_signal(struct k_condvar *condvar)
+{
+    return pthread_cond_signal(&condvar->cond);
+}
+
+int k_condvar_broadcast(struct k_condvar *condvar)
+{
+    return pthread_cond_broadcast(&condvar->cond);
+}
+
+int64_t k_uptime_get(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+uint32_t k_uptime_get_32(void)
+{
+    return (uint32_t)k_uptime_get();
+}
+
+/* ----------------------------------------------------------------
+ * UBXLIB PORT FUNCTIONS
+ * -------------------------------------------------------------- */
+int32_t uPortTaskCreate(void (*pFunction)(void *), const char *pName, size_t stackSizeBytes,
+                        void *pParameter, int32_t priority, uPortTaskHandle_t *pTaskHandle)
+{
+    hostTask_t *pTask = malloc(sizeof(hostTask_t));
+    if (pTask == NULL)
+        return U_ERROR_COMMON_NO_MEMORY;
+
+    pTask->pFunction = pFunction;
+    pTask->pParameter = pParameter;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, runHostTask, pTask) != 0) {
+        free(pTask);
+        return U_ERROR_COMMON_PLATFORM;
+    }
+
+    pthread_detach(thread);
+    *pTaskHandle = (uPortTaskHandle_t)thread;
+
+    return U_ERROR_COMMON_SUCCESS;
+}
+
+int32_t uPortTaskDelete(const uPortTaskHandle_t taskHandle)
+{
+    // only a task deleting itself is supported
+    if (taskHandle != NULL)
+        return U_ERROR_COMMON_NOT_SUPPORTED;
+
+    pthread_exit(NULL);
+}
+
+void uPortTaskBlock(int32_t delayMs)
+{
+    struct timespec delay = {delayMs / 1000, (delayMs % 1000) * 1000000L};
+    nanosleep(&delay, NULL);
+}
+
+int32_t uPortGetTickTimeMs(void)
+{
+    return (int32_t)k_uptime_get();
+}
+
+int32_t uPortMutexCreate(uPortMutexHandle_t *pMutexHandle)
+{
+    pthread_mutex_t *pMutex = malloc(sizeof(pthread_mutex_t));
+    if (pMutex == NULL)
+        return U_ERROR_COMMON_NO_MEMORY;
+
+    pthread_mutex_init(pMutex, NULL);
+    *pMutexHandle = pMutex;
+
+    return U_ERROR_COMMON_SUCCESS;
+}
+
+int32_t uPortMutexDelete(const uPortMutexHandle_t mutexHandle)
+{
+    pthread_mutex_destroy((pthread_mutex_t *)mutexHandle);
+    free(mutexHandle);
+
+    return U_ERROR_COMMON_SUCCESS;
+}
+
+int32_t uPortMutexLock(const uPortMutexHandle_t mutexHandle)
+{
+    return pthread_mutex_lock((pthread_mutex_t *)mutexHandle) == 0 ?
+                U_ERROR_COMMON_SUCCESS : U_ERROR_COMMON_PLATFORM;
+}
+
+int32_t uPortMutexTryLock(const uPortMutexHandle_t mutexHandle, int32_t delayMs)
+{
+    struct timespec endTime = getEndTime(delayMs);
+    return pthread_mutex_timedlock((pthread_mutex_t *)mutexHandle, &endTime) == 0 ?
+                U_ERROR_COMMON_SUCCESS : U_ERROR_COMMON_TIMEOUT;
+}
+
+int32_t uPortMutexUnlock(const uPortMutexHandle_t mutexHandle)
+{
+    return pthread_mutex_unlock((pthread_mutex_t *)mutexHandle) == 0 ?
+                U_ERROR_COMMON_SUCCESS : U_ERROR_COMMON_PLATFORM;
+}
+
+int32_t uPortSemaphoreCreate(uPortSemaphoreHandle_t *pSemaphoreHandle, uint32_t initialCount, uint32_t limit)
+{
+    hostSemaphore_t *pSemaphore = malloc(sizeof(hostSemaphore_t));
+    if (pSemaphore == NULL)
+        return U_ERROR_COMMON_NO_MEMORY;
+
+    pthread_mutex_init(&pSemaphore->mutex, NULL);
+    pthread_cond_init(&pSemaphore->given, NULL);
+    pSemaphore->count = initialCount;
+    pSemaphore->limit = limit;
+    *pSemaphoreHandle = pSemaphore;
+
+    return U_ERROR_COMMON_SUCCESS;
+}
+
+int32_t uPortSemaphoreDelete(const uPortSemaphoreHandle_t semaphoreHandle)
+{
+    hostSemaphore_t *pSemaphore = (hostSemaphore_t *)semaphoreHandle;
+    pthread_cond_destroy(&pSemaphore->given);
+    pthread_mutex_destroy(&pSemaphore->mutex);
+    free(pSemaphore);
+
+    return U_ERROR_COMMON_SUCCESS;
+}
+
+int32_t uPortSemaphoreTryTake(const uPortSemaphoreHandle_t semaphoreHandle, int32_t delayMs)
+{
+    hostSemaphore_t *pSemaphore = (hostSemaphore_t *)semaphoreHandle;
+    struct timespec endTime = getEndTime(delayMs);
+    int32_t errorCode = U_ERROR_COMMON_SUCCESS;
+
+    pthread_mutex_lock(&pSemaphore->mutex);
+    while (pSemaphore->count == 0 && errorCode == U_ERROR_COMMON_SUCCESS) {
+        if (delayMs < 0)
+            pthread_cond_wait(&pSemaphore->given, &pSemaphore->mutex);
+        else if (pthread_cond_timedwait(&pSemaphore->given, &pSemaphore->mutex, &endTime) == ETIMEDOUT)
+            errorCode = U_ERROR_COMMON_TIMEOUT;
+    }
+
+    if (pSemaphore->count > 0) {
+        pSemaphore->count--;
+        errorCode = U_ERROR_COMMON_SUCCESS;
+    }
+    pthread_mutex_unlock(&pSemaphore->mutex);
+
+    return errorCode;
+}
+
+int32_t uPortSemaphoreTake(const uPortSemaphoreHandle_t semaphoreHandle)
+{
+    return uPortSemaphoreTryTake(semaphoreHandle, -1);
+}
+
+int32_t uPortSemaphoreGive(const uPortSemaphoreHandle_t semaphoreHandle)
+{
+    hostSemaphore_t *pSemaphore = (hostSemaphore_t *)semaphoreHandle;
+
+    pthread_mutex_lock(&pSemaphore->mutex);
+    if (pSemaphore->count < pSemaphore->limit)
+        pSemaphore->count++;
+    pthread_cond_signal(&pSemaphore->given);
+    pthread_mutex_unlock(&pSemaphore->mutex);
+
+    return U_ERROR_COMMON_SUCCESS;
+}
+
+int32_t uPortQueueCreate(size_t queueLength, size_t itemSizeBytes, uPortQueueHandle_t *pQueueHandle)
+{
+    return U_ERROR_COMMON_NOT_SUPPORTED;
+}
+
+int32_t uPortQueueDelete(const uPortQueueHandle_t queueHandle)
+{
+    return U_ERROR_COMMON_NOT_SUPPORTED;
+}
+
+int32_t uPortQueueSendIrq(const uPortQueueHandle_t queueHandle, const void *pEventData)
+{
+    return U_ERROR_COMMON_NOT_SUPPORTED;
+}
+
+int32_t uPortQueueTryReceive(const uPortQueueHandle_t queueHandle, int32_t waitMs, void *pEventData)
+{
+    return U_ERROR_COMMON_NOT_SUPPORTED;
+}
+
+int32_t uPortEventQueueOpen(void (*pFunction)(void *, size_t), const char *pName, size_t parameterLengthBytes,
+                            size_t stackSizeBytes, int32_t priority, size_t queueLength)
+{
+    return U_ERROR_COMMON_NOT_SUPPORTED;
+}
+
+int32_t uPortEventQueueSendIrq(int32_t handle, const void *pParam, size_t paramLengthBytes)
+{
+    return U_ERROR_COMMON_NOT_SUPPORTED;
+}
+
+void *pUPortMalloc(size_t sizeBytes)
+{
+    return malloc(sizeBytes);
+}
+
+void uPortFree(void *pMemory)
+{
+    free(pMemory);
+}
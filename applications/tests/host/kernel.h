@@ -0,0 +1,120 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *
+ * The Zephyr kernel functions the application modules use, for the host
+ * tests, on POSIX threads
+ *
+ */
+
+#ifndef _HOST_KERNEL_H_
+#define _HOST_KERNEL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+/* ----------------------------------------------------------------
+ * DEFINITIONS
+ * -------------------------------------------------------------- */
+#define ARG_UNUSED(x)           (void)(x)
+#define __noinit
+
+#define K_FOREVER               ((k_timeout_t){-1})
+#define K_NO_WAIT               ((k_timeout_t){0})
+#define K_MSEC(ms)              ((k_timeout_t){(ms)})
+
+// a Zephyr mutex can be locked again by the thread which holds it
+#define K_MUTEX_DEFINE(name)    struct k_mutex name = {PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP}
+#define K_CONDVAR_DEFINE(name)  struct k_condvar name = {PTHREAD_COND_INITIALIZER}
+
+/* ----------------------------------------------------------------
+ * PUBLIC TYPE DEFINITIONS
+ * -------------------------------------------------------------- */
+typedef long atomic_t;
+typedef long atomic_val_t;
+
+typedef struct {
+    int64_t ms;
+} k_timeout_t;
+
+struct k_mutex {
+    pthread_mutex_t mutex;
+};
+
+struct k_condvar {
+    pthread_cond_t cond;
+};
+
+struct k_spinlock {
+    bool locked;
+};
+
+typedef struct {
+    int key;
+} k_spinlock_key_t;
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+static inline atomic_val_t atomic_get(const atomic_t *target)
+{
+    return __atomic_load_n(target, __ATOMIC_SEQ_CST);
+}
+
+static inline atomic_val_t atomic_set(atomic_t *target, atomic_val_t value)
+{
+    return __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST);
+}
+
+static inline atomic_val_t atomic_add(atomic_t *target, atomic_val_t value)
+{
+    return __atomic_fetch_add(target, value, __ATOMIC_SEQ_CST);
+}
+
+static inline atomic_val_t atomic_inc(atomic_t *target)
+{
+    return atomic_add(target, 1);
+}
+
+static inline bool atomic_cas(atomic_t *target, atomic_val_t oldValue, atomic_val_t newValue)
+{
+    return __atomic_compare_exchange_n(target, &oldValue, newValue, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static inline bool k_is_in_isr(void)
+{
+    return false;
+}
+
+k_spinlock_key_t k_spin_lock(struct k_spinlock *l);
+void k_spin_unlock(struct k_spinlock *l, k_spinlock_key_t key);
+
+int k_mutex_lock(struct k_mutex *mutex, k_timeout_t timeout);
+int k_mutex_unlock(struct k_mutex *mutex);
+
+int k_condvar_wait(struct k_condvar *condvar, struct k_mutex *mutex, k_timeout_t timeout);
+int k_condvar_signal(struct k_condvar *condvar);
+int k_condvar_broadcast(struct k_condvar *condvar);
+
+int64_t k_uptime_get(void);
+uint32_t k_uptime_get_32(void);
+
+#endif
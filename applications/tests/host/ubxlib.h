@@ -0,0 +1,99 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *
+ * The ubxlib types and port functions the application modules use, for
+ * the host tests. The error codes are ubxlib's own.
+ *
+ */
+
+#ifndef _HOST_UBXLIB_H_
+#define _HOST_UBXLIB_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "u_error_common.h"
+
+/* ----------------------------------------------------------------
+ * DEFINITIONS
+ * -------------------------------------------------------------- */
+#ifndef MIN
+#define MIN(a, b)   ((a) < (b) ? (a) : (b))
+#endif
+
+#ifndef MAX
+#define MAX(a, b)   ((a) > (b) ? (a) : (b))
+#endif
+
+#define U_CELL_INFO_IMEI_SIZE                           15
+#define U_PORT_EVENT_QUEUE_MIN_TASK_STACK_SIZE_BYTES    1024
+
+#define U_PORT_MUTEX_LOCK(x)    { uPortMutexLock(x)
+#define U_PORT_MUTEX_UNLOCK(x)  } uPortMutexUnlock(x)
+
+/* ----------------------------------------------------------------
+ * PUBLIC TYPE DEFINITIONS
+ * -------------------------------------------------------------- */
+typedef void *uPortTaskHandle_t;
+typedef void *uPortMutexHandle_t;
+typedef void *uPortSemaphoreHandle_t;
+typedef void *uPortQueueHandle_t;
+typedef void *uDeviceHandle_t;
+
+typedef enum {
+    U_MQTT_QOS_AT_MOST_ONCE,
+    U_MQTT_QOS_AT_LEAST_ONCE,
+    U_MQTT_QOS_EXACTLY_ONCE
+} uMqttQos_t;
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+int32_t uPortTaskCreate(void (*pFunction)(void *), const char *pName, size_t stackSizeBytes,
+                        void *pParameter, int32_t priority, uPortTaskHandle_t *pTaskHandle);
+int32_t uPortTaskDelete(const uPortTaskHandle_t taskHandle);
+void uPortTaskBlock(int32_t delayMs);
+int32_t uPortGetTickTimeMs(void);
+
+int32_t uPortMutexCreate(uPortMutexHandle_t *pMutexHandle);
+int32_t uPortMutexDelete(const uPortMutexHandle_t mutexHandle);
+int32_t uPortMutexLock(const uPortMutexHandle_t mutexHandle);
+int32_t uPortMutexTryLock(const uPortMutexHandle_t mutexHandle, int32_t delayMs);
+int32_t uPortMutexUnlock(const uPortMutexHandle_t mutexHandle);
+
+int32_t uPortSemaphoreCreate(uPortSemaphoreHandle_t *pSemaphoreHandle, uint32_t initialCount, uint32_t limit);
+int32_t uPortSemaphoreDelete(const uPortSemaphoreHandle_t semaphoreHandle);
+int32_t uPortSemaphoreTake(const uPortSemaphoreHandle_t semaphoreHandle);
+int32_t uPortSemaphoreTryTake(const uPortSemaphoreHandle_t semaphoreHandle, int32_t delayMs);
+int32_t uPortSemaphoreGive(const uPortSemaphoreHandle_t semaphoreHandle);
+
+int32_t uPortQueueCreate(size_t queueLength, size_t itemSizeBytes, uPortQueueHandle_t *pQueueHandle);
+int32_t uPortQueueDelete(const uPortQueueHandle_t queueHandle);
+int32_t uPortQueueSendIrq(const uPortQueueHandle_t queueHandle, const void *pEventData);
+int32_t uPortQueueTryReceive(const uPortQueueHandle_t queueHandle, int32_t waitMs, void *pEventData);
+
+int32_t uPortEventQueueOpen(void (*pFunction)(void *, size_t), const char *pName, size_t parameterLengthBytes,
+                            size_t stackSizeBytes, int32_t priority, size_t queueLength);
+int32_t uPortEventQueueSendIrq(int32_t handle, const void *pParam, size_t paramLengthBytes);
+
+void *pUPortMalloc(size_t sizeBytes);
+void uPortFree(void *pMemory);
+
+#endif
@@ -0,0 +1,256 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *
+ * Host test of the command parameter parser, with random input, and a
+ * benchmark of the tokens parsed per second
+ *
+ */
+
+#include <time.h>
+
+#include "common.h"
+
+/* ----------------------------------------------------------------
+ * DEFINES
+ * -------------------------------------------------------------- */
+#define CHECK(x)    check((x), #x, __LINE__)
+
+// the same delimiters as the parser
+#define TEST_DELIMITERS         " ,:"
+
+#define TEST_MESSAGE_SIZE       128
+
+// the random messages parsed, from a fixed seed so a failure repeats
+#define FUZZ_MESSAGES           100000
+#define FUZZ_SEED               20221019
+
+// the commands parsed by the benchmark
+#define BENCHMARK_COMMANDS      1000000
+
+/* ----------------------------------------------------------------
+ * STATIC VARIABLES
+ * -------------------------------------------------------------- */
+static int32_t failures = 0;
+
+/* ----------------------------------------------------------------
+ * PUBLIC VARIABLES
+ * -------------------------------------------------------------- */
+bool gExitApp = false;
+
+/* ----------------------------------------------------------------
+ * STUBS of the modules the parser uses
+ * -------------------------------------------------------------- */
+void _writeLog(const char *log, logLevels_t level, bool writeToFile, int32_t module, ...)
+{
+}
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+static void check(int passed, const char *pTest, int line)
+{
+    if (!passed) {
+        printf("FAILED line %d: %s\n", line, pTest);
+        failures++;
+    }
+}
+
+/// @brief Parses a copy of a message, as the parser writes into it
+static int32_t parse(const char *message, char *buffer, commandParams_t *params)
+{
+    strcpy(buffer, message);
+    return getParams(buffer, params);
+}
+
+static void testEmpty(void)
+{
+    char buffer[TEST_MESSAGE_SIZE];
+    commandParams_t params;
+
+    CHECK(getParams(NULL, &params) == U_ERROR_COMMON_INVALID_PARAMETER);
+    CHECK(getParamCount(&params) == 0);
+
+    CHECK(parse("", buffer, &params) == U_ERROR_COMMON_NOT_FOUND);
+    CHECK(getParamCount(&params) == 0);
+    CHECK(getParamCommand(&params) == NULL);
+
+    CHECK(parse(" ,: ,,::  ", buffer, &params) == U_ERROR_COMMON_NOT_FOUND);
+    CHECK(getParamCount(&params) == 0);
+    CHECK(getParamValue(&params, 1, 0, 100, 42) == 42);
+
+    // no parameters at all
+    CHECK(getParamCount(NULL) == 0);
+    CHECK(getParamCommand(NULL) == NULL);
+    CHECK(getParamString(NULL, 0) == NULL);
+    CHECK(getParamValue(NULL, 1, 0, 100, 42) == 42);
+}
+
+static void testTokens(void)
+{
+    char buffer[TEST_MESSAGE_SIZE];
+    commandParams_t params;
+
+    CHECK(parse("START_TASK", buffer, &params) == 1);
+    CHECK(strcmp(getParamCommand(&params), "START_TASK") == 0);
+    CHECK(getParamString(&params, 1) == NULL);
+
+    // leading, trailing and repeated delimiters of each kind
+    CHECK(parse(" ,SET_DWELL_TIME:: 30 ,,4000,", buffer, &params) == 3);
+    CHECK(strcmp(getParamCommand(&params), "SET_DWELL_TIME") == 0);
+    CHECK(strcmp(getParamString(&params, 1), "30") == 0);
+    CHECK(strcmp(getParamString(&params, 2), "4000") == 0);
+    CHECK(getParamString(&params, 3) == NULL);
+
+    // the tokens after MAX_COMMAND_PARAMS are dropped
+    CHECK(parse("CMD 1 2 3 4 5 6 7 8 9 10", buffer, &params) == MAX_COMMAND_PARAMS);
+    CHECK(getParamCount(&params) == MAX_COMMAND_PARAMS);
+    CHECK(strcmp(getParamString(&params, MAX_COMMAND_PARAMS - 1), "7") == 0);
+    CHECK(getParamString(&params, MAX_COMMAND_PARAMS) == NULL);
+    CHECK(getParamValue(&params, MAX_COMMAND_PARAMS, 0, 100, 42) == 42);
+}
+
+static void testValues(void)
+{
+    char buffer[TEST_MESSAGE_SIZE];
+    commandParams_t params;
+
+    CHECK(parse("CMD 10 -5 12abc 0x10 1e3 + 7", buffer, &params) == 8);
+    CHECK(getParamValue(&params, 1, 0, 100, 42) == 10);
+    // values from index 2 on
+    CHECK(getParamValue(&params, 2, -10, 10, 42) == -5);
+    CHECK(getParamValue(&params, 7, 0, 100, 42) == 7);
+
+    // not numbers, or not only a number, are the default
+    CHECK(getParamValue(&params, 0, 0, 100, 42) == 42);
+    CHECK(getParamValue(&params, 3, 0, 100, 42) == 42);
+    CHECK(getParamValue(&params, 4, 0, 100, 42) == 42);
+    CHECK(getParamValue(&params, 5, 0, 100, 42) == 42);
+    CHECK(getParamValue(&params, 6, 0, 100, 42) == 42);
+    CHECK(getParamValue(&params, 8, 0, 100, 42) == 42);
+
+    // out of the range is limited to the range
+    CHECK(getParamValue(&params, 1, 0, 5, 42) == 5);
+    CHECK(getParamValue(&params, 2, 0, 100, 42) == 0);
+
+    // out of the range of an int32_t, and of a long
+    CHECK(parse("CMD 2147483648 -2147483649 99999999999999999999999 -99999999999999999999999",
+                buffer, &params) == 5);
+    CHECK(getParamValue(&params, 1, 0, INT32_MAX, 42) == INT32_MAX);
+    CHECK(getParamValue(&params, 2, INT32_MIN, 0, 42) == INT32_MIN);
+    CHECK(getParamValue(&params, 3, 0, 1000, 42) == 1000);
+    CHECK(getParamValue(&params, 4, -1000, 0, 42) == -1000);
+}
+
+/// @brief Parses random bytes, and checks that the tokens are within the
+///        message, not empty and without delimiters, and that the values
+///        are within their range
+static void testRandomBytes(void)
+{
+    char message[TEST_MESSAGE_SIZE];
+    commandParams_t params;
+
+    srand(FUZZ_SEED);
+    for(int32_t i=0; i<FUZZ_MESSAGES; i++) {
+        size_t length = rand() % TEST_MESSAGE_SIZE;
+        for(size_t j=0; j<length; j++) {
+            // mostly delimiters and digits, so that there are tokens
+            // and numbers as well as noise
+            switch(rand() % 4) {
+                case 0: message[j] = TEST_DELIMITERS[rand() % 3]; break;
+                case 1: message[j] = '0' + rand() % 10; break;
+                default: message[j] = (char)(1 + rand() % 255); break;
+            }
+        }
+        message[length] = 0;
+
+        int32_t count = getParams(message, &params);
+        if (count < 0) {
+            CHECK(count == U_ERROR_COMMON_NOT_FOUND);
+            CHECK(getParamCount(&params) == 0);
+            continue;
+        }
+
+        CHECK(count <= MAX_COMMAND_PARAMS);
+        CHECK((size_t)count == getParamCount(&params));
+        for(size_t j=0; j<(size_t)count; j++) {
+            const char *param = getParamString(&params, j);
+            CHECK(param >= message && param < message + length);
+            CHECK(strlen(param) > 0);
+            CHECK(strpbrk(param, TEST_DELIMITERS) == NULL);
+
+            int32_t value = getParamValue(&params, j, -100, 100, 1000);
+            CHECK(value == 1000 || (value >= -100 && value <= 100));
+        }
+
+        CHECK(getParamString(&params, count) == NULL);
+    }
+}
+
+static double getHostTimeSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/// @brief Parses a command with its values, as the control topics do
+/// @return The tokens parsed per second
+static double runBenchmark(const char *command)
+{
+    char buffer[TEST_MESSAGE_SIZE];
+    commandParams_t params;
+    int64_t tokens = 0;
+    int64_t total = 0;
+
+    double startTime = getHostTimeSeconds();
+    for(int32_t i=0; i<BENCHMARK_COMMANDS; i++) {
+        tokens += parse(command, buffer, &params);
+        for(size_t j=1; j<getParamCount(&params); j++)
+            total += getParamValue(&params, j, INT32_MIN, INT32_MAX, 0);
+    }
+
+    double seconds = getHostTimeSeconds() - startTime;
+
+    // so the values can't be optimised away
+    if (total == 0)
+        printf("No values parsed\n");
+
+    return tokens / seconds;
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+int main(void)
+{
+    testEmpty();
+    testTokens();
+    testValues();
+    testRandomBytes();
+
+    printf("Tokens per second, START_TASK 30:        %.0f\n",
+           runBenchmark("START_TASK 30"));
+    printf("Tokens per second, eight tokens:         %.0f\n",
+           runBenchmark("SET_CONFIG,1:2:3,40000,500000,6,-7"));
+
+    printf("Parameter test: %s\n", failures == 0 ? "passed" : "FAILED");
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,208 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ *
+ * Host test of the periodic job scheduler, with a virtual clock
+ *
+ */
+
+#include <stdio.h>
+
+#include "u_error_common.h"
+
+#include "scheduler.h"
+
+/* ----------------------------------------------------------------
+ * DEFINES
+ * -------------------------------------------------------------- */
+#define CHECK(x)    check((x), #x, __LINE__)
+
+/* ----------------------------------------------------------------
+ * STATIC VARIABLES
+ * -------------------------------------------------------------- */
+static int64_t virtualTimeMs = 0;
+static int32_t failures = 0;
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+static void check(int passed, const char *pTest, int line)
+{
+    if (!passed) {
+        printf("FAILED line %d: %s\n", line, pTest);
+        failures++;
+    }
+}
+
+static int64_t getVirtualTimeMs(void)
+{
+    return virtualTimeMs;
+}
+
+static void lockNothing(void)
+{
+}
+
+/// @brief There is only one thread, so nothing can signal the wait and
+///        the virtual clock moves on to the timeout
+static void waitVirtualTime(int32_t timeoutMs)
+{
+    virtualTimeMs += timeoutMs;
+}
+
+static const schedulerPort_t virtualPort = {
+    .getTimeMs = getVirtualTimeMs,
+    .lock = lockNothing,
+    .unlock = lockNothing,
+    .wait = waitVirtualTime,
+    .signal = lockNothing
+};
+
+static void resetScheduler(void)
+{
+    virtualTimeMs = 0;
+    setSchedulerPort(&virtualPort);
+}
+
+static void testNotInitialised(void)
+{
+    setSchedulerPort(NULL);
+
+    CHECK(addScheduledJob("A", 1000, 100) == U_ERROR_COMMON_NOT_INITIALISED);
+    CHECK(getNextScheduledRun(0) == U_ERROR_COMMON_NOT_INITIALISED);
+    CHECK(beginScheduledRun(0, 0) == U_ERROR_COMMON_NOT_INITIALISED);
+}
+
+static void testInvalidJobs(void)
+{
+    resetScheduler();
+
+    CHECK(addScheduledJob("A", 0, 100) == U_ERROR_COMMON_INVALID_PARAMETER);
+    CHECK(addScheduledJob("A", 1000, -1) == U_ERROR_COMMON_INVALID_PARAMETER);
+    CHECK(getNextScheduledRun(0) == U_ERROR_COMMON_NOT_FOUND);
+    CHECK(setScheduledJobPeriod(0, 1000, 100) == U_ERROR_COMMON_NOT_FOUND);
+    CHECK(beginScheduledRun(0, 0) == U_ERROR_COMMON_NOT_FOUND);
+
+    for(int32_t i=0; i<SCHEDULER_MAX_JOBS; i++)
+        CHECK(addScheduledJob("Job", 1000, 100) == i);
+
+    CHECK(addScheduledJob("Job", 1000, 100) == U_ERROR_COMMON_NO_MEMORY);
+}
+
+static void testPeriod(void)
+{
+    resetScheduler();
+    int32_t job = addScheduledJob("A", 10000, 2000);
+
+    CHECK(getNextScheduledRun(job) == 10000);
+
+    // woken up early, the planned run is kept
+    virtualTimeMs = 5000;
+    CHECK(getNextScheduledRun(job) == 10000);
+
+    // run on time, and a little late, keeps to the period
+    virtualTimeMs = 10000;
+    CHECK(getNextScheduledRun(job) == 20000);
+    virtualTimeMs = 21000;
+    CHECK(getNextScheduledRun(job) == 30000);
+
+    // too late for the period, so it starts again from now
+    virtualTimeMs = 38500;
+    CHECK(getNextScheduledRun(job) == 48500);
+
+    // a changed period starts again from now
+    virtualTimeMs = 48500;
+    CHECK(setScheduledJobPeriod(job, 5000, 1000) == 0);
+    CHECK(getNextScheduledRun(job) == 53500);
+}
+
+static void testAlignment(void)
+{
+    resetScheduler();
+    int32_t jobA = addScheduledJob("A", 10000, 2000);
+    int32_t jobB = addScheduledJob("B", 10000, 2000);
+    int32_t jobC = addScheduledJob("C", 10000, 500);
+
+    CHECK(getNextScheduledRun(jobA) == 10000);
+
+    // B is due at 11000, and A's run at 10000 is in its window
+    virtualTimeMs = 1000;
+    CHECK(getNextScheduledRun(jobB) == 10000);
+
+    // C is due at 12000, and the runs at 10000 are outside its window
+    virtualTimeMs = 2000;
+    CHECK(getNextScheduledRun(jobC) == 12000);
+
+    // the later runs of A are found from its period
+    cancelScheduledRun(jobB);
+    virtualTimeMs = 10500;
+    CHECK(getNextScheduledRun(jobB) == 20000);
+
+    // a cancelled job isn't aligned with
+    cancelScheduledRun(jobA);
+    cancelScheduledRun(jobB);
+    virtualTimeMs = 12000;
+    CHECK(getNextScheduledRun(jobC) == 22000);
+    virtualTimeMs = 12500;
+    CHECK(getNextScheduledRun(jobA) == 22000);
+}
+
+static void testRunsInTurn(void)
+{
+    resetScheduler();
+    int32_t jobA = addScheduledJob("A", 10000, 2000);
+    int32_t jobB = addScheduledJob("B", 10000, 2000);
+
+    virtualTimeMs = 10000;
+    CHECK(beginScheduledRun(jobA, 1000) == 0);
+
+    // the job which is running can begin again
+    CHECK(beginScheduledRun(jobA, 1000) == 0);
+
+    // B waits for A, until its timeout
+    CHECK(beginScheduledRun(jobB, 1000) == U_ERROR_COMMON_TIMEOUT);
+    CHECK(virtualTimeMs == 11000);
+
+    // B which ran anyway doesn't end A's run
+    endScheduledRun(jobB);
+    CHECK(beginScheduledRun(jobB, 0) == U_ERROR_COMMON_TIMEOUT);
+
+    endScheduledRun(jobA);
+    CHECK(beginScheduledRun(jobB, 1000) == 0);
+    CHECK(virtualTimeMs == 11000);
+
+    // cancelling the running job ends its run
+    cancelScheduledRun(jobB);
+    CHECK(beginScheduledRun(jobA, 1000) == 0);
+    endScheduledRun(jobA);
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+int main(void)
+{
+    testNotInitialised();
+    testInvalidJobs();
+    testPeriod();
+    testAlignment();
+    testRunsInTurn();
+
+    printf("Scheduler test: %s\n", failures == 0 ? "passed" : "FAILED");
+
+    return failures == 0 ? 0 : 1;
+}
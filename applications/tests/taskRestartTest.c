@@ -0,0 +1,204 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *
+ * Host test of stopping and starting a task loop again, as the task
+ * supervisor does to recover a task
+ *
+ */
+
+#include "common.h"
+#include "taskControl.h"
+#include "mqttTask.h"
+#include "schedulerPort.h"
+
+/* ----------------------------------------------------------------
+ * DEFINES
+ * -------------------------------------------------------------- */
+#define CHECK(x)    check((x), #x, __LINE__)
+
+#define TEST_TASK_STACK_SIZE    (8 * 1024)
+#define TEST_TASK_PRIORITY      5
+
+// how long the test waits for the task loop to change
+#define TEST_WAIT_MS            3000
+
+/* ----------------------------------------------------------------
+ * STATIC VARIABLES
+ * -------------------------------------------------------------- */
+static int32_t failures = 0;
+
+static bool exitTask = false;
+static taskConfig_t *taskConfig = NULL;
+
+/* ----------------------------------------------------------------
+ * PUBLIC VARIABLES
+ * -------------------------------------------------------------- */
+bool gExitApp = false;
+
+/* ----------------------------------------------------------------
+ * STUBS of the modules the task control uses
+ * -------------------------------------------------------------- */
+void _writeLog(const char *log, logLevels_t level, bool writeToFile, int32_t module, ...)
+{
+}
+
+int32_t registerConfigSchema(const configSchema_t *schema, size_t count)
+{
+    return U_ERROR_COMMON_SUCCESS;
+}
+
+int32_t sendMQTTMessage(mqttTopicHandle_t topic, const char *pMessage, uMqttQos_t QoS, bool retain)
+{
+    return U_ERROR_COMMON_SUCCESS;
+}
+
+int32_t subscribeToTaskControlAsync(taskRunner_t *runner)
+{
+    return U_ERROR_COMMON_SUCCESS;
+}
+
+/* ----------------------------------------------------------------
+ * TEST TASK
+ * -------------------------------------------------------------- */
+static bool isNotExiting(void)
+{
+    return !gExitApp && !exitTask;
+}
+
+static void taskLoop(void *pParameters)
+{
+    while(isNotExiting())
+        dwellTask(taskConfig, isNotExiting);
+
+    FINALIZE_TASK;
+}
+
+static int32_t initTestTask(taskConfig_t *config)
+{
+    EXIT_IF_CONFIG_NULL;
+
+    taskConfig = config;
+    return U_ERROR_COMMON_SUCCESS;
+}
+
+static int32_t startTestTaskLoop(commandParams_t *params)
+{
+    EXIT_IF_CANT_RUN_TASK;
+    START_TASK_LOOP(TEST_TASK_STACK_SIZE, TEST_TASK_PRIORITY);
+}
+
+static int32_t stopTestTaskLoop(commandParams_t *params)
+{
+    STOP_TASK;
+}
+
+static int32_t finalizeTestTask(void)
+{
+    return U_ERROR_COMMON_SUCCESS;
+}
+
+static taskRunner_t testTaskRunner = {initTestTask, startTestTaskLoop, stopTestTaskLoop, finalizeTestTask, false,
+        {EXAMPLE_TASK, "Test", 1, false, BLANK_TASK_HANDLES, NULL}};
+
+static int32_t initFailingTask(taskConfig_t *config)
+{
+    return U_ERROR_COMMON_NO_MEMORY;
+}
+
+static taskRunner_t failingTaskRunner = {initFailingTask, startTestTaskLoop, stopTestTaskLoop, finalizeTestTask, false,
+        {SENSOR_TASK, "Failing", 1, false, BLANK_TASK_HANDLES, NULL}};
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+static void check(int passed, const char *pTest, int line)
+{
+    if (!passed) {
+        printf("FAILED line %d: %s\n", line, pTest);
+        failures++;
+    }
+}
+
+/// @brief Waits for the task loop to check in with a heartbeat
+static bool waitForHeartbeat(void)
+{
+    for(int32_t waitedMs = 0; waitedMs < TEST_WAIT_MS; waitedMs += 10) {
+        if (atomic_get(&testTaskRunner.config.heartbeat) != 0)
+            return true;
+
+        uPortTaskBlock(10);
+    }
+
+    return false;
+}
+
+static void testRestart(void)
+{
+    CHECK(registerTask(&testTaskRunner) == 0);
+    CHECK(runTask(EXAMPLE_TASK, NULL) == 0);
+    CHECK(waitForHeartbeat());
+
+    // stopped as the supervisor does, the heartbeat is cleared
+    CHECK(stopAndWait(EXAMPLE_TASK, TEST_WAIT_MS));
+    CHECK(atomic_get(&testTaskRunner.config.heartbeat) == 0);
+    CHECK(!isTaskRunning(&testTaskRunner.config));
+
+    // started again, the loop runs and checks in again
+    CHECK(testTaskRunner.startFunc(NULL) == 0);
+    CHECK(waitForHeartbeat());
+    CHECK(isTaskRunning(&testTaskRunner.config));
+
+    // and it can be stopped and started once more
+    CHECK(stopAndWait(EXAMPLE_TASK, TEST_WAIT_MS));
+    CHECK(testTaskRunner.startFunc(NULL) == 0);
+    CHECK(waitForHeartbeat());
+
+    CHECK(stopAndWait(EXAMPLE_TASK, TEST_WAIT_MS));
+}
+
+/// @brief A task which fails to initialise, however many times it is
+///        tried, holds neither a dwell semaphore nor a scheduled job
+static void testFailedInit(void)
+{
+    CHECK(registerTask(&failingTaskRunner) == 0);
+    for(int32_t i=0; i<=SCHEDULER_MAX_JOBS; i++) {
+        CHECK(initSingleTask(SENSOR_TASK) == U_ERROR_COMMON_NO_MEMORY);
+        CHECK(!failingTaskRunner.config.initialised);
+        CHECK(failingTaskRunner.config.handles.dwellSemaphoreHandle == NULL);
+        CHECK(failingTaskRunner.config.scheduledJob < 0);
+    }
+
+    // the scheduler still has room for the other jobs
+    CHECK(addScheduledJob("Other", 1000, 100) >= 0);
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+int main(void)
+{
+    setSchedulerPort(&schedulerKernelPort);
+
+    testRestart();
+    testFailedInit();
+
+    printf("Task restart test: %s\n", failures == 0 ? "passed" : "FAILED");
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+/*
+ * Copyright 2022 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *
+ * Host benchmark of the timestamps, before and after caching the
+ * formatted second, on a virtual clock
+ *
+ */
+
+#include <time.h>
+
+#include "common.h"
+
+/* ----------------------------------------------------------------
+ * DEFINES
+ * -------------------------------------------------------------- */
+#define CHECK(x)    check((x), #x, __LINE__)
+
+// the timestamps made by each benchmark, one each virtual millisecond
+#define BENCHMARK_TIMESTAMPS    2000000
+
+// 2022-06-01T12:00:00.000Z
+#define BENCHMARK_START_TIME_MS 1654084800000LL
+
+/* ----------------------------------------------------------------
+ * STATIC VARIABLES
+ * -------------------------------------------------------------- */
+static int64_t virtualTimeMs = 0;
+static int32_t failures = 0;
+
+/* ----------------------------------------------------------------
+ * STUBS of the kernel and the modules the time service uses
+ * -------------------------------------------------------------- */
+k_spinlock_key_t k_spin_lock(struct k_spinlock *l)
+{
+    return (k_spinlock_key_t){0};
+}
+
+void k_spin_unlock(struct k_spinlock *l, k_spinlock_key_t key)
+{
+}
+
+void publishEvent(appEvent_t event)
+{
+}
+
+int64_t k_uptime_get(void)
+{
+    return virtualTimeMs;
+}
+
+void _writeLog(const char *log, logLevels_t level, bool writeToFile, int32_t module, ...)
+{
+}
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+static void check(int passed, const char *pTest, int line)
+{
+    if (!passed) {
+        printf("FAILED line %d: %s\n", line, pTest);
+        failures++;
+    }
+}
+
+/// @brief The timestamp as it was made before the second was cached,
+///        converting and formatting the whole time every call
+static void getTimeStampUncached(char *timeStamp)
+{
+    int64_t unixTimeMs = getUnixTimeMs();
+    time_t tmTime = (time_t)(unixTimeMs / 1000);
+    struct tm time;
+
+    gmtime_r(&tmTime, &time);
+    snprintf(timeStamp, TIMESTAMP_MAX_LENTH_BYTES, "%04u-%02u-%02uT%02u:%02u:%02u.%03uZ",
+                (unsigned)(time.tm_year + 1900) % 10000,
+                (unsigned)(time.tm_mon + 1) % 100,
+                (unsigned)time.tm_mday % 100,
+                (unsigned)time.tm_hour % 100,
+                (unsigned)time.tm_min % 100,
+                (unsigned)time.tm_sec % 100,
+                (unsigned)(unixTimeMs % 1000));
+}
+
+static double getHostTimeSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/// @brief Makes the timestamps, moving the virtual clock on a millisecond
+///        each time, so a second is formatted once for 1000 timestamps
+/// @return The timestamps per second
+static double runBenchmark(void (*getStamp)(char *))
+{
+    char timeStamp[TIMESTAMP_MAX_LENTH_BYTES];
+    virtualTimeMs = 0;
+
+    double startTime = getHostTimeSeconds();
+    for(int32_t i=0; i<BENCHMARK_TIMESTAMPS; i++) {
+        getStamp(timeStamp);
+        virtualTimeMs++;
+    }
+
+    return BENCHMARK_TIMESTAMPS / (getHostTimeSeconds() - startTime);
+}
+
+static void testTimeStamps(void)
+{
+    char timeStamp[TIMESTAMP_MAX_LENTH_BYTES];
+    char expected[TIMESTAMP_MAX_LENTH_BYTES];
+
+    // without the time, it is the time since boot
+    virtualTimeMs = 1234;
+    getTimeStamp(timeStamp);
+    CHECK(strcmp(timeStamp, "1234") == 0);
+
+    virtualTimeMs = 0;
+    CHECK(setUnixTime(BENCHMARK_START_TIME_MS, TIME_SOURCE_NTP));
+    getTimeStamp(timeStamp);
+    CHECK(strcmp(timeStamp, "2022-06-01T12:00:00.000Z") == 0);
+
+    // the cached second is used until the next second
+    virtualTimeMs = 999;
+    getTimeStamp(timeStamp);
+    CHECK(strcmp(timeStamp, "2022-06-01T12:00:00.999Z") == 0);
+
+    virtualTimeMs = 1000;
+    getTimeStamp(timeStamp);
+    CHECK(strcmp(timeStamp, "2022-06-01T12:00:01.000Z") == 0);
+
+    // and matches the uncached timestamp, going back in time too
+    int64_t times[] = {86399999, 86400000, 5, 31536000123LL, 1001};
+    for(size_t i=0; i<NUM_ELEMENTS(times); i++) {
+        virtualTimeMs = times[i];
+        getTimeStamp(timeStamp);
+        getTimeStampUncached(expected);
+        CHECK(strcmp(timeStamp, expected) == 0);
+    }
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+int main(void)
+{
+    testTimeStamps();
+
+    double uncachedRate = runBenchmark(getTimeStampUncached);
+    double cachedRate = runBenchmark(getTimeStamp);
+
+    printf("Timestamps per second, formatting every time: %.0f\n", uncachedRate);
+    printf("Timestamps per second, caching the second:    %.0f (%.1fx)\n",
+                cachedRate, cachedRate / uncachedRate);
+
+    printf("Timestamp test: %s\n", failures == 0 ? "passed" : "FAILED");
+
+    return failures == 0 ? 0 : 1;
+}